@@ -0,0 +1,190 @@
+#include "bench.h"
+#include "../libs/buffer.h"
+
+#define CSV_FIELDS "name,param,iters,reps,min_ns,median_ns,p90_ns,p99_ns,mb_per_s"
+#define MAX_ROWS 4096
+
+BenchConfig bench_config = { 15, 3, 20000000, NULL, STDOUT_FILENO };
+
+/* one parsed CSV row of a previous run */
+struct row {
+    char name[64];
+    size_t param;
+    double median_ns;
+};
+
+/**
+ * Checks a benchmark name against the --filter option.
+ *
+ * @param name The benchmark name.
+ *
+ * @returns 1 if the benchmark should run, 0 otherwise.
+ */
+int bench_selected(const char *name){
+    return bench_config.filter == NULL || strstr(name, bench_config.filter) != NULL;
+}
+
+static int cmp_double(const void *a, const void *b){
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of a sorted sample */
+static double percentile(const double *sorted, int n, int pct){
+    int rank = (pct * n + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static uint64_t time_rep(bench_fn fn, void *arg, uint64_t iters){
+    uint64_t start = clk_now_ns();
+    fn(arg, iters);
+    return clk_now_ns() - start;
+}
+
+/**
+ * Runs a benchmark: scales the iteration count until one repetition takes
+ * at least min_rep_ns, runs the warmup repetitions, then the measured ones,
+ * and reports per iteration statistics as one CSV row.
+ *
+ * @param name The benchmark name.
+ * @param param The size or other parameter the benchmark was run with.
+ * @param fn The benchmark body.
+ * @param arg The argument passed to fn.
+ * @param bytes_per_iter Bytes processed per iteration for the throughput
+ *                       column, 0 to leave it empty.
+ *
+ * @returns The statistics, all zero if the benchmark was filtered out.
+ */
+BenchResult bench_run(const char *name, size_t param, bench_fn fn, void *arg, size_t bytes_per_iter){
+    BenchResult res;
+    double samples[BENCH_MAX_REPS];
+    memset(&res, 0, sizeof(res));
+    if(!bench_selected(name)){
+        return res;
+    }
+
+    uint64_t iters = 1;
+    uint64_t elapsed = time_rep(fn, arg, iters);
+    while(elapsed < bench_config.min_rep_ns){
+        uint64_t scale = elapsed ? bench_config.min_rep_ns * 6 / 5 / elapsed : 100;
+        iters *= scale < 2 ? 2 : (scale > 100 ? 100 : scale);
+        elapsed = time_rep(fn, arg, iters);
+    }
+    for(int i = 0; i < bench_config.warmup; i ++){
+        time_rep(fn, arg, iters);
+    }
+
+    int reps = bench_config.reps < BENCH_MAX_REPS ? bench_config.reps : BENCH_MAX_REPS;
+    for(int i = 0; i < reps; i ++){
+        samples[i] = (double) time_rep(fn, arg, iters) / iters;
+    }
+    qsort(samples, reps, sizeof(double), cmp_double);
+
+    res.iters = iters;
+    res.min_ns = samples[0];
+    res.median_ns = reps % 2 ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+    res.p90_ns = percentile(samples, reps, 90);
+    res.p99_ns = percentile(samples, reps, 99);
+    if(bytes_per_iter){
+        res.mb_per_s = bytes_per_iter / res.median_ns * 1e9 / 1e6;
+    }
+
+    print(bench_config.out, "%s,%zu,%llu,%d,%.2f,%.2f,%.2f,%.2f,%.1f\n", name, param,
+          (unsigned long long) iters, reps, res.min_ns, res.median_ns, res.p90_ns,
+          res.p99_ns, res.mb_per_s);
+    print(STDERR_FILENO, "%-24s %8zu  median %12.1f ns  p90 %12.1f ns  %10.1f MB/s\n",
+          name, param, res.median_ns, res.p90_ns, res.mb_per_s);
+    return res;
+}
+
+/**
+ * Writes the CSV header line.
+ *
+ * @returns None
+ */
+void bench_header(void){
+    println(bench_config.out, CSV_FIELDS);
+}
+
+/**
+ * Fills memory with reproducible pseudo-random bytes.
+ *
+ * @param dst The memory to fill.
+ * @param size The number of bytes.
+ * @param seed The generator seed.
+ *
+ * @returns None
+ */
+void bench_fill(void *dst, size_t size, uint64_t seed){
+    uint64_t x = seed * 0x9e3779b97f4a7c15ULL + 1;
+    byte *p = dst;
+    for(size_t i = 0; i < size; i ++){
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        p[i] = (byte) (x >> 32);
+    }
+}
+
+static size_t load_rows(const char *path, struct row *rows){
+    Buffer *buff = buff_init(4096);
+    byte chunk[4096];
+    ssize_t n;
+    int fd = sys_open(path, O_RDONLY);
+    while((n = sys_read(fd, chunk, sizeof(chunk))) > 0){
+        buff_append(buff, chunk, n);
+    }
+    sys_close(fd);
+    buff_append_byte(buff, '\0');
+
+    size_t count = 0;
+    char *save = NULL;
+    for(char *line = strtok_r(buff_body(buff), "\n", &save); line != NULL && count < MAX_ROWS;
+        line = strtok_r(NULL, "\n", &save)){
+        struct row *r = &rows[count];
+        if(sscanf(line, "%63[^,],%zu,%*u,%*d,%*f,%lf", r->name, &r->param, &r->median_ns) == 3){
+            count ++;
+        }
+    }
+    buff_free(buff);
+    return count;
+}
+
+/**
+ * Compares the medians of two CSV runs produced by the harness.
+ *
+ * @param old_path The baseline run.
+ * @param new_path The run to check.
+ * @param threshold_pct The slowdown in percent above which a benchmark
+ *                      counts as a regression.
+ *
+ * @returns The number of regressions.
+ */
+int bench_compare(const char *old_path, const char *new_path, double threshold_pct){
+    static struct row old_rows[MAX_ROWS], new_rows[MAX_ROWS];
+    size_t n_old = load_rows(old_path, old_rows);
+    size_t n_new = load_rows(new_path, new_rows);
+    int regressions = 0;
+
+    print(STDOUT_FILENO, "%-24s %8s %12s %12s %8s\n", "name", "param", "old ns", "new ns", "delta");
+    for(size_t i = 0; i < n_new; i ++){
+        struct row *cur = &new_rows[i];
+        struct row *base = NULL;
+        for(size_t j = 0; j < n_old && base == NULL; j ++){
+            if(old_rows[j].param == cur->param && strcmp(old_rows[j].name, cur->name) == 0){
+                base = &old_rows[j];
+            }
+        }
+        if(base == NULL){
+            print(STDOUT_FILENO, "%-24s %8zu %12s %12.1f %8s\n", cur->name, cur->param, "-",
+                  cur->median_ns, "new");
+            continue;
+        }
+        double delta = (cur->median_ns - base->median_ns) / base->median_ns * 100.0;
+        int regressed = delta > threshold_pct;
+        regressions += regressed;
+        print(STDOUT_FILENO, "%-24s %8zu %12.1f %12.1f %+7.1f%%%s\n", cur->name, cur->param,
+              base->median_ns, cur->median_ns, delta, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
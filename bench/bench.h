@@ -0,0 +1,85 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include "../libs/syscalls.h"
+#include "../libs/timing.h"
+
+#define BENCH_MAX_REPS 1000
+
+/* a benchmark body, runs the measured operation iters times */
+typedef void (*bench_fn)(void *arg, uint64_t iters);
+
+/**
+ * Harness settings, filled from the command line.
+ *
+ * @param reps The number of measured repetitions.
+ * @param warmup The number of unmeasured repetitions run first.
+ * @param min_rep_ns The minimum duration of one repetition, iterations are
+ *                   scaled until a repetition takes at least this long.
+ * @param filter Only benchmarks whose name contains this string run.
+ * @param out The file descriptor results are written to as CSV.
+ */
+struct bench_config {
+    int reps;
+    int warmup;
+    uint64_t min_rep_ns;
+    const char *filter;
+    int out;
+};
+typedef struct bench_config BenchConfig;
+
+/**
+ * The statistics of one benchmark, per iteration.
+ *
+ * @param iters The iterations per repetition.
+ * @param min_ns The fastest repetition.
+ * @param median_ns The median repetition.
+ * @param p90_ns The 90th percentile repetition.
+ * @param p99_ns The 99th percentile repetition.
+ * @param mb_per_s Throughput of the median repetition, 0 if not applicable.
+ */
+struct bench_result {
+    uint64_t iters;
+    double min_ns;
+    double median_ns;
+    double p90_ns;
+    double p99_ns;
+    double mb_per_s;
+};
+typedef struct bench_result BenchResult;
+
+extern BenchConfig bench_config;
+
+/* keeps the compiler from optimizing away a computed value */
+#define bench_clobber(p) __asm__ volatile("" : : "g"(p) : "memory")
+
+/* function prototypes */
+int bench_selected(const char *name);
+BenchResult bench_run(const char *name, size_t param, bench_fn fn, void *arg, size_t bytes_per_iter);
+void bench_header(void);
+int bench_compare(const char *old_path, const char *new_path, double threshold_pct);
+void bench_fill(void *dst, size_t size, uint64_t seed);
+
+/* suites */
+void bench_buffer(void);
+void bench_io(void);
+void bench_codec(void);
+void bench_scan(void);
+void bench_checksum(void);
+void bench_encoding(void);
+void bench_lz(void);
+void bench_map(void);
+void bench_vec(void);
+void bench_ring(void);
+void bench_region(void);
+void bench_journal(void);
+void bench_replace(void);
+void bench_slab(void);
+void bench_alloc(void);
+void bench_secheap(void);
+void bench_hugemem(void);
+void bench_topo(void);
+void bench_numa(void);
+
+#endif
@@ -0,0 +1,127 @@
+#include "bench.h"
+
+#include <pthread.h>
+
+#define LIVE 256
+
+static const int thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+struct alloc_arg {
+    int threads;
+    int libc;
+    int cross;
+    uint64_t per_thread;
+    pthread_barrier_t barrier;
+    void **handoff;
+};
+
+static void *alloc(struct alloc_arg *a, size_t size){
+    return a->libc ? malloc(size) : sec_malloc(size);
+}
+
+static void release(struct alloc_arg *a, void *ptr){
+    if(a->libc){
+        free(ptr);
+    }else{
+        sec_free(ptr);
+    }
+}
+
+/* replaces random blocks of a working set of LIVE, sizes 16 to 512 bytes */
+static void churn(struct alloc_arg *a, void **live, uint64_t *seed, uint64_t count){
+    for(uint64_t i = 0; i < count; i ++){
+        *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t slot = (*seed >> 33) % LIVE;
+        release(a, live[slot]);
+        live[slot] = alloc(a, 16 + (*seed >> 13) % 497);
+        *(uint64_t *) live[slot] = i;
+    }
+}
+
+struct worker_arg {
+    struct alloc_arg *a;
+    int id;
+};
+
+static void *worker(void *arg){
+    struct worker_arg *w = arg;
+    struct alloc_arg *a = w->a;
+    uint64_t seed = w->id + 1;
+    void *live[LIVE];
+    for(int i = 0; i < LIVE; i ++){
+        live[i] = alloc(a, 64);
+    }
+    if(!a->cross){
+        churn(a, live, &seed, a->per_thread);
+    }else{
+        /* every round each thread frees the working set of its neighbour */
+        for(uint64_t done = 0; done < a->per_thread; done += LIVE){
+            churn(a, live, &seed, LIVE / 4);
+            memcpy(a->handoff + (size_t) w->id * LIVE, live, sizeof(live));
+            pthread_barrier_wait(&a->barrier);
+            void **theirs = a->handoff + (size_t) ((w->id + 1) % a->threads) * LIVE;
+            for(int i = 0; i < LIVE; i ++){
+                release(a, theirs[i]);
+                live[i] = alloc(a, 64);
+            }
+            pthread_barrier_wait(&a->barrier);
+        }
+    }
+    for(int i = 0; i < LIVE; i ++){
+        release(a, live[i]);
+    }
+    return NULL;
+}
+
+static void run_threads(void *arg, uint64_t iters){
+    struct alloc_arg *a = arg;
+    pthread_t threads[64];
+    struct worker_arg workers[64];
+    a->per_thread = (iters + a->threads - 1) / a->threads;
+    pthread_barrier_init(&a->barrier, NULL, a->threads);
+    for(int t = 0; t < a->threads; t ++){
+        workers[t].a = a;
+        workers[t].id = t;
+        pthread_create(&threads[t], NULL, worker, &workers[t]);
+    }
+    for(int t = 0; t < a->threads; t ++){
+        pthread_join(threads[t], NULL);
+    }
+    pthread_barrier_destroy(&a->barrier);
+}
+
+/**
+ * Benchmarks small block allocation from 1 to 64 threads, sec_malloc
+ * against libc malloc: each thread replacing random blocks of its own
+ * working set, and each thread freeing blocks allocated by another.
+ * An iteration is one free and one allocation.
+ *
+ * @returns None
+ */
+void bench_alloc(void){
+    static const struct {
+        const char *name;
+        int libc;
+        int cross;
+    } variants[] = {
+        { "sec_malloc_local", 0, 0 },
+        { "libc_malloc_local", 1, 0 },
+        { "sec_malloc_cross", 0, 1 },
+        { "libc_malloc_cross", 1, 1 },
+    };
+    struct alloc_arg arg;
+    arg.handoff = sec_malloc(sizeof(void *) * LIVE * 64);
+    for(size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v ++){
+        arg.libc = variants[v].libc;
+        arg.cross = variants[v].cross;
+        for(size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i ++){
+            arg.threads = thread_counts[i];
+            BenchResult res = bench_run(variants[v].name, arg.threads, run_threads, &arg, 0);
+            if(res.iters > 0){
+                print(STDERR_FILENO, "%-18s %2d threads  %7.1f M ops/s\n", variants[v].name,
+                      arg.threads, 1e3 / res.median_ns);
+            }
+        }
+    }
+    sec_free(arg.handoff);
+}
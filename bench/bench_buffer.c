@@ -0,0 +1,233 @@
+#include "bench.h"
+#include "../libs/buffer.h"
+
+/* appends restart from an empty buffer once this much has been written */
+#define RESET_AT ((size_t) 1 << 20)
+/* number of appends made to a buffer grown from empty */
+#define GROW_APPENDS 160000
+
+static const size_t sizes[] = { 16, 256, 4096, 65536 };
+static const size_t grow_sizes[] = { 64, 1024, 8192 };
+
+struct buff_arg {
+    Buffer *buff;
+    byte *data;
+    size_t size;
+};
+
+static void run_append(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size + a->size > RESET_AT){
+            a->buff->size = 0;
+        }
+        buff_append(a->buff, a->data, a->size);
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_insert(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size + a->size > RESET_AT){
+            a->buff->size = 0;
+        }
+        buff_insert(a->buff, a->data, a->size, a->buff->size);
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_append_byte(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size == RESET_AT){
+            a->buff->size = 0;
+        }
+        buff_append_byte(a->buff, (byte) i);
+    }
+    bench_clobber(a->buff->body);
+}
+
+/* builds a buffer one byte at a time from an initial capacity of 1 */
+static void run_grow(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        Buffer *buff = buff_init(1);
+        for(size_t j = 0; j < a->size; j ++){
+            buff_append_byte(buff, (byte) j);
+        }
+        bench_clobber(buff->body);
+        buff_free(buff);
+    }
+}
+
+static void run_realloc(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    void *p = sec_malloc(a->size);
+    for(uint64_t i = 0; i < iters; i ++){
+        p = sec_realloc(p, a->size, a->size);
+        bench_clobber(p);
+    }
+    sec_free(p);
+}
+
+/* a log line of about 1 KB: a header and 16 numeric fields */
+#define MESSAGE_FORMAT "%s pid=%d seq=%lu elapsed=%.3f " \
+    "%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s\n"
+#define MESSAGE_ARGS(i) "2024-01-01T00:00:00Z worker", 4242, (unsigned long) (i), (double) (i) / 7, \
+    field, field, field, field, field, field, field, field, \
+    field, field, field, field, field, field, field, field
+
+static const char field[] = "key=value-of-a-typical-field-in-a-log-line-abcdefghijklmnop ";
+
+/* the pattern print uses: measure, allocate, format, then copy into the buffer */
+static void format_copy(Buffer *buff, const char *format, ...){
+    va_list args, cpy;
+    va_start(args, format);
+    va_copy(cpy, args);
+    size_t len = vsnprintf(NULL, 0, format, cpy) + 1;
+    va_end(cpy);
+    char *out = sec_malloc(len);
+    vsnprintf(out, len, format, args);
+    buff_append(buff, out, len - 1);
+    sec_free(out);
+    va_end(args);
+}
+
+static void run_format_copy(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->buff->size = 0;
+        format_copy(a->buff, MESSAGE_FORMAT, MESSAGE_ARGS(i));
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_appendf(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->buff->size = 0;
+        buff_appendf(a->buff, MESSAGE_FORMAT, MESSAGE_ARGS(i));
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_appendf_u64(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    const uint64_t *values = (const uint64_t *) a->data;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size > RESET_AT - 64){
+            a->buff->size = 0;
+        }
+        buff_appendf(a->buff, "%lu", (unsigned long) values[i & 1023]);
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_append_u64(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    const uint64_t *values = (const uint64_t *) a->data;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size > RESET_AT - 64){
+            a->buff->size = 0;
+        }
+        buff_append_u64(a->buff, values[i & 1023]);
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_appendf_fixed(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    const uint32_t *values = (const uint32_t *) a->data;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size > RESET_AT - 64){
+            a->buff->size = 0;
+        }
+        buff_appendf(a->buff, "%.3f", values[i & 1023] / 1024.0);
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_append_fixed(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    const uint32_t *values = (const uint32_t *) a->data;
+    for(uint64_t i = 0; i < iters; i ++){
+        if(a->buff->size > RESET_AT - 64){
+            a->buff->size = 0;
+        }
+        buff_append_fixed(a->buff, values[i & 1023] / 1024.0, 3);
+    }
+    bench_clobber(a->buff->body);
+}
+
+/* appends numbers to a buffer that starts empty, so it grows along the way */
+static void run_grow_u64(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    const uint64_t *values = (const uint64_t *) a->data;
+    for(uint64_t i = 0; i < iters; i ++){
+        Buffer *buff = buff_init(0);
+        for(size_t j = 0; j < GROW_APPENDS; j ++){
+            buff_append_u64(buff, values[j & 1023]);
+        }
+        bench_clobber(buff->body);
+        buff_free(buff);
+    }
+}
+
+static void run_grow_fixed(void *arg, uint64_t iters){
+    struct buff_arg *a = arg;
+    const uint32_t *values = (const uint32_t *) a->data;
+    for(uint64_t i = 0; i < iters; i ++){
+        Buffer *buff = buff_init(0);
+        for(size_t j = 0; j < GROW_APPENDS; j ++){
+            buff_append_fixed(buff, values[j & 1023] / 1024.0, 3);
+        }
+        bench_clobber(buff->body);
+        buff_free(buff);
+    }
+}
+
+static void report_per_append(const char *name, BenchResult res){
+    if(res.iters > 0){
+        print(STDERR_FILENO, "%-24s %8.1f ns/append\n", name, res.median_ns / GROW_APPENDS);
+    }
+}
+
+/**
+ * Benchmarks Buffer appends, inserts, growth and sec_realloc, and
+ * formatted appends against formatting into a temporary and copying.
+ * Number appends are also timed on a buffer grown from empty, so the
+ * cost of growing is included.
+ *
+ * @returns None
+ */
+void bench_buffer(void){
+    struct buff_arg arg;
+    arg.data = sec_malloc(RESET_AT);
+    bench_fill(arg.data, RESET_AT, 1);
+
+    arg.buff = buff_init(RESET_AT);
+    arg.size = 1;
+    bench_run("buff_append_byte", 1, run_append_byte, &arg, 1);
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i ++){
+        arg.size = sizes[i];
+        bench_run("buff_append", sizes[i], run_append, &arg, sizes[i]);
+        bench_run("buff_insert", sizes[i], run_insert, &arg, sizes[i]);
+        bench_run("sec_realloc", sizes[i], run_realloc, &arg, sizes[i]);
+    }
+    bench_run("format_copy", 1024, run_format_copy, &arg, 0);
+    bench_run("buff_appendf", 1024, run_appendf, &arg, 0);
+    bench_run("appendf_u64", 1, run_appendf_u64, &arg, 0);
+    bench_run("buff_append_u64", 1, run_append_u64, &arg, 0);
+    bench_run("appendf_fixed", 3, run_appendf_fixed, &arg, 0);
+    bench_run("buff_append_fixed", 3, run_append_fixed, &arg, 0);
+    buff_free(arg.buff);
+    report_per_append("grow_append_u64", bench_run("grow_append_u64", GROW_APPENDS, run_grow_u64, &arg, 0));
+    report_per_append("grow_append_fixed", bench_run("grow_append_fixed", GROW_APPENDS, run_grow_fixed, &arg, 0));
+
+    for(size_t i = 0; i < sizeof(grow_sizes) / sizeof(grow_sizes[0]); i ++){
+        arg.size = grow_sizes[i];
+        bench_run("buff_grow", grow_sizes[i], run_grow, &arg, grow_sizes[i]);
+    }
+    sec_free(arg.data);
+}
@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "../libs/checksum.h"
+
+#define LARGE ((size_t) 1 << 20)
+#define SMALL ((size_t) 4096)
+
+struct checksum_arg {
+    const byte *data;
+    size_t size;
+};
+
+/* the bit-at-a-time CRC-32C the checksum module replaces */
+static void run_bitwise(void *arg, uint64_t iters){
+    struct checksum_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint32_t crc = ~0u;
+        for(size_t j = 0; j < a->size; j ++){
+            crc ^= a->data[j];
+            for(int k = 0; k < 8; k ++){
+                crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+            }
+        }
+        bench_clobber(crc);
+    }
+}
+
+static void run_crc32c(void *arg, uint64_t iters){
+    struct checksum_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint32_t crc = cksum_crc32c(0, a->data, a->size);
+        bench_clobber(crc);
+    }
+}
+
+static void run_crc32(void *arg, uint64_t iters){
+    struct checksum_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint32_t crc = cksum_crc32(0, a->data, a->size);
+        bench_clobber(crc);
+    }
+}
+
+static void run_hash64(void *arg, uint64_t iters){
+    struct checksum_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t h = cksum_hash64(a->data, a->size, 0);
+        bench_clobber(h);
+    }
+}
+
+static const struct {
+    const char *name;
+    bench_fn fn;
+} algos[] = {
+    { "cksum_bitwise_crc32c", run_bitwise },
+    { "cksum_crc32c", run_crc32c },
+    { "cksum_crc32", run_crc32 },
+    { "cksum_hash64", run_hash64 },
+};
+
+/**
+ * Benchmarks CRC-32C, CRC-32 and the 64-bit hash over 4 KiB and 1 MiB,
+ * against a bitwise CRC, and summarizes the throughput in GB/s.
+ *
+ * @returns None
+ */
+void bench_checksum(void){
+    byte *data = sec_malloc(LARGE);
+    bench_fill(data, LARGE, 5);
+    print(STDERR_FILENO, "checksum implementation: %s\n", cksum_impl());
+
+    for(size_t i = 0; i < sizeof(algos) / sizeof(algos[0]); i ++){
+        struct checksum_arg arg = { data, SMALL };
+        BenchResult small = bench_run(algos[i].name, SMALL, algos[i].fn, &arg, SMALL);
+        arg.size = LARGE;
+        BenchResult large = bench_run(algos[i].name, LARGE, algos[i].fn, &arg, LARGE);
+        if(small.iters > 0 || large.iters > 0){
+            print(STDERR_FILENO, "%-24s %6.2f GB/s (4 KiB)  %6.2f GB/s (1 MiB)\n", algos[i].name,
+                  small.mb_per_s / 1000, large.mb_per_s / 1000);
+        }
+    }
+    sec_free(data);
+}
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "../libs/codec.h"
+
+#define VALUES 4096
+
+struct codec_arg {
+    Buffer *buff;
+    uint32_t *values;
+};
+
+static void run_put_u32be(void *arg, uint64_t iters){
+    struct codec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->buff->size = 0;
+        for(size_t j = 0; j < VALUES; j ++){
+            buff_put_u32be(a->buff, a->values[j]);
+        }
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_put_u32be_array(void *arg, uint64_t iters){
+    struct codec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->buff->size = 0;
+        buff_put_u32be_array(a->buff, a->values, VALUES);
+    }
+    bench_clobber(a->buff->body);
+}
+
+static void run_get_u32be_array(void *arg, uint64_t iters){
+    struct codec_arg *a = arg;
+    BuffCursor cur;
+    for(uint64_t i = 0; i < iters; i ++){
+        buff_cursor_init(&cur, a->buff);
+        buff_get_u32be_array(&cur, a->values, VALUES);
+    }
+    bench_clobber(a->values);
+}
+
+static void run_uvarint(void *arg, uint64_t iters){
+    struct codec_arg *a = arg;
+    BuffCursor cur;
+    uint64_t sum = 0;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->buff->size = 0;
+        for(size_t j = 0; j < VALUES; j ++){
+            buff_put_uvarint(a->buff, a->values[j] >> (j & 31));
+        }
+        buff_cursor_init(&cur, a->buff);
+        for(size_t j = 0; j < VALUES; j ++){
+            sum += buff_get_uvarint(&cur);
+        }
+    }
+    bench_clobber(sum);
+}
+
+/**
+ * Benchmarks scalar and bulk fixed width encoding and varints.
+ *
+ * @returns None
+ */
+void bench_codec(void){
+    struct codec_arg arg;
+    arg.buff = buff_init(VALUES * VARINT_MAX);
+    arg.values = sec_malloc(VALUES * sizeof(uint32_t));
+    bench_fill(arg.values, VALUES * sizeof(uint32_t), 3);
+
+    bench_run("buff_put_u32be", VALUES, run_put_u32be, &arg, VALUES * 4);
+    bench_run("buff_put_u32be_array", VALUES, run_put_u32be_array, &arg, VALUES * 4);
+    buff_put_u32be_array(arg.buff, arg.values, VALUES);
+    bench_run("buff_get_u32be_array", VALUES, run_get_u32be_array, &arg, VALUES * 4);
+    bench_run("uvarint_roundtrip", VALUES, run_uvarint, &arg, 0);
+
+    buff_free(arg.buff);
+    sec_free(arg.values);
+}
@@ -0,0 +1,108 @@
+#include "bench.h"
+#include "../libs/encoding.h"
+
+#define INPUT ((size_t) 1 << 20)
+
+struct encoding_arg {
+    const byte *data;
+    Buffer *hex;
+    Buffer *base64;
+    Buffer *out;
+};
+
+/* the per-byte loops the encoding module replaces */
+static void run_naive_hex(void *arg, uint64_t iters){
+    static const char digits[] = "0123456789abcdef";
+    struct encoding_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        for(size_t j = 0; j < INPUT; j ++){
+            buff_append_byte(a->out, digits[a->data[j] >> 4]);
+            buff_append_byte(a->out, digits[a->data[j] & 0x0f]);
+        }
+        bench_clobber(a->out->body);
+    }
+}
+
+static void run_naive_base64(void *arg, uint64_t iters){
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    struct encoding_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        for(size_t j = 0; j + 3 <= INPUT; j += 3){
+            uint32_t v = (uint32_t) a->data[j] << 16 | a->data[j + 1] << 8 | a->data[j + 2];
+            buff_append_byte(a->out, alphabet[v >> 18]);
+            buff_append_byte(a->out, alphabet[(v >> 12) & 0x3f]);
+            buff_append_byte(a->out, alphabet[(v >> 6) & 0x3f]);
+            buff_append_byte(a->out, alphabet[v & 0x3f]);
+        }
+        bench_clobber(a->out->body);
+    }
+}
+
+static void run_hex_encode(void *arg, uint64_t iters){
+    struct encoding_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        buff_hex_encode(a->out, a->data, INPUT);
+        bench_clobber(a->out->body);
+    }
+}
+
+static void run_hex_decode(void *arg, uint64_t iters){
+    struct encoding_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        int rc = buff_hex_decode(a->out, buff_body(a->hex), buff_size(a->hex));
+        bench_clobber(rc);
+    }
+}
+
+static void run_base64_encode(void *arg, uint64_t iters){
+    struct encoding_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        buff_base64_encode(a->out, a->data, INPUT);
+        bench_clobber(a->out->body);
+    }
+}
+
+static void run_base64_decode(void *arg, uint64_t iters){
+    struct encoding_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        int rc = buff_base64_decode(a->out, buff_body(a->base64), buff_size(a->base64));
+        bench_clobber(rc);
+    }
+}
+
+/**
+ * Benchmarks hex and base64 encoding and decoding of 1 MiB against
+ * per-byte loops. Throughput is counted in decoded bytes.
+ *
+ * @returns None
+ */
+void bench_encoding(void){
+    struct encoding_arg arg;
+    byte *data = sec_malloc(INPUT);
+    bench_fill(data, INPUT, 6);
+    arg.data = data;
+    arg.hex = buff_init(enc_hex_len(INPUT));
+    arg.base64 = buff_init(enc_base64_len(INPUT));
+    arg.out = buff_init(enc_hex_len(INPUT));
+    buff_hex_encode(arg.hex, data, INPUT);
+    buff_base64_encode(arg.base64, data, INPUT);
+    print(STDERR_FILENO, "encoding implementation: %s\n", enc_impl());
+
+    bench_run("enc_naive_hex", INPUT, run_naive_hex, &arg, INPUT);
+    bench_run("buff_hex_encode", INPUT, run_hex_encode, &arg, INPUT);
+    bench_run("buff_hex_decode", INPUT, run_hex_decode, &arg, INPUT);
+    bench_run("enc_naive_base64", INPUT, run_naive_base64, &arg, INPUT);
+    bench_run("buff_base64_encode", INPUT, run_base64_encode, &arg, INPUT);
+    bench_run("buff_base64_decode", INPUT, run_base64_decode, &arg, INPUT);
+
+    buff_free(arg.out);
+    buff_free(arg.base64);
+    buff_free(arg.hex);
+    sec_free(data);
+}
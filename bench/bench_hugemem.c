@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "../libs/buffer.h"
+#include "../libs/hugemem.h"
+
+#define DATASET ((size_t) 256 << 20)
+#define PROBES 4096
+#define LIVE_BLOCKS 32
+
+struct hugemem_arg {
+    Buffer *buff;
+    size_t probes[PROBES];
+};
+
+static void run_sequential(void *arg, uint64_t iters){
+    struct hugemem_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        const uint64_t *words = a->buff->body;
+        uint64_t sum = 0;
+        for(size_t j = 0; j < a->buff->size / 8; j ++){
+            sum += words[j];
+        }
+        bench_clobber(sum);
+    }
+}
+
+/* loads at random offsets, each address depending on the previous load */
+static void run_random(void *arg, uint64_t iters){
+    struct hugemem_arg *a = arg;
+    const byte *body = a->buff->body;
+    size_t words = a->buff->size / 8;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t x = 0;
+        for(int j = 0; j < PROBES; j ++){
+            uint64_t v;
+            memcpy(&v, body + ((a->probes[j] ^ (x & 1)) % words) * 8, 8);
+            x += v;
+        }
+        bench_clobber(x);
+    }
+}
+
+/* grows a buffer to the dataset size the way appends do */
+static void run_grow(void *arg, uint64_t iters){
+    (void) arg;
+    uint64_t chunk[512] = { 0 };
+    for(uint64_t i = 0; i < iters; i ++){
+        Buffer *buff = buff_init(4096);
+        while(buff->size < DATASET){
+            buff_reserve(buff, sizeof(chunk));
+            buff_append(buff, chunk, sizeof(chunk));
+        }
+        buff_free(buff);
+    }
+}
+
+/* keeps many huge blocks live at once, so the block list has to grow */
+static void run_many(void *arg, uint64_t iters){
+    (void) arg;
+    void *blocks[LIVE_BLOCKS];
+    for(uint64_t i = 0; i < iters; i ++){
+        for(int j = 0; j < LIVE_BLOCKS; j ++){
+            blocks[j] = sec_malloc(HUGEMEM_THRESHOLD);
+            if(sec_tier(blocks[j]) < SEC_TIER_MAP){
+                print(STDERR_FILENO, "Error: block %d not from the huge page tier\n", j);
+                exit(EXIT_FAILURE);
+            }
+        }
+        for(int j = LIVE_BLOCKS - 1; j >= 0; j --){
+            sec_free(blocks[j]);
+        }
+    }
+}
+
+/* the process memory currently backed by transparent huge pages */
+static long anon_huge_kb(void){
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    long kb = -1;
+    if(f == NULL){
+        return kb;
+    }
+    char line[256];
+    while(fgets(line, sizeof(line), f) != NULL){
+        if(sscanf(line, "AnonHugePages: %ld", &kb) == 1){
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+/**
+ * Benchmarks scans over a 256 MiB buffer, sequential and random, with the
+ * buffer body on huge pages and on normal pages, and the cost of growing
+ * a buffer to that size through buff_reserve in both cases. Also times
+ * keeping 32 blocks of 4 MiB live at once.
+ *
+ * @returns None
+ */
+void bench_hugemem(void){
+    static const struct {
+        const char *tier;
+        size_t threshold;
+    } tiers[] = {
+        { "huge", HUGEMEM_THRESHOLD },
+        { "small", 0 },
+    };
+    struct hugemem_arg *arg = sec_malloc(sizeof(struct hugemem_arg));
+    uint64_t seed = 5;
+    for(int j = 0; j < PROBES; j ++){
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        arg->probes[j] = seed >> 11;
+    }
+    char name[64];
+    for(size_t t = 0; t < sizeof(tiers) / sizeof(tiers[0]); t ++){
+        hugemem_config(tiers[t].threshold, 0);
+        arg->buff = buff_init(DATASET);
+        bench_fill(arg->buff->body, DATASET, 17);
+        arg->buff->size = DATASET;
+        print(STDERR_FILENO, "%s pages: tier %d, %ld kB of the process on huge pages\n", tiers[t].tier,
+              sec_tier(arg->buff->body), anon_huge_kb());
+
+        snprintf(name, sizeof(name), "scan_seq_%s", tiers[t].tier);
+        bench_run(name, DATASET, run_sequential, arg, DATASET);
+        snprintf(name, sizeof(name), "scan_random_%s", tiers[t].tier);
+        bench_run(name, PROBES, run_random, arg, 0);
+        buff_free(arg->buff);
+
+        snprintf(name, sizeof(name), "grow_%s", tiers[t].tier);
+        bench_run(name, DATASET, run_grow, NULL, DATASET);
+    }
+    hugemem_config(HUGEMEM_THRESHOLD, 0);
+    bench_run("many_blocks", LIVE_BLOCKS, run_many, NULL, 0);
+    sec_free(arg);
+}
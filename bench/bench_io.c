@@ -0,0 +1,125 @@
+#include "bench.h"
+#include "../libs/buffer.h"
+
+static const size_t dump_sizes[] = { 1, 16, 64 };
+static const size_t io_sizes[] = { 64, 4096, 65536, 1 << 20 };
+
+struct io_arg {
+    int fd;
+    int peer;
+    byte *data;
+    size_t size;
+    Buffer *buff;
+};
+
+static void run_print(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        print(a->fd, "iteration %llu of %s\n", (unsigned long long) i, "print");
+    }
+}
+
+static void run_println(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        println(a->fd, "the quick brown fox jumps over the lazy dog");
+    }
+}
+
+/* the dumps write to stdout, so it is pointed at /dev/null meanwhile */
+static void run_bin_dump(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    int saved = sys_dup(STDOUT_FILENO);
+    sys_dup2(a->fd, STDOUT_FILENO);
+    for(uint64_t i = 0; i < iters; i ++){
+        bin_dump(a->data, a->size, LITTLE_ENDIAN);
+    }
+    sys_dup2(saved, STDOUT_FILENO);
+    sys_close(saved);
+}
+
+static void run_buff_dump(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    int saved = sys_dup(STDOUT_FILENO);
+    sys_dup2(a->fd, STDOUT_FILENO);
+    for(uint64_t i = 0; i < iters; i ++){
+        buff_dump(a->buff, a->size, LITTLE_ENDIAN);
+    }
+    sys_dup2(saved, STDOUT_FILENO);
+    sys_close(saved);
+}
+
+static void run_write(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        sys_write(a->fd, a->data, a->size);
+    }
+}
+
+static void run_read(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        sys_read(a->fd, a->data, a->size);
+    }
+}
+
+/* write then read back through a pipe, both copies go through the kernel */
+static void run_pipe(void *arg, uint64_t iters){
+    struct io_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        sys_write(a->peer, a->data, a->size);
+        for(size_t got = 0; got < a->size; ){
+            got += sys_read(a->fd, a->data + got, a->size - got);
+        }
+    }
+}
+
+/**
+ * Benchmarks formatted printing, the bit dumps and raw read/write
+ * throughput.
+ *
+ * @returns None
+ */
+void bench_io(void){
+    struct io_arg arg;
+    int pipefd[2];
+    size_t max = io_sizes[sizeof(io_sizes) / sizeof(io_sizes[0]) - 1];
+    arg.data = sec_malloc(max);
+    bench_fill(arg.data, max, 2);
+    arg.buff = buff_init(64);
+    buff_append(arg.buff, arg.data, 64);
+
+    arg.fd = sys_open("/dev/null", O_WRONLY);
+    bench_run("print", 0, run_print, &arg, 0);
+    bench_run("println", 0, run_println, &arg, 0);
+    for(size_t i = 0; i < sizeof(dump_sizes) / sizeof(dump_sizes[0]); i ++){
+        arg.size = dump_sizes[i];
+        bench_run("bin_dump", dump_sizes[i], run_bin_dump, &arg, dump_sizes[i]);
+        bench_run("buff_dump", dump_sizes[i], run_buff_dump, &arg, dump_sizes[i]);
+    }
+    for(size_t i = 0; i < sizeof(io_sizes) / sizeof(io_sizes[0]); i ++){
+        arg.size = io_sizes[i];
+        bench_run("sys_write_devnull", io_sizes[i], run_write, &arg, io_sizes[i]);
+    }
+    sys_close(arg.fd);
+
+    arg.fd = sys_open("/dev/zero", O_RDONLY);
+    for(size_t i = 0; i < sizeof(io_sizes) / sizeof(io_sizes[0]); i ++){
+        arg.size = io_sizes[i];
+        bench_run("sys_read_devzero", io_sizes[i], run_read, &arg, io_sizes[i]);
+    }
+    sys_close(arg.fd);
+
+    sys_pipe(pipefd);
+    arg.fd = pipefd[0];
+    arg.peer = pipefd[1];
+    for(size_t i = 0; i < sizeof(io_sizes) / sizeof(io_sizes[0]) - 1; i ++){
+        arg.size = io_sizes[i];
+        bench_run("sys_pipe_rw", io_sizes[i], run_pipe, &arg, io_sizes[i]);
+    }
+    sys_close(pipefd[0]);
+    sys_close(pipefd[1]);
+
+    buff_free(arg.buff);
+    sec_free(arg.data);
+}
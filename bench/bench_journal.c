@@ -0,0 +1,99 @@
+#include "bench.h"
+#include "../libs/journal.h"
+
+#include <pthread.h>
+
+#define RECORD 128
+
+static const int thread_counts[] = { 1, 2, 4, 8, 16 };
+
+struct journal_arg {
+    Journal *journal;
+    int fd;
+    pthread_mutex_t lock;
+    uint64_t per_thread;
+    int threads;
+    int naive;
+};
+
+/* the pattern being replaced: every record written and synced on its own */
+static void append_naive(struct journal_arg *a, const byte *record){
+    pthread_mutex_lock(&a->lock);
+    sys_write(a->fd, record, RECORD);
+    if(fdatasync(a->fd) == -1){
+        print_err_exit("fdatasync", errno);
+    }
+    pthread_mutex_unlock(&a->lock);
+}
+
+static void *writer(void *arg){
+    struct journal_arg *a = arg;
+    byte record[RECORD];
+    bench_fill(record, RECORD, 13);
+    for(uint64_t i = 0; i < a->per_thread; i ++){
+        if(a->naive){
+            append_naive(a, record);
+        }else{
+            journal_append(a->journal, record, RECORD);
+        }
+    }
+    return NULL;
+}
+
+static void run_threads(void *arg, uint64_t iters){
+    struct journal_arg *a = arg;
+    pthread_t threads[16];
+    a->per_thread = (iters + a->threads - 1) / a->threads;
+    for(int t = 0; t < a->threads; t ++){
+        pthread_create(&threads[t], NULL, writer, a);
+    }
+    for(int t = 0; t < a->threads; t ++){
+        pthread_join(threads[t], NULL);
+    }
+}
+
+/**
+ * Benchmarks durable appends of 128 byte records from 1 to 16 threads,
+ * through the group committing journal and through a write and fdatasync
+ * per record, in a scratch file under /tmp.
+ *
+ * @returns None
+ */
+void bench_journal(void){
+    char path[] = "/tmp/bench-journal-XXXXXX";
+    int fd = mkstemp(path);
+    if(fd == -1){
+        print_err_exit("mkstemp", errno);
+    }
+    sys_close(fd);
+
+    struct journal_arg arg;
+    pthread_mutex_init(&arg.lock, NULL);
+    for(size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i ++){
+        arg.threads = thread_counts[i];
+
+        arg.naive = 1;
+        arg.fd = sys_open(path, O_WRONLY | O_APPEND);
+        BenchResult res = bench_run("fdatasync_each", arg.threads, run_threads, &arg, RECORD);
+        if(res.iters > 0){
+            print(STDERR_FILENO, "%-16s %2d threads  %9.0f records/s\n", "fdatasync_each",
+                  arg.threads, 1e9 / res.median_ns);
+        }
+        sys_close(arg.fd);
+
+        arg.naive = 0;
+        arg.journal = journal_open(path, NULL, NULL);
+        uint64_t commits = arg.journal->commits;
+        res = bench_run("journal_append", arg.threads, run_threads, &arg, RECORD);
+        if(res.iters > 0){
+            print(STDERR_FILENO, "%-16s %2d threads  %9.0f records/s  %.1f records/commit\n",
+                  "journal_append", arg.threads, 1e9 / res.median_ns,
+                  (double) (arg.journal->end / (8 + RECORD)) / (arg.journal->commits - commits + 1));
+        }
+        journal_close(arg.journal);
+        sys_unlink(path);
+        sys_close(sys_creat(path, 0600));
+    }
+    pthread_mutex_destroy(&arg.lock);
+    sys_unlink(path);
+}
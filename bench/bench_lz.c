@@ -0,0 +1,139 @@
+#include "bench.h"
+#include "../libs/lz.h"
+
+#define CORPUS ((size_t) 1 << 20)
+
+struct lz_arg {
+    Buffer *input;
+    Buffer *packed;
+    Buffer *out;
+};
+
+static uint64_t next(uint64_t *x){
+    *x = *x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *x >> 33;
+}
+
+/* service log lines: a few templates, varying numbers and ids */
+static void corpus_log(Buffer *buff){
+    static const char *levels[] = { "INFO", "INFO", "INFO", "WARN", "DEBUG", "ERROR" };
+    static const char *paths[] = { "/api/v1/items", "/api/v1/users", "/health", "/api/v2/orders/search" };
+    uint64_t x = 1;
+    char line[160];
+    while(buff_size(buff) < CORPUS){
+        int len = snprintf(line, sizeof(line), "2024-05-%02llu %02llu:%02llu:%02llu %s request id=%08llx path=%s status=%d took=%llums\n",
+                           (unsigned long long) next(&x) % 28 + 1, (unsigned long long) next(&x) % 24,
+                           (unsigned long long) next(&x) % 60, (unsigned long long) next(&x) % 60,
+                           levels[next(&x) % 6], (unsigned long long) next(&x), paths[next(&x) % 4],
+                           next(&x) % 10 ? 200 : 404, (unsigned long long) next(&x) % 500);
+        buff_append(buff, line, len);
+    }
+    buff->size = CORPUS;
+}
+
+/* JSON records with repeated keys */
+static void corpus_json(Buffer *buff){
+    static const char *names[] = { "alice", "bob", "carol", "dave", "erin", "frank" };
+    uint64_t x = 2;
+    char rec[200];
+    while(buff_size(buff) < CORPUS){
+        int len = snprintf(rec, sizeof(rec), "{\"id\":%llu,\"name\":\"%s\",\"active\":%s,\"score\":%llu.%02llu,\"tags\":[\"a\",\"b%llu\"]},\n",
+                           (unsigned long long) next(&x) % 100000, names[next(&x) % 6],
+                           next(&x) % 2 ? "true" : "false", (unsigned long long) next(&x) % 1000,
+                           (unsigned long long) next(&x) % 100, (unsigned long long) next(&x) % 8);
+        buff_append(buff, rec, len);
+    }
+    buff->size = CORPUS;
+}
+
+/* fixed size binary records: increasing timestamps, small counters, floats */
+static void corpus_binary(Buffer *buff){
+    uint64_t x = 3, ts = 1700000000000ULL;
+    while(buff_size(buff) + 24 <= CORPUS){
+        struct { uint64_t ts; uint32_t sensor; uint32_t count; float value; float pad; } rec;
+        ts += next(&x) % 1000;
+        rec.ts = ts;
+        rec.sensor = next(&x) % 16;
+        rec.count = next(&x) % 256;
+        rec.value = (float) (next(&x) % 10000) / 100;
+        rec.pad = 0;
+        buff_append(buff, &rec, 24);
+    }
+    buff->size = CORPUS;
+}
+
+static void corpus_random(Buffer *buff){
+    bench_fill(buff_body(buff), CORPUS, 4);
+    buff->size = CORPUS;
+}
+
+static const struct {
+    const char *name;
+    void (*fill)(Buffer *buff);
+} corpora[] = {
+    { "log", corpus_log },
+    { "json", corpus_json },
+    { "binary", corpus_binary },
+    { "random", corpus_random },
+};
+
+static void run_memcpy(void *arg, uint64_t iters){
+    struct lz_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        memcpy(buff_body(a->out), buff_body(a->input), CORPUS);
+        bench_clobber(a->out->body);
+    }
+}
+
+static void run_compress(void *arg, uint64_t iters){
+    struct lz_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->packed->size = 0;
+        lz_compress(a->packed, buff_body(a->input), CORPUS, 0);
+        bench_clobber(a->packed->body);
+    }
+}
+
+static void run_decompress(void *arg, uint64_t iters){
+    struct lz_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        a->out->size = 0;
+        int rc = lz_decompress(a->out, buff_body(a->packed), buff_size(a->packed));
+        bench_clobber(rc);
+    }
+}
+
+/**
+ * Benchmarks frame compression and decompression on 1 MiB of generated
+ * log, JSON, binary and random data, and reports the compression ratio
+ * of each. Throughput is counted in uncompressed bytes.
+ *
+ * @returns None
+ */
+void bench_lz(void){
+    struct lz_arg arg;
+    arg.input = buff_init(CORPUS + 256);
+    arg.packed = buff_init(lz_bound(CORPUS) + 1024);
+    arg.out = buff_init(CORPUS + 64);
+    char name[64];
+
+    for(size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i ++){
+        arg.input->size = 0;
+        corpora[i].fill(arg.input);
+        arg.packed->size = 0;
+        lz_compress(arg.packed, buff_body(arg.input), CORPUS, 0);
+        print(STDERR_FILENO, "lz corpus %-8s %8zu -> %8zu bytes  ratio %.2f\n", corpora[i].name,
+              CORPUS, buff_size(arg.packed), (double) CORPUS / buff_size(arg.packed));
+
+        if(i == 0){
+            bench_run("lz_memcpy", CORPUS, run_memcpy, &arg, CORPUS);
+        }
+        snprintf(name, sizeof(name), "lz_compress_%s", corpora[i].name);
+        bench_run(name, CORPUS, run_compress, &arg, CORPUS);
+        snprintf(name, sizeof(name), "lz_decompress_%s", corpora[i].name);
+        bench_run(name, CORPUS, run_decompress, &arg, CORPUS);
+    }
+    buff_free(arg.out);
+    buff_free(arg.packed);
+    buff_free(arg.input);
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+
+/**
+ * A group of related benchmarks.
+ *
+ * @param name The suite name, selectable with --suite.
+ * @param run Runs every benchmark of the suite.
+ */
+struct suite {
+    const char *name;
+    void (*run)(void);
+};
+
+static const struct suite suites[] = {
+    { "buffer", bench_buffer },
+    { "io", bench_io },
+    { "codec", bench_codec },
+    { "scan", bench_scan },
+    { "checksum", bench_checksum },
+    { "encoding", bench_encoding },
+    { "lz", bench_lz },
+    { "map", bench_map },
+    { "vec", bench_vec },
+    { "ring", bench_ring },
+    { "region", bench_region },
+    { "journal", bench_journal },
+    { "replace", bench_replace },
+    { "slab", bench_slab },
+    { "alloc", bench_alloc },
+    { "secheap", bench_secheap },
+    { "hugemem", bench_hugemem },
+    { "topo", bench_topo },
+    { "numa", bench_numa },
+};
+
+static void usage(const char *prog){
+    print(STDERR_FILENO,
+          "usage: %s [--reps N] [--warmup N] [--min-time-ms N] [--filter STR]\n"
+          "          [--suite NAME] [--out FILE]\n"
+          "       %s --compare OLD.csv NEW.csv [--threshold PCT]\n", prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]){
+    const char *suite = NULL;
+    const char *compare_old = NULL, *compare_new = NULL;
+    double threshold = 5.0;
+
+    for(int i = 1; i < argc; i ++){
+        int more = i + 1 < argc;
+        if(strcmp(argv[i], "--reps") == 0 && more){
+            bench_config.reps = atoi(argv[++ i]);
+        }else if(strcmp(argv[i], "--warmup") == 0 && more){
+            bench_config.warmup = atoi(argv[++ i]);
+        }else if(strcmp(argv[i], "--min-time-ms") == 0 && more){
+            bench_config.min_rep_ns = strtoull(argv[++ i], NULL, 10) * 1000000ULL;
+        }else if(strcmp(argv[i], "--filter") == 0 && more){
+            bench_config.filter = argv[++ i];
+        }else if(strcmp(argv[i], "--suite") == 0 && more){
+            suite = argv[++ i];
+        }else if(strcmp(argv[i], "--out") == 0 && more){
+            bench_config.out = sys_creat(argv[++ i], 0644);
+        }else if(strcmp(argv[i], "--compare") == 0 && i + 2 < argc){
+            compare_old = argv[++ i];
+            compare_new = argv[++ i];
+        }else if(strcmp(argv[i], "--threshold") == 0 && more){
+            threshold = atof(argv[++ i]);
+        }else{
+            usage(argv[0]);
+        }
+    }
+    if(bench_config.reps < 1){
+        usage(argv[0]);
+    }
+
+    if(compare_old != NULL){
+        return bench_compare(compare_old, compare_new, threshold) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    clk_tsc_calibrate();
+    bench_header();
+    for(size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i ++){
+        if(suite == NULL || strcmp(suite, suites[i].name) == 0){
+            suites[i].run();
+        }
+    }
+    if(bench_config.out != STDOUT_FILENO){
+        sys_close(bench_config.out);
+    }
+    return EXIT_SUCCESS;
+}
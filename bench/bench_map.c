@@ -0,0 +1,248 @@
+#include "bench.h"
+#include "../libs/hashmap.h"
+
+static const size_t counts[] = { 1000000, 10000000, 100000000 };
+
+/* rough peak bytes per entry across both tables, the key arrays and growth */
+#define BYTES_PER_ENTRY 96
+
+/* the separate chaining table projects usually write: one node per entry */
+struct node {
+    uint64_t key;
+    uint64_t value;
+    struct node *next;
+};
+
+struct chained {
+    struct node **buckets;
+    size_t mask;
+    size_t size;
+};
+
+static uint64_t chained_hash(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static struct chained *chained_init(void){
+    struct chained *t = sec_malloc(sizeof(struct chained));
+    t->mask = 15;
+    t->size = 0;
+    t->buckets = sec_calloc(t->mask + 1, sizeof(struct node *));
+    return t;
+}
+
+static void chained_put(struct chained *t, uint64_t key, uint64_t value){
+    struct node **head = &t->buckets[chained_hash(key) & t->mask];
+    for(struct node *n = *head; n != NULL; n = n->next){
+        if(n->key == key){
+            n->value = value;
+            return;
+        }
+    }
+    struct node *n = sec_malloc(sizeof(struct node));
+    n->key = key;
+    n->value = value;
+    n->next = *head;
+    *head = n;
+    if(++ t->size > t->mask + 1){
+        size_t mask = t->mask * 2 + 1;
+        struct node **buckets = sec_calloc(mask + 1, sizeof(struct node *));
+        for(size_t i = 0; i <= t->mask; i ++){
+            for(struct node *m = t->buckets[i], *next; m != NULL; m = next){
+                next = m->next;
+                size_t b = chained_hash(m->key) & mask;
+                m->next = buckets[b];
+                buckets[b] = m;
+            }
+        }
+        sec_free(t->buckets);
+        t->buckets = buckets;
+        t->mask = mask;
+    }
+}
+
+static uint64_t *chained_get(struct chained *t, uint64_t key){
+    for(struct node *n = t->buckets[chained_hash(key) & t->mask]; n != NULL; n = n->next){
+        if(n->key == key){
+            return &n->value;
+        }
+    }
+    return NULL;
+}
+
+static void chained_free(struct chained *t){
+    for(size_t i = 0; i <= t->mask; i ++){
+        for(struct node *n = t->buckets[i], *next; n != NULL; n = next){
+            next = n->next;
+            sec_free(n);
+        }
+    }
+    sec_free(t->buckets);
+    sec_free(t);
+}
+
+struct map_arg {
+    uint64_t *keys;
+    uint64_t *lookup;
+    uint64_t *absent;
+    size_t count;
+    Map *map;
+    struct chained *chained;
+};
+
+static void run_map_insert(void *arg, uint64_t iters){
+    struct map_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        Map *map = map_init(8, 8);
+        for(size_t j = 0; j < a->count; j ++){
+            map_put(map, &a->keys[j], &j);
+        }
+        bench_clobber(map->ctrl);
+        map_free(map);
+    }
+}
+
+static void run_map_hit(void *arg, uint64_t iters){
+    struct map_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t sum = 0;
+        for(size_t j = 0; j < a->count; j ++){
+            sum += *(uint64_t *) map_get(a->map, &a->lookup[j]);
+        }
+        bench_clobber(sum);
+    }
+}
+
+static void run_map_miss(void *arg, uint64_t iters){
+    struct map_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        size_t found = 0;
+        for(size_t j = 0; j < a->count; j ++){
+            found += map_get(a->map, &a->absent[j]) != NULL;
+        }
+        bench_clobber(found);
+    }
+}
+
+static void run_chained_insert(void *arg, uint64_t iters){
+    struct map_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        struct chained *t = chained_init();
+        for(size_t j = 0; j < a->count; j ++){
+            chained_put(t, a->keys[j], j);
+        }
+        bench_clobber(t->buckets);
+        chained_free(t);
+    }
+}
+
+static void run_chained_hit(void *arg, uint64_t iters){
+    struct map_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t sum = 0;
+        for(size_t j = 0; j < a->count; j ++){
+            sum += *chained_get(a->chained, a->lookup[j]);
+        }
+        bench_clobber(sum);
+    }
+}
+
+static void run_chained_miss(void *arg, uint64_t iters){
+    struct map_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        size_t found = 0;
+        for(size_t j = 0; j < a->count; j ++){
+            found += chained_get(a->chained, a->absent[j]) != NULL;
+        }
+        bench_clobber(found);
+    }
+}
+
+/* reserves an arena over 2 GiB, large values, then touches a few slots */
+static void run_map_reserve_large(void *arg, uint64_t iters){
+    (void) arg;
+    byte value[1016] = { 0 };
+    for(uint64_t i = 0; i < iters; i ++){
+        Map *map = map_init(8, sizeof(value));
+        map_reserve(map, 1 << 20);
+        for(uint64_t key = 0; key < 64; key ++){
+            map_put(map, &key, value);
+        }
+        bench_clobber(map_size(map));
+        map_free(map);
+    }
+}
+
+static void report(const char *name, size_t count, BenchResult res){
+    if(res.iters > 0){
+        print(STDERR_FILENO, "%-24s %10zu  %8.1f ns/op\n", name, count, res.median_ns / count);
+    }
+}
+
+/**
+ * Benchmarks building the map from empty and looking up present and absent
+ * random 64-bit keys, against a separate chaining table, at 1M, 10M and
+ * 100M entries. Sizes that do not fit in the available memory are skipped.
+ * Also times reserving room for 1M entries of 1 KiB, an arena over 2 GiB
+ * of which only the control bytes and a few slots are touched.
+ *
+ * @returns None
+ */
+void bench_map(void){
+    size_t avail = (size_t) sysconf(_SC_AVPHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE);
+    bench_run("map_reserve_large", 1 << 20, run_map_reserve_large, NULL, 0);
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c ++){
+        struct map_arg arg;
+        arg.count = counts[c];
+        if(arg.count * BYTES_PER_ENTRY > avail){
+            print(STDERR_FILENO, "map: skipping %zu entries, needs about %zu MiB\n", arg.count,
+                  arg.count * BYTES_PER_ENTRY >> 20);
+            continue;
+        }
+        /* odd keys are inserted, even keys are the misses */
+        arg.keys = sec_malloc(arg.count * sizeof(uint64_t));
+        arg.absent = sec_malloc(arg.count * sizeof(uint64_t));
+        bench_fill(arg.keys, arg.count * sizeof(uint64_t), 7);
+        bench_fill(arg.absent, arg.count * sizeof(uint64_t), 8);
+        for(size_t j = 0; j < arg.count; j ++){
+            arg.keys[j] |= 1;
+            arg.absent[j] &= ~(uint64_t) 1;
+        }
+        /* hits in another order than the inserts, or chained nodes would be visited in allocation order */
+        arg.lookup = sec_malloc(arg.count * sizeof(uint64_t));
+        memcpy(arg.lookup, arg.keys, arg.count * sizeof(uint64_t));
+        uint64_t x = 9;
+        for(size_t j = arg.count - 1; j > 0; j --){
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            size_t k = (x >> 11) % (j + 1);
+            uint64_t t = arg.lookup[j];
+            arg.lookup[j] = arg.lookup[k];
+            arg.lookup[k] = t;
+        }
+
+        report("map_insert", arg.count, bench_run("map_insert", arg.count, run_map_insert, &arg, 0));
+        arg.map = map_init(8, 8);
+        for(size_t j = 0; j < arg.count; j ++){
+            map_put(arg.map, &arg.keys[j], &j);
+        }
+        report("map_get_hit", arg.count, bench_run("map_get_hit", arg.count, run_map_hit, &arg, 0));
+        report("map_get_miss", arg.count, bench_run("map_get_miss", arg.count, run_map_miss, &arg, 0));
+        map_free(arg.map);
+
+        report("chained_insert", arg.count, bench_run("chained_insert", arg.count, run_chained_insert, &arg, 0));
+        arg.chained = chained_init();
+        for(size_t j = 0; j < arg.count; j ++){
+            chained_put(arg.chained, arg.keys[j], j);
+        }
+        report("chained_get_hit", arg.count, bench_run("chained_get_hit", arg.count, run_chained_hit, &arg, 0));
+        report("chained_get_miss", arg.count, bench_run("chained_get_miss", arg.count, run_chained_miss, &arg, 0));
+        chained_free(arg.chained);
+
+        sec_free(arg.lookup);
+        sec_free(arg.absent);
+        sec_free(arg.keys);
+    }
+}
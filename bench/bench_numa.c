@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "../libs/hugemem.h"
+#include "../libs/mpol.h"
+#include "../libs/topo.h"
+
+#define DATASET ((size_t) 256 << 20)
+#define INIT_SIZE ((size_t) 64 << 20)
+
+struct numa_arg {
+    uint64_t *words;
+    int threads;
+};
+
+static void run_read(void *arg, uint64_t iters){
+    struct numa_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t sum = 0;
+        for(size_t j = 0; j < DATASET / 8; j ++){
+            sum += a->words[j];
+        }
+        bench_clobber(sum);
+    }
+}
+
+/* fills a slice with a pattern that depends on its offset */
+static void fill_slice(void *ctx, void *slice, size_t offset, size_t len){
+    (void) ctx;
+    uint64_t *words = slice;
+    for(size_t i = 0; i < len / 8; i ++){
+        words[i] = (offset / 8 + i) * 0x9e3779b97f4a7c15ULL;
+    }
+}
+
+static void run_init(void *arg, uint64_t iters){
+    struct numa_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        void *block = hugemem_map(INIT_SIZE);
+        mpol_first_touch(block, INIT_SIZE, a->threads, fill_slice, NULL);
+        bench_clobber(((uint64_t *) block)[INIT_SIZE / 16]);
+        hugemem_free(block);
+    }
+}
+
+/**
+ * Benchmarks sequential reads of 256 MiB Buffers bound to node 0 and
+ * interleaved over all nodes, and filling fresh 64 MiB blocks from one
+ * thread against first touch from one thread per allowed CPU. On a
+ * single node machine the placements are no-ops and the read cases
+ * match. The node of the first page of each buffer is reported.
+ *
+ * @returns None
+ */
+void bench_numa(void){
+    Topology *topo = topo_load();
+    int allowed = topo->nallowed;
+    topo_free(topo);
+    print(STDERR_FILENO, "%d nodes\n", mpol_nodes());
+
+    struct numa_arg arg;
+    Buffer *bound = mpol_buff(DATASET, 0);
+    mpol_first_touch(bound->body, DATASET, 1, fill_slice, NULL);
+    print(STDERR_FILENO, "bound buffer on node %d\n", mpol_node_of(bound->body));
+    arg.words = bound->body;
+    bench_run("read_bound_node0", DATASET, run_read, &arg, DATASET);
+    buff_free(bound);
+
+    void *spread = hugemem_map(DATASET);
+    if(mpol_interleave(spread, DATASET) == -1){
+        print_err_exit("mbind", errno);
+    }
+    mpol_first_touch(spread, DATASET, allowed, fill_slice, NULL);
+    print(STDERR_FILENO, "interleaved block starts on node %d\n", mpol_node_of(spread));
+    arg.words = spread;
+    bench_run("read_interleaved", DATASET, run_read, &arg, DATASET);
+    hugemem_free(spread);
+
+    arg.threads = 1;
+    bench_run("init_one_thread", INIT_SIZE, run_init, &arg, INIT_SIZE);
+    arg.threads = allowed;
+    bench_run("init_first_touch", INIT_SIZE, run_init, &arg, INIT_SIZE);
+}
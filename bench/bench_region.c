@@ -0,0 +1,94 @@
+#include "bench.h"
+#include "../libs/region.h"
+
+#include <sys/wait.h>
+
+#define DATASET ((size_t) 32 << 20)
+#define WORKERS 2
+
+struct region_arg {
+    Region *region;
+    Buffer *shared;
+    byte *data;
+};
+
+/* what a worker does with the dataset, the same in both variants */
+static uint64_t consume(const byte *data, size_t size){
+    uint64_t sum = 0;
+    for(size_t i = 0; i + 8 <= size; i += 8){
+        uint64_t x;
+        memcpy(&x, data + i, 8);
+        sum += x;
+    }
+    return sum;
+}
+
+/* workers read the published buffer in place */
+static void run_region(void *arg, uint64_t iters){
+    struct region_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        for(int w = 0; w < WORKERS; w ++){
+            if(sys_fork() == 0){
+                uint64_t sum = consume(a->shared->body, a->shared->size);
+                bench_clobber(sum);
+                _exit(0);
+            }
+        }
+        for(int w = 0; w < WORKERS; w ++){
+            sys_waitpid(-1, NULL, 0);
+        }
+    }
+}
+
+/* workers get their own copy of the dataset through a pipe */
+static void run_pipe(void *arg, uint64_t iters){
+    struct region_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        int fds[WORKERS][2];
+        for(int w = 0; w < WORKERS; w ++){
+            sys_pipe(fds[w]);
+            if(sys_fork() == 0){
+                sys_close(fds[w][1]);
+                byte *copy = sec_malloc(DATASET);
+                for(size_t got = 0; got < DATASET; ){
+                    got += sys_read(fds[w][0], copy + got, DATASET - got);
+                }
+                uint64_t sum = consume(copy, DATASET);
+                bench_clobber(sum);
+                _exit(0);
+            }
+            sys_close(fds[w][0]);
+        }
+        for(int w = 0; w < WORKERS; w ++){
+            for(size_t put = 0; put < DATASET; ){
+                put += sys_write(fds[w][1], a->data + put, DATASET - put);
+            }
+            sys_close(fds[w][1]);
+        }
+        for(int w = 0; w < WORKERS; w ++){
+            sys_waitpid(-1, NULL, 0);
+        }
+    }
+}
+
+/**
+ * Benchmarks handing a 32 MiB dataset to two forked workers that each
+ * read all of it: published once in a shared region, against a copy sent
+ * to each worker over a pipe.
+ *
+ * @returns None
+ */
+void bench_region(void){
+    struct region_arg arg;
+    arg.data = sec_malloc(DATASET);
+    bench_fill(arg.data, DATASET, 12);
+    arg.region = region_create(DATASET + 4096);
+    arg.shared = region_buff(arg.region, DATASET);
+    region_buff_append(arg.region, arg.shared, arg.data, DATASET);
+
+    bench_run("region_publish", DATASET, run_region, &arg, DATASET * WORKERS);
+    bench_run("pipe_publish", DATASET, run_pipe, &arg, DATASET * WORKERS);
+
+    region_free(arg.region);
+    sec_free(arg.data);
+}
@@ -0,0 +1,92 @@
+#include "bench.h"
+#include "../libs/replace.h"
+
+/* files rewritten per run, reused round robin */
+#define FILES 1000
+#define FILE_SIZE 512
+
+static const size_t batch_sizes[] = { 1, 16, 256 };
+
+struct replace_arg {
+    char dir[32];
+    byte data[FILE_SIZE];
+    size_t batch;
+};
+
+static void file_path(struct replace_arg *a, uint64_t i, char *path, size_t size){
+    snprintf(path, size, "%s/state%04u", a->dir, (unsigned) (i % FILES));
+}
+
+/* the pattern being replaced: temp file, fsync, rename and directory fsync for each file */
+static void run_by_hand(void *arg, uint64_t iters){
+    struct replace_arg *a = arg;
+    char path[64], tmp[80];
+    for(uint64_t i = 0; i < iters; i ++){
+        file_path(a, i, path, sizeof(path));
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+        int fd = sys_creat(tmp, 0644);
+        sys_write(fd, a->data, FILE_SIZE);
+        if(fsync(fd) == -1){
+            print_err_exit("fsync", errno);
+        }
+        sys_close(fd);
+        sys_rename(tmp, path);
+        int dir = sys_open(a->dir, O_RDONLY);
+        if(fsync(dir) == -1){
+            print_err_exit("fsync", errno);
+        }
+        sys_close(dir);
+    }
+}
+
+static void run_batched(void *arg, uint64_t iters){
+    struct replace_arg *a = arg;
+    char path[64];
+    for(uint64_t i = 0; i < iters; ){
+        ReplaceBatch *batch = replace_begin();
+        for(size_t j = 0; j < a->batch && i < iters; j ++, i ++){
+            file_path(a, i, path, sizeof(path));
+            if(replace_add(batch, path, a->data, FILE_SIZE, 0644) == -1){
+                print_err_exit("replace_add", errno);
+            }
+        }
+        if(replace_commit(batch) == -1){
+            print_err_exit("replace_commit", errno);
+        }
+    }
+}
+
+/**
+ * Benchmarks durably rewriting small files: a temp file, fsync, rename
+ * and directory fsync each, against replace batches of 1, 16 and 256
+ * files, in a scratch directory under /tmp.
+ *
+ * @returns None
+ */
+void bench_replace(void){
+    struct replace_arg arg;
+    strcpy(arg.dir, "/tmp/bench-replace-XXXXXX");
+    if(mkdtemp(arg.dir) == NULL){
+        print_err_exit("mkdtemp", errno);
+    }
+    bench_fill(arg.data, FILE_SIZE, 14);
+
+    BenchResult res = bench_run("replace_by_hand", 1, run_by_hand, &arg, FILE_SIZE);
+    if(res.iters > 0){
+        print(STDERR_FILENO, "%-16s %4d  %8.0f files/s\n", "replace_by_hand", 1, 1e9 / res.median_ns);
+    }
+    for(size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i ++){
+        arg.batch = batch_sizes[i];
+        res = bench_run("replace_batch", arg.batch, run_batched, &arg, FILE_SIZE);
+        if(res.iters > 0){
+            print(STDERR_FILENO, "%-16s %4zu  %8.0f files/s\n", "replace_batch", arg.batch, 1e9 / res.median_ns);
+        }
+    }
+
+    char path[64];
+    for(uint64_t i = 0; i < FILES; i ++){
+        file_path(&arg, i, path, sizeof(path));
+        unlink(path);
+    }
+    sys_rmdir(arg.dir);
+}
@@ -0,0 +1,140 @@
+#include "bench.h"
+#include "../libs/ring.h"
+
+#include <sys/wait.h>
+
+/* messages per batch in the batched runs */
+#define BATCH 32
+
+/* the last message of a run asks the consumer for an ack, so a run ends once all is consumed */
+#define MSG_DATA 0
+#define MSG_ACK 1
+#define MSG_STOP 2
+
+struct msg {
+    uint64_t seq;
+    uint64_t kind;
+};
+
+struct ring_arg {
+    Ring *ring;
+    int data[2];
+    int ack[2];
+    size_t batch;
+    pid_t consumer;
+};
+
+static void consume_ring(struct ring_arg *a){
+    struct msg msgs[BATCH];
+    for(;;){
+        size_t n = ring_dequeue_wait(a->ring, msgs, BATCH);
+        for(size_t i = 0; i < n; i ++){
+            if(msgs[i].kind == MSG_ACK){
+                sys_write(a->ack[1], "", 1);
+            }else if(msgs[i].kind == MSG_STOP){
+                _exit(0);
+            }
+        }
+    }
+}
+
+static void consume_pipe(struct ring_arg *a){
+    struct msg m;
+    for(;;){
+        for(size_t got = 0; got < sizeof(m); ){
+            got += sys_read(a->data[0], (byte *) &m + got, sizeof(m) - got);
+        }
+        if(m.kind == MSG_ACK){
+            sys_write(a->ack[1], "", 1);
+        }else if(m.kind == MSG_STOP){
+            _exit(0);
+        }
+    }
+}
+
+static void run_ring(void *arg, uint64_t iters){
+    struct ring_arg *a = arg;
+    struct msg msgs[BATCH];
+    for(uint64_t i = 0; i < iters; ){
+        size_t n = iters - i < a->batch ? iters - i : a->batch;
+        for(size_t j = 0; j < n; j ++){
+            msgs[j].seq = i + j;
+            msgs[j].kind = i + j == iters - 1 ? MSG_ACK : MSG_DATA;
+        }
+        ring_enqueue_wait(a->ring, msgs, n);
+        i += n;
+    }
+    char ack;
+    sys_read(a->ack[0], &ack, 1);
+}
+
+static void run_pipe(void *arg, uint64_t iters){
+    struct ring_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        struct msg m = { i, i == iters - 1 ? MSG_ACK : MSG_DATA };
+        sys_write(a->data[1], &m, sizeof(m));
+    }
+    char ack;
+    sys_read(a->ack[0], &ack, 1);
+}
+
+static void start(struct ring_arg *a, void (*consume)(struct ring_arg *)){
+    if((a->consumer = sys_fork()) == 0){
+        consume(a);
+    }
+}
+
+static void stop(struct ring_arg *a){
+    struct msg m = { 0, MSG_STOP };
+    if(a->ring != NULL){
+        ring_enqueue_wait(a->ring, &m, 1);
+    }else{
+        sys_write(a->data[1], &m, sizeof(m));
+    }
+    sys_waitpid(a->consumer, NULL, 0);
+}
+
+static void report(const char *name, BenchResult res){
+    if(res.iters > 0){
+        print(STDERR_FILENO, "%-16s %8.1f M msgs/s\n", name, 1e3 / res.median_ns);
+    }
+}
+
+/**
+ * Benchmarks passing 16 byte messages to a forked consumer through the
+ * shared memory ring, one at a time and in batches, in both modes, against
+ * a pipe.
+ *
+ * @returns None
+ */
+void bench_ring(void){
+    static const char *names[2][2] = { { "ring_spsc", "ring_spsc_batch" },
+                                       { "ring_mpmc", "ring_mpmc_batch" } };
+    struct ring_arg arg;
+    sys_pipe(arg.ack);
+    for(int mode = RING_SPSC; mode <= RING_MPMC; mode ++){
+        for(int batched = 0; batched < 2; batched ++){
+            if(!bench_selected(names[mode][batched])){
+                continue;
+            }
+            arg.ring = ring_create(NULL, sizeof(struct msg), 4096, mode);
+            arg.batch = batched ? BATCH : 1;
+            start(&arg, consume_ring);
+            report(names[mode][batched], bench_run(names[mode][batched], arg.batch, run_ring, &arg,
+                                                   sizeof(struct msg)));
+            stop(&arg);
+            ring_close(arg.ring);
+        }
+    }
+    if(bench_selected("pipe_msgs")){
+        arg.ring = NULL;
+        sys_pipe(arg.data);
+        start(&arg, consume_pipe);
+        report("pipe_msgs", bench_run("pipe_msgs", 1, run_pipe, &arg, sizeof(struct msg)));
+        stop(&arg);
+        sys_close(arg.data[0]);
+        sys_close(arg.data[1]);
+    }
+    sys_close(arg.ack[0]);
+    sys_close(arg.ack[1]);
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+#include "../libs/scan.h"
+
+#define HAYSTACK ((size_t) 1 << 20)
+
+struct scan_arg {
+    Buffer *buff;
+    ByteSet set;
+};
+
+/* the byte-by-byte loop the scan module replaces */
+static void run_naive(void *arg, uint64_t iters){
+    struct scan_arg *a = arg;
+    const byte *p = buff_body(a->buff);
+    size_t n = buff_size(a->buff), at = n;
+    for(uint64_t i = 0; i < iters; i ++){
+        for(size_t j = 0; j < n; j ++){
+            if(p[j] == '\n'){
+                at = j;
+                break;
+            }
+        }
+        bench_clobber(at);
+    }
+}
+
+static void run_find_byte(void *arg, uint64_t iters){
+    struct scan_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        ssize_t at = buff_find_byte(a->buff, 0, '\n');
+        bench_clobber(at);
+    }
+}
+
+static void run_find_any(void *arg, uint64_t iters){
+    struct scan_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        ssize_t at = buff_find_any(a->buff, 0, &a->set);
+        bench_clobber(at);
+    }
+}
+
+static void run_find_sub(void *arg, uint64_t iters){
+    struct scan_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        ssize_t at = buff_find_sub(a->buff, 0, "ERROR:", 6);
+        bench_clobber(at);
+    }
+}
+
+static void run_lines(void *arg, uint64_t iters){
+    struct scan_arg *a = arg;
+    BuffLines it;
+    BuffView line;
+    for(uint64_t i = 0; i < iters; i ++){
+        size_t count = 0;
+        buff_lines_init(&it, a->buff);
+        while(buff_lines_next(&it, &line)){
+            count ++;
+        }
+        bench_clobber(count);
+    }
+}
+
+/* a log-like text of 60 to 120 byte lines */
+static void fill_log(Buffer *buff){
+    static const char words[] = "INFO request served in 12ms from cache user=alice path=/api/v1/items ";
+    uint64_t x = 7;
+    while(buff_size(buff) < HAYSTACK){
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t len = 60 + (x >> 33) % 60;
+        for(size_t i = 0; i < len && buff_size(buff) < HAYSTACK - 1; i ++){
+            buff_append_byte(buff, words[(i + (x >> 40)) % (sizeof(words) - 1)]);
+        }
+        buff_append_byte(buff, '\n');
+    }
+}
+
+/**
+ * Benchmarks byte, set and substring search and line iteration over 1 MiB,
+ * against a naive loop. Searches run the full length without a match.
+ *
+ * @returns None
+ */
+void bench_scan(void){
+    struct scan_arg arg;
+    arg.buff = buff_init(HAYSTACK);
+    bench_fill(buff_body(arg.buff), HAYSTACK, 4);
+    for(size_t i = 0; i < HAYSTACK; i ++){
+        byte *p = (byte *) buff_body(arg.buff) + i;
+        *p = 'a' + *p % 26;
+    }
+    arg.buff->size = HAYSTACK;
+    scan_set_init(&arg.set, "\n\r\t;", 4);
+    print(STDERR_FILENO, "scan implementation: %s\n", scan_impl());
+
+    bench_run("scan_naive_loop", HAYSTACK, run_naive, &arg, HAYSTACK);
+    bench_run("buff_find_byte", HAYSTACK, run_find_byte, &arg, HAYSTACK);
+    bench_run("buff_find_any", HAYSTACK, run_find_any, &arg, HAYSTACK);
+    bench_run("buff_find_sub", HAYSTACK, run_find_sub, &arg, HAYSTACK);
+
+    arg.buff->size = 0;
+    fill_log(arg.buff);
+    bench_run("buff_lines", HAYSTACK, run_lines, &arg, buff_size(arg.buff));
+    buff_free(arg.buff);
+}
@@ -0,0 +1,89 @@
+#include "bench.h"
+#include "../libs/buffer.h"
+#include "../libs/secheap.h"
+
+#include <sys/mman.h>
+
+#define KEY 32
+#define HEAP (1 << 20)
+
+/* the per allocation approach: a locked page between two guard pages */
+static void run_mlock_each(void *arg, uint64_t iters){
+    size_t page = sysconf(_SC_PAGESIZE);
+    for(uint64_t i = 0; i < iters; i ++){
+        byte *map = mmap(NULL, 3 * page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(map == MAP_FAILED){
+            print_err_exit("mmap", errno);
+        }
+        mprotect(map + page, page, PROT_READ | PROT_WRITE);
+        mlock(map + page, page);
+        madvise(map, 3 * page, MADV_DONTDUMP);
+        memcpy(map + page, arg, KEY);
+        bench_clobber(map);
+        explicit_bzero(map + page, KEY);
+        munlock(map + page, page);
+        munmap(map, 3 * page);
+    }
+}
+
+static void run_secheap(void *arg, uint64_t iters){
+    for(uint64_t i = 0; i < iters; i ++){
+        void *key = secheap_alloc(KEY);
+        memcpy(key, arg, KEY);
+        bench_clobber(key);
+        sec_free(key);
+    }
+}
+
+static void run_sec_malloc(void *arg, uint64_t iters){
+    for(uint64_t i = 0; i < iters; i ++){
+        void *key = sec_malloc(KEY);
+        memcpy(key, arg, KEY);
+        bench_clobber(key);
+        sec_free(key);
+    }
+}
+
+/* fills the whole heap with 16 byte blocks, frees them, then takes it back as one block */
+static void run_churn(void *arg, uint64_t iters){
+    void **blocks = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        for(size_t j = 0; j < HEAP / SECHEAP_MIN; j ++){
+            blocks[j] = secheap_alloc(SECHEAP_MIN);
+        }
+        for(size_t j = 0; j < HEAP / SECHEAP_MIN; j ++){
+            sec_free(blocks[j]);
+        }
+        void *all = secheap_alloc(HEAP);
+        if(all == NULL){
+            print(STDERR_FILENO, "Error: secure heap fragmented after %zu bytes freed\n", (size_t) HEAP);
+            exit(EXIT_FAILURE);
+        }
+        sec_free(all);
+    }
+}
+
+/**
+ * Benchmarks allocating, filling and freeing a 32 byte key: from the
+ * secure heap, with a locked and guarded mapping per key, and from plain
+ * sec_malloc memory for reference. Also times filling the heap with the
+ * smallest blocks and freeing them, after which it must merge them back
+ * into one block the size of the heap.
+ *
+ * @returns None
+ */
+void bench_secheap(void){
+    byte key[KEY];
+    bench_fill(key, KEY, 21);
+    if(secheap_init(HEAP) == -1){
+        print(STDERR_FILENO, "secheap_init: %s, skipped\n", strerror(errno));
+        return;
+    }
+    bench_run("secheap_alloc", KEY, run_secheap, key, 0);
+    bench_run("mlock_each", KEY, run_mlock_each, key, 0);
+    bench_run("sec_malloc", KEY, run_sec_malloc, key, 0);
+    void **blocks = sec_malloc(HEAP / SECHEAP_MIN * sizeof(void *));
+    bench_run("secheap_churn", HEAP / SECHEAP_MIN, run_churn, blocks, 0);
+    sec_free(blocks);
+    secheap_done();
+}
@@ -0,0 +1,110 @@
+#include "bench.h"
+#include "../libs/slab.h"
+
+#include <malloc.h>
+
+#define OBJECTS 4096
+
+struct slab_arg {
+    SlabCache *cache;
+    size_t size;
+    void *objects[OBJECTS];
+    unsigned order[OBJECTS];
+};
+
+/* allocates a batch of objects, then frees them in shuffled order */
+static void run_malloc(void *arg, uint64_t iters){
+    struct slab_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        for(int j = 0; j < OBJECTS; j ++){
+            a->objects[j] = sec_malloc(a->size);
+            *(int *) a->objects[j] = j;
+        }
+        bench_clobber(a->objects);
+        for(int j = 0; j < OBJECTS; j ++){
+            sec_free(a->objects[a->order[j]]);
+        }
+    }
+}
+
+static void run_slab(void *arg, uint64_t iters){
+    struct slab_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        for(int j = 0; j < OBJECTS; j ++){
+            a->objects[j] = slab_alloc(a->cache);
+            *(int *) a->objects[j] = j;
+        }
+        bench_clobber(a->objects);
+        for(int j = 0; j < OBJECTS; j ++){
+            slab_free(a->cache, a->objects[a->order[j]]);
+        }
+    }
+}
+
+/* the libc heap bytes held for OBJECTS allocations of size */
+static size_t malloc_footprint(size_t size, void **objects){
+    struct mallinfo2 before = mallinfo2();
+    for(int j = 0; j < OBJECTS; j ++){
+        objects[j] = malloc(size);
+    }
+    struct mallinfo2 after = mallinfo2();
+    for(int j = 0; j < OBJECTS; j ++){
+        free(objects[j]);
+    }
+    return after.uordblks - before.uordblks;
+}
+
+/**
+ * Benchmarks allocating and freeing 4096 small objects, the free order
+ * shuffled, through sec_malloc against a slab cache, unlocked, locked and
+ * wiping on free. The memory held for the objects by each is reported.
+ *
+ * @returns None
+ */
+void bench_slab(void){
+    static const size_t sizes[] = { 24, 64 };
+    static const struct {
+        const char *name;
+        int flags;
+    } variants[] = {
+        { "slab_alloc", 0 },
+        { "slab_alloc_locked", SLAB_LOCKED },
+        { "slab_alloc_zero", SLAB_ZERO_ON_FREE },
+    };
+    struct slab_arg *arg = sec_malloc(sizeof(struct slab_arg));
+    uint64_t seed = 7;
+    for(int j = 0; j < OBJECTS; j ++){
+        arg->order[j] = j;
+    }
+    for(int j = OBJECTS - 1; j > 0; j --){
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        int k = (seed >> 33) % (j + 1);
+        unsigned t = arg->order[j];
+        arg->order[j] = arg->order[k];
+        arg->order[k] = t;
+    }
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s ++){
+        arg->size = sizes[s];
+        bench_run("sec_malloc", sizes[s], run_malloc, arg, 0);
+        for(size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v ++){
+            if(!bench_selected(variants[v].name)){
+                continue;
+            }
+            arg->cache = slab_create(sizes[s], variants[v].flags);
+            bench_run(variants[v].name, sizes[s], run_slab, arg, 0);
+            slab_destroy(arg->cache);
+        }
+
+        SlabCache *cache = slab_create(sizes[s], 0);
+        for(int j = 0; j < OBJECTS; j ++){
+            arg->objects[j] = slab_alloc(cache);
+        }
+        SlabStats stats;
+        slab_stats(cache, &stats);
+        print(STDERR_FILENO, "%d objects of %zu bytes: malloc holds %zu KiB, slabs %zu KiB\n", OBJECTS,
+              sizes[s], malloc_footprint(sizes[s], arg->objects) / 1024, stats.slab_bytes / 1024);
+        slab_destroy(cache);
+    }
+    sec_free(arg);
+}
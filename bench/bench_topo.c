@@ -0,0 +1,68 @@
+#include "bench.h"
+#include "../libs/topo.h"
+
+#define DATASET ((size_t) 512 << 20)
+
+struct topo_arg {
+    uint64_t *words;
+    size_t block;
+};
+
+/* two passes over a range: a transform in place, then a reduction */
+static uint64_t two_pass(uint64_t *words, size_t count){
+    for(size_t i = 0; i < count; i ++){
+        words[i] = words[i] * 3 + 1;
+    }
+    uint64_t sum = 0;
+    for(size_t i = 0; i < count; i ++){
+        sum ^= words[i] >> 7;
+    }
+    return sum;
+}
+
+static void run_blocked(void *arg, uint64_t iters){
+    struct topo_arg *a = arg;
+    size_t total = DATASET / 8, block = a->block / 8;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t sum = 0;
+        for(size_t start = 0; start < total; start += block){
+            sum += two_pass(a->words + start, total - start < block ? total - start : block);
+        }
+        bench_clobber(sum);
+    }
+}
+
+/**
+ * Benchmarks two passes over 512 MiB, more than most L3 caches, done in
+ * blocks sized from the topology, half of L2, against whole-dataset
+ * passes, with the thread pinned to the first CPU of a spread placement.
+ * The topology found is reported.
+ *
+ * @returns None
+ */
+void bench_topo(void){
+    Topology *topo = topo_load();
+    print(STDERR_FILENO, "%d cpus, %d allowed, %d cores, %d packages, %d nodes\n", topo->ncpus,
+          topo->nallowed, topo->ncores, topo->npackages, topo->nnodes);
+    for(int level = 1; level < TOPO_LEVELS; level ++){
+        print(STDERR_FILENO, "L%d %zu KiB, shared by %d\n", level, topo_cache_size(topo, level) / 1024,
+              topo->caches[level].sharing);
+    }
+    int cpu;
+    topo_place(topo, TOPO_SPREAD, 1, &cpu);
+    if(topo_pin(cpu) == -1){
+        print_err_exit("sched_setaffinity", errno);
+    }
+
+    struct topo_arg arg;
+    arg.words = sec_malloc(DATASET);
+    bench_fill(arg.words, DATASET, 31);
+    size_t l2 = topo_cache_size(topo, 2);
+    arg.block = l2 >= 8192 ? l2 / 2 : 128 << 10;
+    bench_run("two_pass_l2_blocks", arg.block, run_blocked, &arg, DATASET);
+    arg.block = DATASET;
+    bench_run("two_pass_full", DATASET, run_blocked, &arg, DATASET);
+
+    sec_free(arg.words);
+    topo_free(topo);
+}
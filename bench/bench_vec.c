@@ -0,0 +1,128 @@
+#include "bench.h"
+#include "../libs/vec.h"
+
+VEC_DEFINE(U64Vec, uint64_t)
+
+#define COUNT ((size_t) 1000000)
+
+struct vec_arg {
+    uint64_t *values;
+    uint64_t *scratch;
+    U64Vec sorted;
+};
+
+static int cmp_u64(const uint64_t *a, const uint64_t *b){
+    return (*a > *b) - (*a < *b);
+}
+
+static int cmp_u64_void(const void *a, const void *b){
+    return cmp_u64(a, b);
+}
+
+static void run_vec_push(void *arg, uint64_t iters){
+    struct vec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        U64Vec v;
+        U64Vec_init(&v, 0);
+        for(size_t j = 0; j < COUNT; j ++){
+            U64Vec_push(&v, a->values[j]);
+        }
+        bench_clobber(v.data);
+        U64Vec_free(&v);
+    }
+}
+
+/* what the vector replaces: a pointer, a count and a capacity kept by hand */
+static void run_array_push(void *arg, uint64_t iters){
+    struct vec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uint64_t *data = NULL;
+        size_t size = 0, capacity = 0;
+        for(size_t j = 0; j < COUNT; j ++){
+            if(size == capacity){
+                size_t grown = capacity ? capacity * 2 : 8;
+                data = data ? sec_realloc(data, size * sizeof(uint64_t), grown * sizeof(uint64_t))
+                            : sec_malloc(grown * sizeof(uint64_t));
+                capacity = grown;
+            }
+            data[size ++] = a->values[j];
+        }
+        bench_clobber(data);
+        sec_free(data);
+    }
+}
+
+static void run_vec_sort(void *arg, uint64_t iters){
+    struct vec_arg *a = arg;
+    U64Vec v = { a->scratch, COUNT, COUNT };
+    for(uint64_t i = 0; i < iters; i ++){
+        memcpy(a->scratch, a->values, COUNT * sizeof(uint64_t));
+        U64Vec_sort(&v, cmp_u64);
+        bench_clobber(a->scratch);
+    }
+}
+
+static void run_qsort(void *arg, uint64_t iters){
+    struct vec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        memcpy(a->scratch, a->values, COUNT * sizeof(uint64_t));
+        qsort(a->scratch, COUNT, sizeof(uint64_t), cmp_u64_void);
+        bench_clobber(a->scratch);
+    }
+}
+
+static void run_vec_search(void *arg, uint64_t iters){
+    struct vec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        ssize_t found = 0;
+        for(size_t j = 0; j < COUNT; j ++){
+            found += U64Vec_search(&a->sorted, &a->values[j], cmp_u64);
+        }
+        bench_clobber(found);
+    }
+}
+
+static void run_bsearch(void *arg, uint64_t iters){
+    struct vec_arg *a = arg;
+    for(uint64_t i = 0; i < iters; i ++){
+        uintptr_t found = 0;
+        for(size_t j = 0; j < COUNT; j ++){
+            found += (uintptr_t) bsearch(&a->values[j], a->sorted.data, COUNT, sizeof(uint64_t), cmp_u64_void);
+        }
+        bench_clobber(found);
+    }
+}
+
+static void report(const char *name, BenchResult res){
+    if(res.iters > 0){
+        print(STDERR_FILENO, "%-16s %10zu  %8.2f ns/element\n", name, COUNT, res.median_ns / COUNT);
+    }
+}
+
+/**
+ * Benchmarks the typed vector against the code it replaces: pushing 1M
+ * 64-bit values against a hand grown array, sorting them against qsort,
+ * and searching them against bsearch.
+ *
+ * @returns None
+ */
+void bench_vec(void){
+    struct vec_arg arg;
+    arg.values = sec_malloc(COUNT * sizeof(uint64_t));
+    arg.scratch = sec_malloc(COUNT * sizeof(uint64_t));
+    bench_fill(arg.values, COUNT * sizeof(uint64_t), 11);
+    U64Vec_init(&arg.sorted, COUNT);
+    U64Vec_insert(&arg.sorted, 0, arg.values, COUNT);
+    U64Vec_sort(&arg.sorted, cmp_u64);
+
+    report("vec_push", bench_run("vec_push", COUNT, run_vec_push, &arg, COUNT * sizeof(uint64_t)));
+    report("array_push", bench_run("array_push", COUNT, run_array_push, &arg, COUNT * sizeof(uint64_t)));
+    report("vec_sort", bench_run("vec_sort", COUNT, run_vec_sort, &arg, 0));
+    report("qsort", bench_run("qsort", COUNT, run_qsort, &arg, 0));
+    report("vec_search", bench_run("vec_search", COUNT, run_vec_search, &arg, 0));
+    report("bsearch", bench_run("bsearch", COUNT, run_bsearch, &arg, 0));
+
+    U64Vec_free(&arg.sorted);
+    sec_free(arg.scratch);
+    sec_free(arg.values);
+}
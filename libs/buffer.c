@@ -84,6 +84,202 @@ void buff_append_byte(Buffer *buff, byte add){
     buff->size += 1;
 }
 
+/**
+ * Appends printf style formatted text to a buffer, formatting straight into
+ * its spare capacity. Only when the text does not fit is the buffer grown
+ * and the text formatted a second time. No terminating NUL is counted in
+ * the size, although one is written after the contents.
+ *
+ * @param buff The buffer to append to.
+ * @param format The format string.
+ * @param args The arguments of the format string.
+ *
+ * @returns None
+ */
+void buff_vappendf(Buffer *buff, const char *format, va_list args){
+    va_list cpy;
+    va_copy(cpy, args);
+    size_t spare = buff->capacity - buff->size;
+    int len = vsnprintf((char *) buff->body + buff->size, spare, format, cpy);
+    va_end(cpy);
+    if(len < 0){
+        print(STDERR_FILENO, "Error: buffer format failed\n");
+        exit(EXIT_FAILURE);
+    }
+    if((size_t) len >= spare){
+        buff_reserve(buff, (size_t) len + 1);
+        vsnprintf((char *) buff->body + buff->size, (size_t) len + 1, format, args);
+    }
+    buff->size += len;
+}
+
+/**
+ * Appends printf style formatted text to a buffer, see buff_vappendf.
+ *
+ * @param buff The buffer to append to.
+ * @param format The format string.
+ * @param ... The arguments of the format string.
+ *
+ * @returns None
+ */
+void buff_appendf(Buffer *buff, const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    buff_vappendf(buff, format, args);
+    va_end(args);
+}
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* writes the decimal digits of x ending just before end, returns the first digit */
+static char *format_u64(char *end, uint64_t x){
+    while(x >= 100){
+        end -= 2;
+        memcpy(end, digit_pairs + (x % 100) * 2, 2);
+        x /= 100;
+    }
+    if(x >= 10){
+        end -= 2;
+        memcpy(end, digit_pairs + x * 2, 2);
+    }else{
+        *-- end = '0' + x;
+    }
+    return end;
+}
+
+/**
+ * Appends an unsigned integer in decimal, as "%" PRIu64 would.
+ *
+ * @param buff The buffer to append to.
+ * @param value The integer.
+ *
+ * @returns None
+ */
+void buff_append_u64(Buffer *buff, uint64_t value){
+    char text[20];
+    char *start = format_u64(text + sizeof(text), value);
+    buff_reserve(buff, 20);
+    memcpy((char *) buff->body + buff->size, start, text + sizeof(text) - start);
+    buff->size += text + sizeof(text) - start;
+}
+
+/**
+ * Appends a signed integer in decimal, as "%" PRId64 would.
+ *
+ * @param buff The buffer to append to.
+ * @param value The integer.
+ *
+ * @returns None
+ */
+void buff_append_i64(Buffer *buff, int64_t value){
+    char text[20];
+    /* negate as unsigned so INT64_MIN works */
+    uint64_t x = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+    char *start = format_u64(text + sizeof(text), x);
+    buff_reserve(buff, 21);
+    if(value < 0){
+        ((char *) buff->body)[buff->size ++] = '-';
+    }
+    memcpy((char *) buff->body + buff->size, start, text + sizeof(text) - start);
+    buff->size += text + sizeof(text) - start;
+}
+
+/**
+ * Appends an unsigned integer in lowercase hexadecimal without a prefix,
+ * zero padded to a minimum width, as "%0*" PRIx64 would.
+ *
+ * @param buff The buffer to append to.
+ * @param value The integer.
+ * @param width The minimum number of digits, at most 16.
+ *
+ * @returns None
+ */
+void buff_append_hex(Buffer *buff, uint64_t value, int width){
+    static const char hex[16] = "0123456789abcdef";
+    int digits = value ? (67 - __builtin_clzll(value)) / 4 : 1;
+    if(width > 16){
+        width = 16;
+    }
+    if(digits < width){
+        digits = width;
+    }
+    buff_reserve(buff, digits);
+    char *out = (char *) buff->body + buff->size;
+    for(int i = digits - 1; i >= 0; i --){
+        out[i] = hex[value & 15];
+        value >>= 4;
+    }
+    buff->size += digits;
+}
+
+/**
+ * Appends a number with a fixed number of decimals, exactly as "%.*f"
+ * would. The number is scaled and rounded to an integer and printed as
+ * such, which is several times faster than printf. Numbers of 15 digits
+ * or more, infinities and NaN go through buff_appendf.
+ *
+ * @param buff The buffer to append to.
+ * @param value The number.
+ * @param decimals The number of decimals, 0 to 9.
+ *
+ * @returns None
+ */
+void buff_append_fixed(Buffer *buff, double value, int decimals){
+    static const double scales[10] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    static const uint64_t powers[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000,
+                                         10000000, 100000000, 1000000000 };
+    if(decimals < 0 || decimals > 9){
+        print(STDERR_FILENO, "Error: fixed point appends take 0 to 9 decimals\n");
+        exit(EXIT_FAILURE);
+    }
+    int negative = __builtin_signbit(value) != 0;
+    double a = negative ? -value : value;
+    double b = scales[decimals];
+    double p = a * b;
+    /* also false for NaN */
+    if(!(p < 1e15)){
+        buff_appendf(buff, "%.*f", decimals, value);
+        return;
+    }
+    /*
+     * Rounds the exact product as printf does, to nearest and ties to even.
+     * The rounding error of p is recovered exactly by splitting both
+     * factors into 26 bit halves (Dekker's product), so that p + err is
+     * a * b without relying on an fma instruction.
+     */
+    double ta = a * 134217729.0, tb = b * 134217729.0;
+    double ah = ta - (ta - a), al = a - ah;
+    double bh = tb - (tb - b), bl = b - bh;
+    double err = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+    uint64_t x = (uint64_t) p;
+    double frac = p - (double) x;
+    /* |err| is at most half a unit of p, so it only matters on a tie */
+    if(frac > 0.5 || (frac == 0.5 && (err > 0 || (err == 0 && (x & 1))))){
+        x ++;
+    }
+    char text[32];
+    char *end = text + sizeof(text);
+    char *start = end;
+    if(decimals > 0){
+        start = format_u64(end, x % powers[decimals]);
+        while(start > end - decimals){
+            *-- start = '0';
+        }
+        *-- start = '.';
+    }
+    start = format_u64(start, x / powers[decimals]);
+    /* printf keeps the sign of values that round to zero */
+    if(negative){
+        *-- start = '-';
+    }
+    buff_reserve(buff, end - start);
+    memcpy((char *) buff->body + buff->size, start, end - start);
+    buff->size += end - start;
+}
+
 /**
  * Calculates the size of the buffer required for a given operation.
  *
@@ -138,6 +334,23 @@ void buff_resize(Buffer *buff, size_t new_size){
     buff->capacity = new_size;
 }
 
+/**
+ * Makes room for at least extra more bytes past the current size, growing
+ * the capacity geometrically so repeated reserves stay amortized O(1).
+ *
+ * @param buff The buffer.
+ * @param extra The number of bytes about to be written after the contents.
+ *
+ * @returns None
+ */
+void buff_reserve(Buffer *buff, size_t extra){
+    size_t need = buff->size + extra;
+    if(need > buff->capacity){
+        size_t grow = buff->capacity * 2;
+        buff_resize(buff, grow > need ? grow : need);
+    }
+}
+
 /**
  * Frees the memory allocated for a buffer.
  *
@@ -146,8 +359,8 @@ void buff_resize(Buffer *buff, size_t new_size){
  * @returns None
  */
 void buff_free(Buffer *buff){
-    free(buff->body);
-    free(buff);
+    sec_free(buff->body);
+    sec_free(buff);
 }
 
 /* specify the endianess OF THE SYSTEM */
@@ -2,6 +2,7 @@
 #define BUFFER_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include "syscalls.h"
 
 typedef unsigned char byte;
@@ -20,17 +21,37 @@ struct buff {
 };
 typedef struct buff Buffer;
 
+/**
+ * A read-only window into memory owned by someone else, usually a Buffer.
+ * Views stay valid until the underlying buffer is modified or freed.
+ *
+ * @param ptr The first byte.
+ * @param len The number of bytes.
+ */
+struct buff_view {
+    const byte *ptr;
+    size_t len;
+};
+typedef struct buff_view BuffView;
+
 
 /* function prototypes */
 void *buff_init(int size); 
 void buff_insert(Buffer *buff, void *add, size_t size, size_t index);
 void buff_append(Buffer *buff, void *add, size_t size);
 void buff_append_byte(Buffer *buff, byte add);
+void buff_vappendf(Buffer *buff, const char *format, va_list args) __attribute__((format(printf, 2, 0)));
+void buff_appendf(Buffer *buff, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void buff_append_u64(Buffer *buff, uint64_t value);
+void buff_append_i64(Buffer *buff, int64_t value);
+void buff_append_hex(Buffer *buff, uint64_t value, int width);
+void buff_append_fixed(Buffer *buff, double value, int decimals);
 size_t buff_size(Buffer *buff);
 size_t buff_capacity(Buffer *buff);
 void *buff_body(Buffer *buff);
 void buff_clear(Buffer *buff);
 void buff_resize(Buffer *buff, size_t new_size);
+void buff_reserve(Buffer *buff, size_t extra);
 void buff_free(Buffer *buff);
 void buff_dump(Buffer *buff, int numbytes, int endianess);
 
@@ -0,0 +1,499 @@
+#include "checksum.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* reflected polynomials */
+#define POLY_CRC32C 0x82f63b78
+#define POLY_CRC32 0xedb88320
+
+typedef uint32_t (*crc_fn)(uint32_t crc, const byte *p, size_t n);
+
+static uint32_t crc32c_sw(uint32_t crc, const byte *p, size_t n);
+static uint32_t crc32_sw(uint32_t crc, const byte *p, size_t n);
+
+/* resolved once at load time from the CPU features, see select_impl */
+static crc_fn crc32c_impl = crc32c_sw;
+static crc_fn crc32_impl = crc32_sw;
+static const char *impl_name = "scalar";
+
+/* slicing-by-8 tables, table[k][b] is the CRC of b followed by k zero bytes */
+static uint32_t crc32c_table[8][256];
+static uint32_t crc32_table[8][256];
+
+static void table_init(uint32_t table[8][256], uint32_t poly){
+    for(uint32_t n = 0; n < 256; n ++){
+        uint32_t crc = n;
+        for(int k = 0; k < 8; k ++){
+            crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+        }
+        table[0][n] = crc;
+    }
+    for(uint32_t n = 0; n < 256; n ++){
+        for(int k = 1; k < 8; k ++){
+            table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xff];
+        }
+    }
+}
+
+/* crc is the inverted register, as kept by all the loops below */
+static uint32_t slice8(uint32_t table[8][256], uint32_t crc, const byte *p, size_t n){
+    while(n >= 8){
+        uint64_t w;
+        memcpy(&w, p, 8);
+        w = le64toh(w) ^ crc;
+        crc = table[7][w & 0xff] ^ table[6][(w >> 8) & 0xff] ^
+              table[5][(w >> 16) & 0xff] ^ table[4][(w >> 24) & 0xff] ^
+              table[3][(w >> 32) & 0xff] ^ table[2][(w >> 40) & 0xff] ^
+              table[1][(w >> 48) & 0xff] ^ table[0][w >> 56];
+        p += 8;
+        n -= 8;
+    }
+    for(; n > 0; n --){
+        crc = (crc >> 8) ^ table[0][(crc ^ *p ++) & 0xff];
+    }
+    return crc;
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const byte *p, size_t n){
+    return slice8(crc32c_table, crc, p, n);
+}
+
+static uint32_t crc32_sw(uint32_t crc, const byte *p, size_t n){
+    return slice8(crc32_table, crc, p, n);
+}
+
+#ifdef HAVE_X86_SIMD
+/*
+ * CRC32C with the SSE4.2 crc32 instruction. It has a latency of three
+ * cycles and a throughput of one, so long inputs are cut into three
+ * interleaved streams whose CRCs are recombined by shifting the earlier
+ * ones over the length of the later ones (a linear map, precomputed as
+ * byte-wise tables for the two block sizes used).
+ */
+#define CRC_LONG 8192
+#define CRC_SHORT 256
+
+static uint32_t crc32c_long[4][256];
+static uint32_t crc32c_short[4][256];
+
+static uint32_t gf2_times(const uint32_t *mat, uint32_t vec){
+    uint32_t sum = 0;
+    for(; vec; vec >>= 1, mat ++){
+        if(vec & 1){
+            sum ^= *mat;
+        }
+    }
+    return sum;
+}
+
+static void gf2_square(uint32_t *square, const uint32_t *mat){
+    for(int n = 0; n < 32; n ++){
+        square[n] = gf2_times(mat, mat[n]);
+    }
+}
+
+/* the operator appending len zero bytes to a CRC, len a power of two */
+static void zeros_op(uint32_t *even, size_t len){
+    uint32_t odd[32];
+    odd[0] = POLY_CRC32C;
+    for(int n = 1; n < 32; n ++){
+        odd[n] = 1u << (n - 1);
+    }
+    gf2_square(even, odd);
+    gf2_square(odd, even);
+    for(;;){
+        gf2_square(even, odd);
+        len >>= 1;
+        if(len == 0){
+            return;
+        }
+        gf2_square(odd, even);
+        len >>= 1;
+        if(len == 0){
+            memcpy(even, odd, sizeof(odd));
+            return;
+        }
+    }
+}
+
+static void zeros_table(uint32_t table[4][256], size_t len){
+    uint32_t op[32];
+    zeros_op(op, len);
+    for(uint32_t n = 0; n < 256; n ++){
+        for(int k = 0; k < 4; k ++){
+            table[k][n] = gf2_times(op, n << (8 * k));
+        }
+    }
+}
+
+static inline uint32_t crc_shift(uint32_t table[4][256], uint32_t crc){
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+           table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const byte *p, size_t n){
+    uint64_t crc0 = crc;
+    while(n > 0 && ((uintptr_t) p & 7)){
+        crc0 = _mm_crc32_u8(crc0, *p ++);
+        n --;
+    }
+    static const size_t blocks[2] = { CRC_LONG, CRC_SHORT };
+    for(int b = 0; b < 2; b ++){
+        size_t block = blocks[b];
+        while(n >= 3 * block){
+            uint64_t crc1 = 0, crc2 = 0;
+            const byte *end = p + block;
+            do{
+                crc0 = _mm_crc32_u64(crc0, *(const uint64_t *) p);
+                crc1 = _mm_crc32_u64(crc1, *(const uint64_t *) (p + block));
+                crc2 = _mm_crc32_u64(crc2, *(const uint64_t *) (p + 2 * block));
+                p += 8;
+            }while(p < end);
+            uint32_t (*table)[256] = b == 0 ? crc32c_long : crc32c_short;
+            crc0 = crc_shift(table, crc0) ^ crc1;
+            crc0 = crc_shift(table, crc0) ^ crc2;
+            p += 2 * block;
+            n -= 3 * block;
+        }
+    }
+    for(; n >= 8; n -= 8, p += 8){
+        crc0 = _mm_crc32_u64(crc0, *(const uint64_t *) p);
+    }
+    for(; n > 0; n --){
+        crc0 = _mm_crc32_u8(crc0, *p ++);
+    }
+    return crc0;
+}
+
+/*
+ * CRC32 by folding with carry-less multiplication, after Gopal et al.,
+ * "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ": four
+ * 128-bit lanes are folded forward 64 bytes at a time, then into one lane,
+ * then reduced to 32 bits with a Barrett reduction. Takes n >= 64 and a
+ * multiple of 16.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_fold(uint32_t crc, const byte *p, size_t n){
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+    __m128i x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+    __m128i x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+    __m128i x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    p += 64;
+    n -= 64;
+
+    while(n >= 64){
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (p + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (p + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (p + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (p + 0x30)));
+        p += 64;
+        n -= 64;
+    }
+
+    /* four lanes into one, then any remaining 16 byte blocks */
+    __m128i lanes[3] = { x2, x3, x4 };
+    for(int i = 0; i < 3; i ++){
+        __m128i lo = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, lanes[i]), lo);
+    }
+    for(; n >= 16; n -= 16, p += 16){
+        __m128i lo = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *) p)), lo);
+    }
+
+    /* 128 to 64 bits */
+    __m128i x = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x);
+    x = _mm_srli_si128(x1, 4);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x);
+
+    /* Barrett reduction to 32 bits */
+    x = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+    x = _mm_clmulepi64_si128(_mm_and_si128(x, mask), poly, 0x00);
+    x1 = _mm_xor_si128(x1, x);
+    return _mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const byte *p, size_t n){
+    if(n >= 64){
+        size_t chunk = n & ~(size_t) 15;
+        crc = crc32_fold(crc, p, chunk);
+        p += chunk;
+        n -= chunk;
+    }
+    return crc32_sw(crc, p, n);
+}
+#endif
+
+__attribute__((constructor))
+static void select_impl(void){
+    table_init(crc32c_table, POLY_CRC32C);
+    table_init(crc32_table, POLY_CRC32);
+#ifdef HAVE_X86_SIMD
+    const char *cap = getenv("CKSUM_IMPL");
+    if(cap != NULL && strcmp(cap, "scalar") == 0){
+        return;
+    }
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2")){
+        zeros_table(crc32c_long, CRC_LONG);
+        zeros_table(crc32c_short, CRC_SHORT);
+        crc32c_impl = crc32c_sse42;
+        impl_name = "sse4.2";
+        if(__builtin_cpu_supports("pclmul")){
+            crc32_impl = crc32_pclmul;
+            impl_name = "sse4.2+pclmul";
+        }
+    }
+#endif
+}
+
+/**
+ * Returns the name of the CRC implementation in use: "sse4.2+pclmul",
+ * "sse4.2" or "scalar". Setting CKSUM_IMPL=scalar forces the tables.
+ *
+ * @returns The name.
+ */
+const char *cksum_impl(void){
+    return impl_name;
+}
+
+/**
+ * Computes or continues a CRC-32C (Castagnoli, as used by iSCSI and ext4).
+ *
+ * @param crc 0 to start, or the result over the preceding data.
+ * @param data The data.
+ * @param size The number of bytes in data.
+ *
+ * @returns The CRC.
+ */
+uint32_t cksum_crc32c(uint32_t crc, const void *data, size_t size){
+    return ~crc32c_impl(~crc, data, size);
+}
+
+/**
+ * Computes or continues a CRC-32 (IEEE 802.3, as used by zlib and PNG).
+ *
+ * @param crc 0 to start, or the result over the preceding data.
+ * @param data The data.
+ * @param size The number of bytes in data.
+ *
+ * @returns The CRC.
+ */
+uint32_t cksum_crc32(uint32_t crc, const void *data, size_t size){
+    return ~crc32_impl(~crc, data, size);
+}
+
+/*
+ * The 64-bit hash is XXH64: four independent multiply-rotate lanes over 32
+ * byte stripes, merged and avalanched at the end. Not cryptographic.
+ */
+#define P1 0x9e3779b185ebca87ULL
+#define P2 0xc2b2ae3d27d4eb4fULL
+#define P3 0x165667b19e3779f9ULL
+#define P4 0x85ebca77c2b2ae63ULL
+#define P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r){
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const byte *p){
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return le64toh(w);
+}
+
+static inline uint32_t read32(const byte *p){
+    uint32_t w;
+    memcpy(&w, p, 4);
+    return le32toh(w);
+}
+
+static inline uint64_t lane_round(uint64_t acc, uint64_t input){
+    return rotl64(acc + input * P2, 31) * P1;
+}
+
+static inline uint64_t lane_merge(uint64_t h, uint64_t acc){
+    return (h ^ lane_round(0, acc)) * P1 + P4;
+}
+
+/* consumes whole stripes, returns the number of bytes used */
+static size_t stripes(uint64_t acc[4], const byte *p, size_t n){
+    const byte *start = p;
+    uint64_t a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+    for(; n >= 32; n -= 32, p += 32){
+        a0 = lane_round(a0, read64(p));
+        a1 = lane_round(a1, read64(p + 8));
+        a2 = lane_round(a2, read64(p + 16));
+        a3 = lane_round(a3, read64(p + 24));
+    }
+    acc[0] = a0;
+    acc[1] = a1;
+    acc[2] = a2;
+    acc[3] = a3;
+    return p - start;
+}
+
+static uint64_t finish(const uint64_t acc[4], uint64_t seed, uint64_t total, const byte *p, size_t n){
+    uint64_t h;
+    if(total >= 32){
+        h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+        for(int i = 0; i < 4; i ++){
+            h = lane_merge(h, acc[i]);
+        }
+    }else{
+        h = seed + P5;
+    }
+    h += total;
+    for(; n >= 8; n -= 8, p += 8){
+        h = rotl64(h ^ lane_round(0, read64(p)), 27) * P1 + P4;
+    }
+    if(n >= 4){
+        h = rotl64(h ^ (read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+        n -= 4;
+    }
+    for(; n > 0; n --){
+        h = rotl64(h ^ (*p ++ * P5), 11) * P1;
+    }
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+/**
+ * Starts an incremental 64-bit hash.
+ *
+ * @param state The state to initialize.
+ * @param seed The seed, different seeds give unrelated hashes.
+ *
+ * @returns None
+ */
+void cksum_hash64_init(HashState *state, uint64_t seed){
+    state->acc[0] = seed + P1 + P2;
+    state->acc[1] = seed + P2;
+    state->acc[2] = seed;
+    state->acc[3] = seed - P1;
+    state->tail_len = 0;
+    state->total = 0;
+    state->seed = seed;
+}
+
+/**
+ * Adds data to an incremental hash.
+ *
+ * @param state The state.
+ * @param data The data.
+ * @param size The number of bytes in data.
+ *
+ * @returns None
+ */
+void cksum_hash64_update(HashState *state, const void *data, size_t size){
+    const byte *p = data;
+    state->total += size;
+    if(state->tail_len > 0){
+        size_t take = 32 - state->tail_len < size ? 32 - state->tail_len : size;
+        memcpy(state->tail + state->tail_len, p, take);
+        state->tail_len += take;
+        p += take;
+        size -= take;
+        if(state->tail_len < 32){
+            return;
+        }
+        stripes(state->acc, state->tail, 32);
+        state->tail_len = 0;
+    }
+    size_t used = stripes(state->acc, p, size);
+    memcpy(state->tail, p + used, size - used);
+    state->tail_len = size - used;
+}
+
+/**
+ * Returns the hash of everything added so far, the state can be updated
+ * further afterwards.
+ *
+ * @param state The state.
+ *
+ * @returns The hash.
+ */
+uint64_t cksum_hash64_final(const HashState *state){
+    return finish(state->acc, state->seed, state->total, state->tail, state->tail_len);
+}
+
+/**
+ * Hashes a range in one go, equal to init, update and final.
+ *
+ * @param data The data.
+ * @param size The number of bytes in data.
+ * @param seed The seed.
+ *
+ * @returns The hash.
+ */
+uint64_t cksum_hash64(const void *data, size_t size, uint64_t seed){
+    HashState state;
+    cksum_hash64_init(&state, seed);
+    size_t used = stripes(state.acc, data, size);
+    return finish(state.acc, seed, size, (const byte *) data + used, size - used);
+}
+
+/**
+ * Computes or continues a CRC-32C over the contents of a buffer.
+ *
+ * @param buff The buffer.
+ * @param crc 0 to start, or the result over the preceding data.
+ *
+ * @returns The CRC.
+ */
+uint32_t buff_crc32c(Buffer *buff, uint32_t crc){
+    return cksum_crc32c(crc, buff->body, buff->size);
+}
+
+/**
+ * Computes or continues a CRC-32 over the contents of a buffer.
+ *
+ * @param buff The buffer.
+ * @param crc 0 to start, or the result over the preceding data.
+ *
+ * @returns The CRC.
+ */
+uint32_t buff_crc32(Buffer *buff, uint32_t crc){
+    return cksum_crc32(crc, buff->body, buff->size);
+}
+
+/**
+ * Hashes the contents of a buffer.
+ *
+ * @param buff The buffer.
+ * @param seed The seed.
+ *
+ * @returns The hash.
+ */
+uint64_t buff_hash64(Buffer *buff, uint64_t seed){
+    return cksum_hash64(buff->body, buff->size, seed);
+}
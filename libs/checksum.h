@@ -0,0 +1,38 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/**
+ * The state of an incremental 64-bit hash, see cksum_hash64_init.
+ *
+ * @param acc The four lane accumulators.
+ * @param tail Input not yet forming a full 32 byte stripe.
+ * @param tail_len The number of bytes in tail.
+ * @param total The number of bytes hashed so far.
+ * @param seed The seed the hash was started with.
+ */
+struct cksum_hash {
+    uint64_t acc[4];
+    byte tail[32];
+    size_t tail_len;
+    uint64_t total;
+    uint64_t seed;
+};
+typedef struct cksum_hash HashState;
+
+/* function prototypes */
+uint32_t cksum_crc32c(uint32_t crc, const void *data, size_t size);
+uint32_t cksum_crc32(uint32_t crc, const void *data, size_t size);
+uint64_t cksum_hash64(const void *data, size_t size, uint64_t seed);
+void cksum_hash64_init(HashState *state, uint64_t seed);
+void cksum_hash64_update(HashState *state, const void *data, size_t size);
+uint64_t cksum_hash64_final(const HashState *state);
+const char *cksum_impl(void);
+
+uint32_t buff_crc32c(Buffer *buff, uint32_t crc);
+uint32_t buff_crc32(Buffer *buff, uint32_t crc);
+uint64_t buff_hash64(Buffer *buff, uint64_t seed);
+
+#endif
@@ -0,0 +1,363 @@
+#include "codec.h"
+
+/* byte order is known at compile time, so conversions are a bswap or nothing */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAP_LE 0
+#define SWAP_BE 1
+#else
+#define SWAP_LE 1
+#define SWAP_BE 0
+#endif
+
+static inline byte *tail(Buffer *buff){
+    return (byte *) buff->body + buff->size;
+}
+
+/* copies n bytes at the cursor into dst, or flags the cursor */
+static inline int take(BuffCursor *cur, void *dst, size_t n){
+    if(cur->error || cur->buff->size - cur->pos < n){
+        cur->error = 1;
+        return 0;
+    }
+    memcpy(dst, (byte *) cur->buff->body + cur->pos, n);
+    cur->pos += n;
+    return 1;
+}
+
+/*
+ * Fixed width integers: buff_put_u<bits><le|be> appends a value in the given
+ * byte order, buff_get_u<bits><le|be> reads one at the cursor (0 and the
+ * error flag when out of bounds). The _array variants convert n values at
+ * once, a plain copy when the byte order matches the host and a bswap loop
+ * the compiler vectorizes otherwise; the getters return 0 and flag the
+ * cursor if fewer than n values remain.
+ */
+#define DEFINE_FIXED(bits, end, swap)                                               \
+void buff_put_u##bits##end(Buffer *buff, uint##bits##_t v){                         \
+    v = swap ? __builtin_bswap##bits(v) : v;                                        \
+    buff_reserve(buff, sizeof(v));                                                  \
+    memcpy(tail(buff), &v, sizeof(v));                                              \
+    buff->size += sizeof(v);                                                        \
+}                                                                                   \
+uint##bits##_t buff_get_u##bits##end(BuffCursor *cur){                              \
+    uint##bits##_t v;                                                               \
+    if(!take(cur, &v, sizeof(v))){                                                  \
+        return 0;                                                                   \
+    }                                                                               \
+    return swap ? __builtin_bswap##bits(v) : v;                                     \
+}                                                                                   \
+void buff_put_u##bits##end##_array(Buffer *buff, const uint##bits##_t *src, size_t n){ \
+    size_t width = sizeof(uint##bits##_t);                                          \
+    buff_reserve(buff, n * width);                                                  \
+    byte *dst = tail(buff);                                                         \
+    if(!swap){                                                                      \
+        memcpy(dst, src, n * width);                                                \
+    }else{                                                                          \
+        for(size_t i = 0; i < n; i ++){                                             \
+            uint##bits##_t v = __builtin_bswap##bits(src[i]);                       \
+            memcpy(dst + i * width, &v, width);                                     \
+        }                                                                           \
+    }                                                                               \
+    buff->size += n * width;                                                        \
+}                                                                                   \
+int buff_get_u##bits##end##_array(BuffCursor *cur, uint##bits##_t *dst, size_t n){  \
+    size_t width = sizeof(uint##bits##_t);                                          \
+    if(cur->error || (cur->buff->size - cur->pos) / width < n){                     \
+        cur->error = 1;                                                             \
+        return 0;                                                                   \
+    }                                                                               \
+    const byte *src = (byte *) cur->buff->body + cur->pos;                          \
+    if(!swap){                                                                      \
+        memcpy(dst, src, n * width);                                                \
+    }else{                                                                          \
+        for(size_t i = 0; i < n; i ++){                                             \
+            uint##bits##_t v;                                                       \
+            memcpy(&v, src + i * width, width);                                     \
+            dst[i] = __builtin_bswap##bits(v);                                      \
+        }                                                                           \
+    }                                                                               \
+    cur->pos += n * width;                                                          \
+    return 1;                                                                       \
+}
+
+DEFINE_FIXED(16, le, SWAP_LE)
+DEFINE_FIXED(16, be, SWAP_BE)
+DEFINE_FIXED(32, le, SWAP_LE)
+DEFINE_FIXED(32, be, SWAP_BE)
+DEFINE_FIXED(64, le, SWAP_LE)
+DEFINE_FIXED(64, be, SWAP_BE)
+
+/**
+ * Appends a single byte.
+ *
+ * @param buff The buffer.
+ * @param v The byte.
+ *
+ * @returns None
+ */
+void buff_put_u8(Buffer *buff, uint8_t v){
+    buff_reserve(buff, 1);
+    *tail(buff) = v;
+    buff->size ++;
+}
+
+/**
+ * Appends a 32 bit IEEE 754 float as its bit pattern, little endian.
+ *
+ * @param buff The buffer.
+ * @param v The value.
+ *
+ * @returns None
+ */
+void buff_put_f32le(Buffer *buff, float v){
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    buff_put_u32le(buff, bits);
+}
+
+/**
+ * Appends a 32 bit IEEE 754 float as its bit pattern, big endian.
+ *
+ * @param buff The buffer.
+ * @param v The value.
+ *
+ * @returns None
+ */
+void buff_put_f32be(Buffer *buff, float v){
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    buff_put_u32be(buff, bits);
+}
+
+/**
+ * Appends a 64 bit IEEE 754 float as its bit pattern, little endian.
+ *
+ * @param buff The buffer.
+ * @param v The value.
+ *
+ * @returns None
+ */
+void buff_put_f64le(Buffer *buff, double v){
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    buff_put_u64le(buff, bits);
+}
+
+/**
+ * Appends a 64 bit IEEE 754 float as its bit pattern, big endian.
+ *
+ * @param buff The buffer.
+ * @param v The value.
+ *
+ * @returns None
+ */
+void buff_put_f64be(Buffer *buff, double v){
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    buff_put_u64be(buff, bits);
+}
+
+/**
+ * Reads a 32 bit IEEE 754 float stored as its bit pattern, little endian.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The value, 0 when out of bounds.
+ */
+float buff_get_f32le(BuffCursor *cur){
+    uint32_t bits = buff_get_u32le(cur);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/**
+ * Reads a 32 bit IEEE 754 float stored as its bit pattern, big endian.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The value, 0 when out of bounds.
+ */
+float buff_get_f32be(BuffCursor *cur){
+    uint32_t bits = buff_get_u32be(cur);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/**
+ * Reads a 64 bit IEEE 754 float stored as its bit pattern, little endian.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The value, 0 when out of bounds.
+ */
+double buff_get_f64le(BuffCursor *cur){
+    uint64_t bits = buff_get_u64le(cur);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/**
+ * Reads a 64 bit IEEE 754 float stored as its bit pattern, big endian.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The value, 0 when out of bounds.
+ */
+double buff_get_f64be(BuffCursor *cur){
+    uint64_t bits = buff_get_u64be(cur);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/**
+ * Appends an unsigned LEB128 varint, 7 bits per byte, low bits first.
+ *
+ * @param buff The buffer.
+ * @param v The value.
+ *
+ * @returns None
+ */
+void buff_put_uvarint(Buffer *buff, uint64_t v){
+    buff_reserve(buff, VARINT_MAX);
+    byte *p = tail(buff);
+    size_t n = 0;
+    while(v >= 0x80){
+        p[n ++] = (byte) v | 0x80;
+        v >>= 7;
+    }
+    p[n ++] = (byte) v;
+    buff->size += n;
+}
+
+/**
+ * Appends a signed varint, zigzag mapped so small negative values stay short.
+ *
+ * @param buff The buffer.
+ * @param v The value.
+ *
+ * @returns None
+ */
+void buff_put_svarint(Buffer *buff, int64_t v){
+    buff_put_uvarint(buff, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+/**
+ * Appends a byte string prefixed with its length as a uvarint.
+ *
+ * @param buff The buffer.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ *
+ * @returns None
+ */
+void buff_put_bytes(Buffer *buff, const void *data, size_t size){
+    buff_put_uvarint(buff, size);
+    buff_reserve(buff, size);
+    memcpy(tail(buff), data, size);
+    buff->size += size;
+}
+
+/**
+ * Starts decoding a buffer from its first byte.
+ *
+ * @param cur The cursor.
+ * @param buff The buffer to decode.
+ *
+ * @returns None
+ */
+void buff_cursor_init(BuffCursor *cur, Buffer *buff){
+    cur->buff = buff;
+    cur->pos = 0;
+    cur->error = 0;
+}
+
+/**
+ * Returns the number of bytes left after the cursor.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The number of bytes.
+ */
+size_t buff_cursor_remaining(BuffCursor *cur){
+    return cur->buff->size - cur->pos;
+}
+
+/**
+ * Reads a single byte.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The byte, 0 when out of bounds.
+ */
+uint8_t buff_get_u8(BuffCursor *cur){
+    uint8_t v;
+    return take(cur, &v, 1) ? v : 0;
+}
+
+/**
+ * Reads an unsigned LEB128 varint. Truncated varints, varints longer than
+ * VARINT_MAX bytes and varints whose last byte carries bits past 64 flag
+ * the cursor.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The value, 0 on error.
+ */
+uint64_t buff_get_uvarint(BuffCursor *cur){
+    const byte *p = (byte *) cur->buff->body + cur->pos;
+    size_t avail = cur->error ? 0 : cur->buff->size - cur->pos;
+    uint64_t v = 0;
+    for(size_t i = 0; i < avail && i < VARINT_MAX; i ++){
+        /* the tenth byte holds only bit 63 */
+        if(i == VARINT_MAX - 1 && p[i] > 1){
+            break;
+        }
+        v |= (uint64_t) (p[i] & 0x7f) << (7 * i);
+        if(!(p[i] & 0x80)){
+            cur->pos += i + 1;
+            return v;
+        }
+    }
+    cur->error = 1;
+    return 0;
+}
+
+/**
+ * Reads a zigzag encoded signed varint.
+ *
+ * @param cur The cursor.
+ *
+ * @returns The value, 0 on error.
+ */
+int64_t buff_get_svarint(BuffCursor *cur){
+    uint64_t v = buff_get_uvarint(cur);
+    return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+/**
+ * Reads a length prefixed byte string without copying it.
+ *
+ * @param cur The cursor.
+ * @param size Receives the length of the string.
+ *
+ * @returns A pointer to the bytes inside the buffer, valid until the buffer
+ *          is modified, or NULL on error.
+ */
+const void *buff_get_bytes(BuffCursor *cur, size_t *size){
+    size_t start = cur->pos;
+    uint64_t len = buff_get_uvarint(cur);
+    if(cur->error || buff_cursor_remaining(cur) < len){
+        cur->pos = start;
+        cur->error = 1;
+        *size = 0;
+        return NULL;
+    }
+    const void *data = (byte *) cur->buff->body + cur->pos;
+    cur->pos += len;
+    *size = len;
+    return data;
+}
@@ -0,0 +1,73 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/* the longest LEB128 encoding of a 64-bit value */
+#define VARINT_MAX 10
+
+/**
+ * A bounds checked read position in a Buffer.
+ *
+ * Reads past the end do not fail individually: they return 0, leave pos
+ * unchanged and set the sticky error flag, so a whole message can be
+ * decoded and checked once at the end.
+ *
+ * @param buff The buffer being decoded.
+ * @param pos The offset of the next byte to read.
+ * @param error Nonzero once any read was out of bounds or malformed.
+ */
+struct buff_cursor {
+    Buffer *buff;
+    size_t pos;
+    int error;
+};
+typedef struct buff_cursor BuffCursor;
+
+/* function prototypes */
+void buff_put_u8(Buffer *buff, uint8_t v);
+void buff_put_u16le(Buffer *buff, uint16_t v);
+void buff_put_u16be(Buffer *buff, uint16_t v);
+void buff_put_u32le(Buffer *buff, uint32_t v);
+void buff_put_u32be(Buffer *buff, uint32_t v);
+void buff_put_u64le(Buffer *buff, uint64_t v);
+void buff_put_u64be(Buffer *buff, uint64_t v);
+void buff_put_f32le(Buffer *buff, float v);
+void buff_put_f32be(Buffer *buff, float v);
+void buff_put_f64le(Buffer *buff, double v);
+void buff_put_f64be(Buffer *buff, double v);
+void buff_put_uvarint(Buffer *buff, uint64_t v);
+void buff_put_svarint(Buffer *buff, int64_t v);
+void buff_put_bytes(Buffer *buff, const void *data, size_t size);
+void buff_put_u16le_array(Buffer *buff, const uint16_t *src, size_t n);
+void buff_put_u16be_array(Buffer *buff, const uint16_t *src, size_t n);
+void buff_put_u32le_array(Buffer *buff, const uint32_t *src, size_t n);
+void buff_put_u32be_array(Buffer *buff, const uint32_t *src, size_t n);
+void buff_put_u64le_array(Buffer *buff, const uint64_t *src, size_t n);
+void buff_put_u64be_array(Buffer *buff, const uint64_t *src, size_t n);
+
+void buff_cursor_init(BuffCursor *cur, Buffer *buff);
+size_t buff_cursor_remaining(BuffCursor *cur);
+uint8_t buff_get_u8(BuffCursor *cur);
+uint16_t buff_get_u16le(BuffCursor *cur);
+uint16_t buff_get_u16be(BuffCursor *cur);
+uint32_t buff_get_u32le(BuffCursor *cur);
+uint32_t buff_get_u32be(BuffCursor *cur);
+uint64_t buff_get_u64le(BuffCursor *cur);
+uint64_t buff_get_u64be(BuffCursor *cur);
+float buff_get_f32le(BuffCursor *cur);
+float buff_get_f32be(BuffCursor *cur);
+double buff_get_f64le(BuffCursor *cur);
+double buff_get_f64be(BuffCursor *cur);
+uint64_t buff_get_uvarint(BuffCursor *cur);
+int64_t buff_get_svarint(BuffCursor *cur);
+const void *buff_get_bytes(BuffCursor *cur, size_t *size);
+int buff_get_u16le_array(BuffCursor *cur, uint16_t *dst, size_t n);
+int buff_get_u16be_array(BuffCursor *cur, uint16_t *dst, size_t n);
+int buff_get_u32le_array(BuffCursor *cur, uint32_t *dst, size_t n);
+int buff_get_u32be_array(BuffCursor *cur, uint32_t *dst, size_t n);
+int buff_get_u64le_array(BuffCursor *cur, uint64_t *dst, size_t n);
+int buff_get_u64be_array(BuffCursor *cur, uint64_t *dst, size_t n);
+
+#endif
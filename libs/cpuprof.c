@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+#include "cpuprof.h"
+#include "buffer.h"
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+/* frames of the signal handler itself and of the kernel's signal trampoline */
+#define SKIP_FRAMES 2
+
+/* the CPU timer of a registered thread, listed so cpuprof_stop can delete it */
+struct thread_timer {
+    timer_t timer;
+    int armed;
+    struct thread_timer *next;
+};
+
+/* one captured stack, leaf first */
+struct sample {
+    _Atomic uint32_t ready;
+    uint32_t depth;
+    void *pcs[CPUPROF_MAX_DEPTH];
+};
+
+static struct sample *samples = NULL;
+static size_t capacity = 0;
+static _Atomic size_t next;
+static _Atomic size_t dropped;
+static unsigned int rate;
+static int mode;
+static volatile sig_atomic_t running = 0;
+static int installed = 0;
+static struct sigaction old_action;
+static pthread_mutex_t timers_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_timer *timers = NULL;
+static _Thread_local struct thread_timer *own_timer = NULL;
+
+/* async-signal-safe: no locks, no allocation, only a slot claimed by fetch_add */
+static void on_sigprof(int sig, siginfo_t *info, void *ctx){
+    (void) sig;
+    (void) info;
+    (void) ctx;
+    if(!running){
+        return;
+    }
+    int saved = errno;
+    void *pcs[CPUPROF_MAX_DEPTH + SKIP_FRAMES];
+    int n = backtrace(pcs, CPUPROF_MAX_DEPTH + SKIP_FRAMES);
+    size_t idx = atomic_fetch_add_explicit(&next, 1, memory_order_relaxed);
+    if(idx >= capacity){
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+    }else{
+        struct sample *s = &samples[idx];
+        int depth = n > SKIP_FRAMES ? n - SKIP_FRAMES : 0;
+        memcpy(s->pcs, pcs + SKIP_FRAMES, depth * sizeof(void *));
+        s->depth = depth;
+        atomic_store_explicit(&s->ready, 1, memory_order_release);
+    }
+    errno = saved;
+}
+
+static struct timespec period(void){
+    struct timespec ts;
+    ts.tv_sec = rate == 1 ? 1 : 0;
+    ts.tv_nsec = rate == 1 ? 0 : 1000000000L / rate;
+    return ts;
+}
+
+/**
+ * Starts sampling the CPU time of the process.
+ *
+ * SIGPROF is handled through sys_sigaction. By default ITIMER_PROF is armed,
+ * which charges the CPU time of all threads and delivers the signal to the
+ * thread that was running. With CPUPROF_PER_THREAD each thread that calls
+ * cpuprof_register_thread (the caller is registered here) gets its own CPU
+ * time timer instead, which spreads samples fairly across busy threads.
+ *
+ * @param hz Samples per CPU second, 100 keeps the overhead well under 1%.
+ * @param max_samples The number of preallocated sample slots, samples beyond
+ *                    this are counted as dropped.
+ * @param flags 0 or CPUPROF_PER_THREAD.
+ *
+ * @returns None
+ */
+void cpuprof_start(unsigned int hz, size_t max_samples, int flags){
+    if(hz == 0 || hz > 1000000){
+        print(STDERR_FILENO, "Error: cpuprof rate %u out of range\n", hz);
+        exit(EXIT_FAILURE);
+    }
+    if(samples != NULL && max_samples != capacity){
+        munmap(samples, capacity * sizeof(struct sample));
+        samples = NULL;
+    }
+    if(samples == NULL){
+        samples = mmap(NULL, max_samples * sizeof(struct sample), PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(samples == MAP_FAILED){
+            samples = NULL;
+            print_err_exit("mmap", errno);
+        }
+        capacity = max_samples;
+    }
+    cpuprof_reset();
+    rate = hz;
+    mode = flags;
+
+    /* the first backtrace loads the unwinder, which must not happen in the handler */
+    void *warm[4];
+    backtrace(warm, 4);
+
+    if(!installed){
+        struct sigaction act;
+        memset(&act, 0, sizeof(act));
+        act.sa_sigaction = on_sigprof;
+        act.sa_flags = SA_SIGINFO | SA_RESTART;
+        sys_sigemptyset(&act.sa_mask);
+        sys_sigaction(SIGPROF, &act, &old_action);
+        installed = 1;
+    }
+    running = 1;
+
+    if(mode & CPUPROF_PER_THREAD){
+        cpuprof_register_thread();
+    }else{
+        struct itimerval it;
+        struct timespec ts = period();
+        it.it_interval.tv_sec = ts.tv_sec;
+        it.it_interval.tv_usec = ts.tv_nsec / 1000;
+        it.it_value = it.it_interval;
+        sys_setitimer(ITIMER_PROF, &it, NULL);
+    }
+}
+
+/**
+ * Gives the calling thread its own CPU time timer. Only needed with
+ * CPUPROF_PER_THREAD, threads must unregister before they exit.
+ *
+ * @returns 0 on success, -1 if the timer could not be created.
+ */
+int cpuprof_register_thread(void){
+    if(!running || !(mode & CPUPROF_PER_THREAD)){
+        return 0;
+    }
+    pthread_mutex_lock(&timers_lock);
+    if(own_timer != NULL && own_timer->armed){
+        pthread_mutex_unlock(&timers_lock);
+        return 0;
+    }
+    if(own_timer == NULL){
+        own_timer = sec_malloc(sizeof(struct thread_timer));
+        own_timer->armed = 0;
+        own_timer->next = timers;
+        timers = own_timer;
+    }
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = gettid();
+    int res = -1;
+    if(timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &own_timer->timer) == 0){
+        struct itimerspec its;
+        its.it_interval = period();
+        its.it_value = its.it_interval;
+        if(timer_settime(own_timer->timer, 0, &its, NULL) == 0){
+            own_timer->armed = 1;
+            res = 0;
+        }else{
+            timer_delete(own_timer->timer);
+        }
+    }
+    pthread_mutex_unlock(&timers_lock);
+    return res;
+}
+
+/**
+ * Deletes the calling thread's timer, if it has one.
+ *
+ * @returns None
+ */
+void cpuprof_unregister_thread(void){
+    if(own_timer == NULL){
+        return;
+    }
+    pthread_mutex_lock(&timers_lock);
+    if(own_timer->armed){
+        timer_delete(own_timer->timer);
+    }
+    for(struct thread_timer **t = &timers; *t != NULL; t = &(*t)->next){
+        if(*t == own_timer){
+            *t = own_timer->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timers_lock);
+    sec_free(own_timer);
+    own_timer = NULL;
+}
+
+/**
+ * Stops sampling and restores the previous SIGPROF handler. With
+ * CPUPROF_PER_THREAD the timers of all registered threads are deleted;
+ * the threads stay listed until they unregister.
+ *
+ * @returns None
+ */
+void cpuprof_stop(void){
+    if(!running){
+        return;
+    }
+    running = 0;
+    if(mode & CPUPROF_PER_THREAD){
+        pthread_mutex_lock(&timers_lock);
+        for(struct thread_timer *t = timers; t != NULL; t = t->next){
+            if(t->armed){
+                timer_delete(t->timer);
+                t->armed = 0;
+            }
+        }
+        pthread_mutex_unlock(&timers_lock);
+    }else{
+        struct itimerval it;
+        memset(&it, 0, sizeof(it));
+        sys_setitimer(ITIMER_PROF, &it, NULL);
+    }
+    if(installed){
+        sys_sigaction(SIGPROF, &old_action, NULL);
+        installed = 0;
+    }
+}
+
+/**
+ * Reports how many samples were taken and lost.
+ *
+ * @param stats The counters to fill.
+ *
+ * @returns None
+ */
+void cpuprof_stats(CpuprofStats *stats){
+    size_t taken = atomic_load(&next);
+    stats->hz = rate;
+    stats->samples = taken < capacity ? taken : capacity;
+    stats->dropped = atomic_load(&dropped);
+}
+
+/**
+ * Discards all samples.
+ *
+ * @returns None
+ */
+void cpuprof_reset(void){
+    size_t used = atomic_load(&next);
+    used = used < capacity ? used : capacity;
+    for(size_t i = 0; i < used; i ++){
+        atomic_store(&samples[i].ready, 0);
+    }
+    atomic_store(&next, 0);
+    atomic_store(&dropped, 0);
+}
+
+/* a symbolized stack inside the text buffer of cpuprof_write_folded */
+struct line {
+    size_t off;
+    size_t len;
+};
+
+static int cmp_line(const void *a, const void *b, void *text){
+    const struct line *x = a, *y = b;
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp((byte *) text + x->off, (byte *) text + y->off, n);
+    return c ? c : (x->len > y->len) - (x->len < y->len);
+}
+
+/* return addresses point after the call, step back into it for the lookup */
+static void append_frame(Buffer *out, void *pc, int is_leaf){
+    char name[256];
+    Dl_info info;
+    void *lookup = is_leaf ? pc : (char *) pc - 1;
+    int len;
+    if(!dladdr(lookup, &info)){
+        len = snprintf(name, sizeof(name), "%p", pc);
+    }else if(info.dli_sname != NULL){
+        len = snprintf(name, sizeof(name), "%s", info.dli_sname);
+    }else{
+        const char *base = strrchr(info.dli_fname, '/');
+        len = snprintf(name, sizeof(name), "%s+0x%zx", base ? base + 1 : info.dli_fname,
+                       (size_t) ((char *) lookup - (char *) info.dli_fbase));
+    }
+    if(buff_capacity(out) - buff_size(out) < sizeof(name) + 1){
+        buff_resize(out, buff_capacity(out) * 2 + sizeof(name) + 1);
+    }
+    buff_append(out, name, (size_t) len < sizeof(name) ? (size_t) len : sizeof(name) - 1);
+}
+
+/**
+ * Writes the samples as folded stacks ("root;...;leaf count" per line), the
+ * input format of flamegraph.pl and most flame graph viewers. Samples are
+ * merged by symbol, so different offsets within a function count together.
+ *
+ * @param fd The file descriptor to write to.
+ *
+ * @returns None
+ */
+void cpuprof_write_folded(int fd){
+    CpuprofStats stats;
+    cpuprof_stats(&stats);
+    struct line *lines = sec_malloc((stats.samples + 1) * sizeof(struct line));
+    Buffer *text = buff_init(4096);
+    size_t n = 0;
+    for(size_t i = 0; i < stats.samples; i ++){
+        struct sample *s = &samples[i];
+        if(!atomic_load(&s->ready) || s->depth == 0){
+            continue;
+        }
+        lines[n].off = buff_size(text);
+        for(int f = s->depth - 1; f >= 0; f --){
+            append_frame(text, s->pcs[f], f == 0);
+            if(f > 0){
+                buff_append_byte(text, ';');
+            }
+        }
+        lines[n].len = buff_size(text) - lines[n].off;
+        n ++;
+    }
+    qsort_r(lines, n, sizeof(struct line), cmp_line, buff_body(text));
+
+    Buffer *out = buff_init(4096);
+    char count[32];
+    for(size_t i = 0; i < n; ){
+        size_t j = i + 1;
+        while(j < n && cmp_line(&lines[i], &lines[j], buff_body(text)) == 0){
+            j ++;
+        }
+        int len = snprintf(count, sizeof(count), " %zu\n", j - i);
+        if(buff_capacity(out) - buff_size(out) < lines[i].len + len){
+            buff_resize(out, buff_capacity(out) * 2 + lines[i].len + len);
+        }
+        buff_append(out, (byte *) buff_body(text) + lines[i].off, lines[i].len);
+        buff_append(out, count, len);
+        i = j;
+    }
+    for(size_t off = 0; off < buff_size(out); ){
+        off += sys_write(fd, (byte *) buff_body(out) + off, buff_size(out) - off);
+    }
+    buff_free(out);
+    buff_free(text);
+    sec_free(lines);
+}
@@ -0,0 +1,37 @@
+#ifndef CPUPROF_H
+#define CPUPROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "syscalls.h"
+
+/* deepest stack recorded per sample, deeper stacks are truncated at the root */
+#define CPUPROF_MAX_DEPTH 64
+
+/* cpuprof_start flags */
+#define CPUPROF_PER_THREAD 1 /* one CPU timer per registered thread instead of ITIMER_PROF */
+
+/**
+ * Counters of the running or last profile.
+ *
+ * @param hz The sampling rate in samples per CPU second.
+ * @param samples The number of samples stored.
+ * @param dropped Samples lost because the sample buffer was full.
+ */
+struct cpuprof_stats {
+    unsigned int hz;
+    size_t samples;
+    size_t dropped;
+};
+typedef struct cpuprof_stats CpuprofStats;
+
+/* function prototypes */
+void cpuprof_start(unsigned int hz, size_t max_samples, int flags);
+int cpuprof_register_thread(void);
+void cpuprof_unregister_thread(void);
+void cpuprof_stop(void);
+void cpuprof_stats(CpuprofStats *stats);
+void cpuprof_write_folded(int fd);
+void cpuprof_reset(void);
+
+#endif
@@ -0,0 +1,459 @@
+#include "encoding.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/*
+ * The kernels convert as much of the input as they can in whole blocks and
+ * return how much they consumed; the scalar code finishes the rest. Decode
+ * kernels stop in front of the first block holding an invalid character,
+ * so the scalar code is also what reports errors.
+ */
+typedef size_t (*kernel_fn)(byte *dst, const byte *src, size_t n);
+
+static size_t none(byte *dst, const byte *src, size_t n){
+    (void) dst;
+    (void) src;
+    (void) n;
+    return 0;
+}
+
+/* resolved once at load time from the CPU features, see select_impl */
+static kernel_fn hex_enc = none;
+static kernel_fn hex_dec = none;
+static kernel_fn b64_enc = none;
+static kernel_fn b64_dec = none;
+static const char *impl_name = "scalar";
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char b64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* character to value, -1 for characters outside the alphabet */
+static int8_t hex_value[256];
+static int8_t b64_value[256];
+
+#ifdef HAVE_X86_SIMD
+/* 16 bytes to 32 hex digits: split nibbles, look them up, interleave */
+__attribute__((target("ssse3")))
+static size_t hex_enc_ssse3(byte *dst, const byte *src, size_t n){
+    const __m128i lut = _mm_loadu_si128((const __m128i *) hex_digits);
+    const __m128i low = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, low));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_enc_avx2(byte *dst, const byte *src, size_t n){
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) hex_digits));
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+        /* the unpacks work per 128-bit lane, the permutes restore the order */
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *) (dst + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *) (dst + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return i + hex_enc_ssse3(dst + 2 * i, src + i, n - i);
+}
+
+/* 16 hex digits to nibble values, all-ones in *bad where a digit is invalid */
+__attribute__((target("ssse3")))
+static inline __m128i hex_nibbles(__m128i c, __m128i *bad){
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    *bad = _mm_or_si128(*bad, _mm_xor_si128(_mm_or_si128(is_digit, is_letter), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+__attribute__((target("ssse3")))
+static size_t hex_dec_ssse3(byte *dst, const byte *src, size_t n){
+    /* pairs of nibbles to bytes: high * 16 + low */
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32){
+        __m128i bad = _mm_setzero_si128();
+        __m128i a = hex_nibbles(_mm_loadu_si128((const __m128i *) (src + i)), &bad);
+        __m128i b = hex_nibbles(_mm_loadu_si128((const __m128i *) (src + i + 16)), &bad);
+        if(_mm_movemask_epi8(bad)){
+            break;
+        }
+        a = _mm_maddubs_epi16(a, weights);
+        b = _mm_maddubs_epi16(b, weights);
+        _mm_storeu_si128((__m128i *) (dst + i / 2), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_nibbles_avx2(__m256i c, __m256i *bad){
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+    *bad = _mm256_or_si256(*bad, _mm256_xor_si256(_mm256_or_si256(is_digit, is_letter), _mm256_set1_epi8(-1)));
+    return _mm256_or_si256(_mm256_and_si256(is_digit, digit),
+                           _mm256_and_si256(is_letter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+static size_t hex_dec_avx2(byte *dst, const byte *src, size_t n){
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64){
+        __m256i bad = _mm256_setzero_si256();
+        __m256i a = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *) (src + i)), &bad);
+        __m256i b = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *) (src + i + 32)), &bad);
+        if(_mm256_movemask_epi8(bad)){
+            break;
+        }
+        a = _mm256_maddubs_epi16(a, weights);
+        b = _mm256_maddubs_epi16(b, weights);
+        /* packus interleaves the lanes, qwords 0 2 1 3 puts them back */
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *) (dst + i / 2), packed);
+    }
+    return i + hex_dec_ssse3(dst + i / 2, src + i, n - i);
+}
+
+/*
+ * Base64 after Muła and Lemire, "Faster Base64 Encoding and Decoding Using
+ * AVX2 Instructions": 12 bytes are spread over 16 lanes, the four 6-bit
+ * fields of each 3 byte group are isolated with two multiplies, and the
+ * indices become characters by adding a per-range offset.
+ */
+__attribute__((target("ssse3")))
+static inline __m128i b64_indices(__m128i in){
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i b64_chars(__m128i idx){
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                          '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+    return _mm_add_epi8(idx, _mm_shuffle_epi8(offsets, range));
+}
+
+__attribute__((target("ssse3")))
+static size_t b64_enc_ssse3(byte *dst, const byte *src, size_t n){
+    size_t i = 0, o = 0;
+    /* each load reads 16 bytes and uses 12 */
+    for(; i + 16 <= n; i += 12, o += 16){
+        __m128i in = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + o), b64_chars(b64_indices(in)));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t b64_enc_avx2(byte *dst, const byte *src, size_t n){
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                             '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                             '/' - 63, 'A', 0, 0);
+    size_t i = 0, o = 0;
+    /* 24 bytes per step, 12 in each lane */
+    for(; i + 28 <= n; i += 24, o += 32){
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (src + i))),
+                                             _mm_loadu_si128((const __m128i *) (src + i + 12)), 1);
+        in = _mm256_shuffle_epi8(in, shuffle);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i idx = _mm256_or_si256(t0, t1);
+        __m256i range = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx),
+                                                        _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i *) (dst + o), _mm256_add_epi8(idx, _mm256_shuffle_epi8(offsets, range)));
+    }
+    return i + b64_enc_ssse3(dst + o, src + i, n - i);
+}
+
+/*
+ * Decoding classifies each character by its high nibble (which offset maps
+ * it to its 6-bit value) and validates it with a bitmask indexed by its low
+ * nibble, then packs the 6-bit fields back with two multiply-adds. Stores
+ * write 4 (SSSE3) or 8 (AVX2) bytes past the decoded data.
+ */
+__attribute__((target("ssse3")))
+static size_t b64_dec_ssse3(byte *dst, const byte *src, size_t n){
+    const __m128i shifts = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i masks = _mm_setr_epi8((char) 0xa8, (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8,
+                                        (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8,
+                                        (char) 0xf0, 0x54, 0x50, 0x50, 0x50, 0x54);
+    const __m128i bits = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+                                       0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0, o = 0;
+    for(; i + 16 <= n; i += 16, o += 12){
+        __m128i in = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+        __m128i lo = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+        __m128i ok = _mm_and_si128(_mm_shuffle_epi8(masks, lo), _mm_shuffle_epi8(bits, hi));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(ok, _mm_setzero_si128()))){
+            break;
+        }
+        __m128i shift = _mm_shuffle_epi8(shifts, hi);
+        __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        shift = _mm_or_si128(_mm_andnot_si128(slash, shift), _mm_and_si128(slash, _mm_set1_epi8(16)));
+        __m128i v = _mm_add_epi8(in, shift);
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *) (dst + o), _mm_shuffle_epi8(v, pack));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t b64_dec_avx2(byte *dst, const byte *src, size_t n){
+    const __m256i shifts = _mm256_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i masks = _mm256_setr_epi8((char) 0xa8, (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8,
+                                           (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8,
+                                           (char) 0xf0, 0x54, 0x50, 0x50, 0x50, 0x54,
+                                           (char) 0xa8, (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8,
+                                           (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8, (char) 0xf8,
+                                           (char) 0xf0, 0x54, 0x50, 0x50, 0x50, 0x54);
+    const __m256i bits = _mm256_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+                                          0, 0, 0, 0, 0, 0, 0, 0,
+                                          0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+                                          0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0, o = 0;
+    for(; i + 32 <= n; i += 32, o += 24){
+        __m256i in = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0f));
+        __m256i lo = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+        __m256i ok = _mm256_and_si256(_mm256_shuffle_epi8(masks, lo), _mm256_shuffle_epi8(bits, hi));
+        if(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ok, _mm256_setzero_si256()))){
+            break;
+        }
+        __m256i shift = _mm256_shuffle_epi8(shifts, hi);
+        shift = _mm256_blendv_epi8(shift, _mm256_set1_epi8(16), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/')));
+        __m256i v = _mm256_add_epi8(in, shift);
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack), lanes);
+        _mm256_storeu_si256((__m256i *) (dst + o), v);
+    }
+    return i + b64_dec_ssse3(dst + o, src + i, n - i);
+}
+#endif
+
+__attribute__((constructor))
+static void select_impl(void){
+    memset(hex_value, -1, sizeof(hex_value));
+    memset(b64_value, -1, sizeof(b64_value));
+    for(int i = 0; i < 16; i ++){
+        hex_value[(byte) hex_digits[i]] = i;
+    }
+    for(int i = 10; i < 16; i ++){
+        hex_value['A' + i - 10] = i;
+    }
+    for(int i = 0; i < 64; i ++){
+        b64_value[(byte) b64_alphabet[i]] = i;
+    }
+#ifdef HAVE_X86_SIMD
+    const char *cap = getenv("ENCODING_IMPL");
+    if(cap != NULL && strcmp(cap, "scalar") == 0){
+        return;
+    }
+    __builtin_cpu_init();
+    if(!__builtin_cpu_supports("ssse3")){
+        return;
+    }
+    hex_enc = hex_enc_ssse3;
+    hex_dec = hex_dec_ssse3;
+    b64_enc = b64_enc_ssse3;
+    b64_dec = b64_dec_ssse3;
+    impl_name = "ssse3";
+    if(cap != NULL && strcmp(cap, "ssse3") == 0){
+        return;
+    }
+    if(__builtin_cpu_supports("avx2")){
+        hex_enc = hex_enc_avx2;
+        hex_dec = hex_dec_avx2;
+        b64_enc = b64_enc_avx2;
+        b64_dec = b64_dec_avx2;
+        impl_name = "avx2";
+    }
+#endif
+}
+
+/**
+ * Returns the name of the implementation in use: "avx2", "ssse3" or
+ * "scalar". Setting ENCODING_IMPL to "ssse3" or "scalar" caps the choice.
+ *
+ * @returns The name.
+ */
+const char *enc_impl(void){
+    return impl_name;
+}
+
+/**
+ * Appends the lowercase hex encoding of a range to a buffer.
+ *
+ * @param dst The buffer to append to.
+ * @param src The bytes to encode.
+ * @param size The number of bytes in src.
+ *
+ * @returns None
+ */
+void buff_hex_encode(Buffer *dst, const void *src, size_t size){
+    buff_reserve(dst, enc_hex_len(size));
+    byte *out = (byte *) dst->body + dst->size;
+    const byte *in = src;
+    size_t i = hex_enc(out, in, size);
+    for(; i < size; i ++){
+        out[2 * i] = hex_digits[in[i] >> 4];
+        out[2 * i + 1] = hex_digits[in[i] & 0x0f];
+    }
+    dst->size += enc_hex_len(size);
+}
+
+/**
+ * Appends the bytes encoded by a hex string to a buffer. Both cases are
+ * accepted; anything else, including whitespace and an odd length, is an
+ * error.
+ *
+ * @param dst The buffer to append to, unchanged on error.
+ * @param text The hex digits.
+ * @param len The number of characters in text.
+ *
+ * @returns 0 on success, -1 if text is not valid hex.
+ */
+int buff_hex_decode(Buffer *dst, const void *text, size_t len){
+    if(len % 2){
+        return -1;
+    }
+    buff_reserve(dst, len / 2);
+    byte *out = (byte *) dst->body + dst->size;
+    const byte *in = text;
+    for(size_t i = hex_dec(out, in, len); i < len; i += 2){
+        int hi = hex_value[in[i]], lo = hex_value[in[i + 1]];
+        if(hi < 0 || lo < 0){
+            return -1;
+        }
+        out[i / 2] = hi << 4 | lo;
+    }
+    dst->size += len / 2;
+    return 0;
+}
+
+/**
+ * Appends the base64 encoding (RFC 4648, standard alphabet, padded) of a
+ * range to a buffer.
+ *
+ * @param dst The buffer to append to.
+ * @param src The bytes to encode.
+ * @param size The number of bytes in src.
+ *
+ * @returns None
+ */
+void buff_base64_encode(Buffer *dst, const void *src, size_t size){
+    buff_reserve(dst, enc_base64_len(size));
+    byte *out = (byte *) dst->body + dst->size;
+    const byte *in = src;
+    size_t i = b64_enc(out, in, size);
+    byte *o = out + i / 3 * 4;
+    for(; i + 3 <= size; i += 3, o += 4){
+        uint32_t v = (uint32_t) in[i] << 16 | in[i + 1] << 8 | in[i + 2];
+        o[0] = b64_alphabet[v >> 18];
+        o[1] = b64_alphabet[(v >> 12) & 0x3f];
+        o[2] = b64_alphabet[(v >> 6) & 0x3f];
+        o[3] = b64_alphabet[v & 0x3f];
+    }
+    if(i < size){
+        uint32_t v = (uint32_t) in[i] << 16 | (i + 1 < size ? in[i + 1] << 8 : 0);
+        o[0] = b64_alphabet[v >> 18];
+        o[1] = b64_alphabet[(v >> 12) & 0x3f];
+        o[2] = i + 1 < size ? b64_alphabet[(v >> 6) & 0x3f] : '=';
+        o[3] = '=';
+    }
+    dst->size += enc_base64_len(size);
+}
+
+/**
+ * Appends the bytes encoded by a base64 string to a buffer. Decoding is
+ * strict: the length must be a multiple of 4, '=' may only pad the final
+ * group, the bits dropped by padding must be zero, and whitespace or
+ * characters of other alphabets are errors.
+ *
+ * @param dst The buffer to append to, unchanged on error.
+ * @param text The base64 characters.
+ * @param len The number of characters in text.
+ *
+ * @returns 0 on success, -1 if text is not valid base64.
+ */
+int buff_base64_decode(Buffer *dst, const void *text, size_t len){
+    if(len % 4){
+        return -1;
+    }
+    if(len == 0){
+        return 0;
+    }
+    /* the SIMD stores overrun by up to 8 bytes */
+    buff_reserve(dst, len / 4 * 3 + 8);
+    byte *out = (byte *) dst->body + dst->size;
+    const byte *in = text;
+    /* the final group may hold padding, it is always decoded here */
+    size_t i = b64_dec(out, in, len - 4) / 4 * 4;
+    byte *o = out + i / 4 * 3;
+    for(; i < len; i += 4){
+        int a = b64_value[in[i]], b = b64_value[in[i + 1]];
+        int c = b64_value[in[i + 2]], d = b64_value[in[i + 3]];
+        if((a | b | c | d) >= 0){
+            uint32_t v = (uint32_t) a << 18 | b << 12 | c << 6 | d;
+            o[0] = v >> 16;
+            o[1] = v >> 8;
+            o[2] = v;
+            o += 3;
+            continue;
+        }
+        if(i + 4 != len || a < 0 || b < 0 || in[i + 3] != '='){
+            return -1;
+        }
+        if(in[i + 2] == '='){
+            if(b & 0x0f){
+                return -1;
+            }
+            *o ++ = a << 2 | b >> 4;
+        }else{
+            if(c < 0 || (c & 0x03)){
+                return -1;
+            }
+            *o ++ = a << 2 | b >> 4;
+            *o ++ = (b << 4 | c >> 2) & 0xff;
+        }
+    }
+    dst->size += o - out;
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/* the encoded length of size bytes */
+#define enc_hex_len(size) ((size) * 2)
+#define enc_base64_len(size) (((size) + 2) / 3 * 4)
+
+/* function prototypes */
+void buff_hex_encode(Buffer *dst, const void *src, size_t size);
+int buff_hex_decode(Buffer *dst, const void *text, size_t len);
+void buff_base64_encode(Buffer *dst, const void *src, size_t size);
+int buff_base64_decode(Buffer *dst, const void *text, size_t len);
+const char *enc_impl(void);
+
+#endif
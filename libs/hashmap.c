@@ -0,0 +1,404 @@
+#include "hashmap.h"
+#include "checksum.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Control bytes: EMPTY and DELETED have the high bit set, a full slot
+ * holds the top 7 bits of its hash (H2). The rest of the hash (H1) picks
+ * the first group to probe; groups are then probed in triangular steps,
+ * which visits every group of a power of two table. A lookup stops at the
+ * first group with an EMPTY byte, so an erased slot only becomes EMPTY
+ * again when its group already has one, and DELETED otherwise.
+ */
+#define EMPTY 0x80
+#define DELETED 0xfe
+
+/* the table grows once 7/8 of the slots are used */
+#define max_load(capacity) ((capacity) - (capacity) / 8)
+
+static inline uint64_t mix(uint64_t x){
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline __attribute__((always_inline))
+uint64_t hash_sized(const Map *map, const void *key, size_t key_size){
+    if(key_size == 8){
+        uint64_t x;
+        memcpy(&x, key, 8);
+        return mix(x ^ map->seed);
+    }
+    if(key_size == 4){
+        uint32_t x;
+        memcpy(&x, key, 4);
+        return mix(x ^ map->seed);
+    }
+    return cksum_hash64(key, key_size, map->seed);
+}
+
+static uint64_t hash_key(const Map *map, const void *key){
+    return hash_sized(map, key, map->key_size);
+}
+
+static inline byte *slot(const Map *map, size_t i){
+    return map->slots + i * map->slot_size;
+}
+
+/* bitmasks over the 16 control bytes of a group */
+#ifdef __SSE2__
+static inline unsigned group_match(const byte *ctrl, byte h2){
+    __m128i g = _mm_load_si128((const __m128i *) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char) h2)));
+}
+
+static inline unsigned group_empty(const byte *ctrl){
+    __m128i g = _mm_load_si128((const __m128i *) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char) EMPTY)));
+}
+
+/* empty or deleted */
+static inline unsigned group_free(const byte *ctrl){
+    return _mm_movemask_epi8(_mm_load_si128((const __m128i *) ctrl));
+}
+#else
+static inline unsigned group_match(const byte *ctrl, byte h2){
+    unsigned m = 0;
+    for(int i = 0; i < MAP_GROUP; i ++){
+        m |= (unsigned) (ctrl[i] == h2) << i;
+    }
+    return m;
+}
+
+static inline unsigned group_empty(const byte *ctrl){
+    return group_match(ctrl, EMPTY);
+}
+
+static inline unsigned group_free(const byte *ctrl){
+    unsigned m = 0;
+    for(int i = 0; i < MAP_GROUP; i ++){
+        m |= (unsigned) (ctrl[i] >> 7) << i;
+    }
+    return m;
+}
+#endif
+
+/*
+ * Hashes and probes, instantiated per common key size below so that the
+ * whole lookup compiles to a short loop of plain loads and compares. Few
+ * instructions per lookup matter: on tables larger than the cache, the
+ * time goes to misses, and how many lookups overlap is bounded by how
+ * many fit in the reorder window.
+ */
+static inline __attribute__((always_inline))
+ssize_t find_sized(const Map *map, const void *key, uint64_t *hash, size_t key_size){
+    uint64_t h = hash_sized(map, key, key_size);
+    *hash = h;
+    if(map->capacity == 0){
+        return -1;
+    }
+    size_t gmask = map->capacity / MAP_GROUP - 1;
+    size_t g = h & gmask;
+    byte h2 = h >> 57;
+    for(size_t step = 1; ; step ++){
+        const byte *ctrl = map->ctrl + g * MAP_GROUP;
+        for(unsigned m = group_match(ctrl, h2); m; m &= m - 1){
+            size_t i = g * MAP_GROUP + __builtin_ctz(m);
+            if(memcmp(slot(map, i), key, key_size) == 0){
+                return i;
+            }
+        }
+        if(group_empty(ctrl)){
+            return -1;
+        }
+        g = (g + step) & gmask;
+    }
+}
+
+/* returns the slot of a key or -1, and its hash in *hash for inserting */
+static inline __attribute__((always_inline))
+ssize_t find(const Map *map, const void *key, uint64_t *hash){
+    switch(map->key_size){
+    case 4:
+        return find_sized(map, key, hash, 4);
+    case 8:
+        return find_sized(map, key, hash, 8);
+    case 16:
+        return find_sized(map, key, hash, 16);
+    default:
+        return find_sized(map, key, hash, map->key_size);
+    }
+}
+
+/* the first empty or deleted slot on the probe sequence of h */
+static size_t find_free(const Map *map, uint64_t h){
+    size_t gmask = map->capacity / MAP_GROUP - 1;
+    size_t g = h & gmask;
+    for(size_t step = 1; ; step ++){
+        unsigned m = group_free(map->ctrl + g * MAP_GROUP);
+        if(m){
+            return g * MAP_GROUP + __builtin_ctz(m);
+        }
+        g = (g + step) & gmask;
+    }
+}
+
+/* moves every entry into a fresh arena of the given capacity, dropping tombstones */
+static void rehash(Map *map, size_t capacity){
+    Buffer *old = map->arena;
+    byte *old_ctrl = map->ctrl;
+    byte *old_slots = map->slots;
+    size_t old_capacity = map->capacity;
+
+    /* built by hand, buff_init takes an int and arenas may pass 2 GiB */
+    if(capacity > SIZE_MAX / (map->slot_size + 1)){
+        print(STDERR_FILENO, "Error: map capacity overflow\n");
+        exit(EXIT_FAILURE);
+    }
+    map->arena = sec_malloc(sizeof(Buffer));
+    map->arena->capacity = capacity + capacity * map->slot_size;
+    map->arena->size = map->arena->capacity;
+    map->arena->body = sec_malloc(map->arena->capacity);
+    if(map->arena->body == NULL){
+        print(STDERR_FILENO, "Error: cannot allocate a map of %zu slots\n", capacity);
+        exit(EXIT_FAILURE);
+    }
+    map->ctrl = map->arena->body;
+    map->slots = map->ctrl + capacity;
+    map->capacity = capacity;
+    memset(map->ctrl, EMPTY, capacity);
+
+    for(size_t i = 0; i < old_capacity; i ++){
+        if(old_ctrl[i] & 0x80){
+            continue;
+        }
+        const byte *entry = old_slots + i * map->slot_size;
+        uint64_t h = hash_key(map, entry);
+        size_t at = find_free(map, h);
+        map->ctrl[at] = h >> 57;
+        memcpy(slot(map, at), entry, map->slot_size);
+    }
+    map->growth_left = max_load(capacity) - map->size;
+    if(old != NULL){
+        buff_free(old);
+    }
+}
+
+/**
+ * Creates an empty map. Nothing is allocated for entries until the first
+ * insert or map_reserve.
+ *
+ * @param key_size The size of a key, keys are compared bytewise.
+ * @param value_size The size of a value, may be 0 for a set.
+ *
+ * @returns The map.
+ */
+Map *map_init(size_t key_size, size_t value_size){
+    if(key_size == 0){
+        print(STDERR_FILENO, "Error: map keys cannot be empty\n");
+        exit(EXIT_FAILURE);
+    }
+    Map *map = sec_malloc(sizeof(Map));
+    size_t align = value_size >= 8 ? 8 : (value_size >= 4 ? 4 : (value_size >= 2 ? 2 : 1));
+    map->arena = NULL;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->value_offset = (key_size + align - 1) / align * align;
+    map->slot_size = (map->value_offset + value_size + align - 1) / align * align;
+    map->capacity = 0;
+    map->size = 0;
+    map->growth_left = 0;
+    map->seed = mix((uintptr_t) map);
+    return map;
+}
+
+/**
+ * Frees a map and all its entries.
+ *
+ * @param map The map.
+ *
+ * @returns None
+ */
+void map_free(Map *map){
+    if(map->arena != NULL){
+        buff_free(map->arena);
+    }
+    sec_free(map);
+}
+
+/**
+ * Returns the number of entries in a map.
+ *
+ * @param map The map.
+ *
+ * @returns The number of entries.
+ */
+size_t map_size(Map *map){
+    return map->size;
+}
+
+/**
+ * Looks up a key.
+ *
+ * @param map The map.
+ * @param key The key, key_size bytes.
+ *
+ * @returns A pointer to the value stored inline, valid until the map is
+ *          next modified, or NULL if the key is absent.
+ */
+void *map_get(Map *map, const void *key){
+    uint64_t h;
+    ssize_t i = find(map, key, &h);
+    return i < 0 ? NULL : slot(map, i) + map->value_offset;
+}
+
+/**
+ * Inserts a key or replaces its value.
+ *
+ * @param map The map.
+ * @param key The key, key_size bytes.
+ * @param value The value, value_size bytes, or NULL to leave an existing
+ *              value as is and zero a new one.
+ *
+ * @returns A pointer to the value stored inline, valid until the map is
+ *          next modified.
+ */
+void *map_put(Map *map, const void *key, const void *value){
+    uint64_t h;
+    ssize_t found = find(map, key, &h);
+    byte *entry;
+    if(found >= 0){
+        entry = slot(map, found);
+        if(value != NULL){
+            memcpy(entry + map->value_offset, value, map->value_size);
+        }
+        return entry + map->value_offset;
+    }
+
+    size_t i = map->capacity ? find_free(map, h) : 0;
+    if(map->capacity == 0 || (map->growth_left == 0 && map->ctrl[i] == EMPTY)){
+        /* mostly tombstones: clean up in place, otherwise double */
+        if(map->capacity > MAP_GROUP && map->size * 32 <= map->capacity * 25){
+            rehash(map, map->capacity);
+        }else{
+            rehash(map, map->capacity ? map->capacity * 2 : MAP_GROUP);
+        }
+        i = find_free(map, h);
+    }
+    if(map->ctrl[i] == EMPTY){
+        map->growth_left --;
+    }
+    map->ctrl[i] = h >> 57;
+    map->size ++;
+    entry = slot(map, i);
+    memcpy(entry, key, map->key_size);
+    if(value != NULL){
+        memcpy(entry + map->value_offset, value, map->value_size);
+    }else{
+        memset(entry + map->value_offset, 0, map->value_size);
+    }
+    return entry + map->value_offset;
+}
+
+/**
+ * Removes a key.
+ *
+ * @param map The map.
+ * @param key The key.
+ *
+ * @returns 1 if the key was removed, 0 if it was absent.
+ */
+int map_erase(Map *map, const void *key){
+    uint64_t h;
+    ssize_t i = find(map, key, &h);
+    if(i < 0){
+        return 0;
+    }
+    if(group_empty(map->ctrl + i / MAP_GROUP * MAP_GROUP)){
+        map->ctrl[i] = EMPTY;
+        map->growth_left ++;
+    }else{
+        map->ctrl[i] = DELETED;
+    }
+    map->size --;
+    return 1;
+}
+
+/**
+ * Makes room for a number of entries, so that inserting up to that many
+ * does not rehash.
+ *
+ * @param map The map.
+ * @param count The number of entries.
+ *
+ * @returns None
+ */
+void map_reserve(Map *map, size_t count){
+    size_t capacity = MAP_GROUP;
+    while(max_load(capacity) < count){
+        if(capacity > SIZE_MAX / 2){
+            print(STDERR_FILENO, "Error: map capacity overflow\n");
+            exit(EXIT_FAILURE);
+        }
+        capacity *= 2;
+    }
+    if(capacity > map->capacity){
+        rehash(map, capacity);
+    }
+}
+
+/**
+ * Removes all entries, keeping the storage.
+ *
+ * @param map The map.
+ *
+ * @returns None
+ */
+void map_clear(Map *map){
+    if(map->capacity > 0){
+        memset(map->ctrl, EMPTY, map->capacity);
+    }
+    map->size = 0;
+    map->growth_left = max_load(map->capacity);
+}
+
+/**
+ * Iterates over the entries in storage order. Start with *iter = 0; the map
+ * must not be modified during the iteration, except through the value
+ * pointers.
+ *
+ * @param map The map.
+ * @param iter The iteration position.
+ * @param key Receives a pointer to the key, may be NULL.
+ * @param value Receives a pointer to the value, may be NULL.
+ *
+ * @returns 1 if an entry was returned, 0 at the end.
+ */
+int map_next(Map *map, size_t *iter, void **key, void **value){
+    while(*iter < map->capacity){
+        size_t g = *iter / MAP_GROUP * MAP_GROUP;
+        unsigned full = ~group_free(map->ctrl + g) & (0xffffu << (*iter - g)) & 0xffffu;
+        if(full == 0){
+            *iter = g + MAP_GROUP;
+            continue;
+        }
+        size_t i = g + __builtin_ctz(full);
+        *iter = i + 1;
+        if(key != NULL){
+            *key = slot(map, i);
+        }
+        if(value != NULL){
+            *value = slot(map, i) + map->value_offset;
+        }
+        return 1;
+    }
+    return 0;
+}
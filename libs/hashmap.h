@@ -0,0 +1,54 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+#define MAP_GROUP 16
+
+/**
+ * An open addressing hash map with fixed size keys and values, in the
+ * style of SwissTable: one control byte per slot (empty, deleted, or 7 bits
+ * of the hash) scanned 16 at a time, and the entries stored inline.
+ *
+ * @param arena The storage: capacity control bytes, then capacity slots.
+ * @param ctrl The control bytes, inside arena.
+ * @param slots The slots, each a key followed by its value, inside arena.
+ * @param key_size The size of a key.
+ * @param value_size The size of a value.
+ * @param value_offset The offset of the value in a slot.
+ * @param slot_size The size of a slot.
+ * @param capacity The number of slots, a power of two and a multiple of
+ *                 MAP_GROUP, or 0.
+ * @param size The number of entries.
+ * @param growth_left How many more entries fit in empty slots before the
+ *                    map grows.
+ * @param seed The hash seed.
+ */
+struct map {
+    Buffer *arena;
+    byte *ctrl;
+    byte *slots;
+    size_t key_size;
+    size_t value_size;
+    size_t value_offset;
+    size_t slot_size;
+    size_t capacity;
+    size_t size;
+    size_t growth_left;
+    uint64_t seed;
+};
+typedef struct map Map;
+
+/* function prototypes */
+Map *map_init(size_t key_size, size_t value_size);
+void map_free(Map *map);
+size_t map_size(Map *map);
+void *map_get(Map *map, const void *key);
+void *map_put(Map *map, const void *key, const void *value);
+int map_erase(Map *map, const void *key);
+void map_reserve(Map *map, size_t count);
+void map_clear(Map *map);
+int map_next(Map *map, size_t *iter, void **key, void **value);
+
+#endif
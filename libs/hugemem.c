@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include "hugemem.h"
+#include "buffer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/*
+ * Large blocks get their own mapping, aligned to and sized in whole huge
+ * pages so the kernel can back all of it with 2 MiB pages, which cuts the
+ * TLB misses of scans over it. With HUGEMEM_HUGETLB, pages are first taken
+ * from the reserved hugetlbfs pool, which only works when the
+ * administrator set vm.nr_hugepages; otherwise, and on failure, the
+ * mapping is advised MADV_HUGEPAGE for transparent huge pages. Growing a
+ * block moves its page tables with mremap instead of copying the data.
+ * Blocks are kept in a short list, and only pointers aligned to a huge
+ * page are looked up in it, so freeing other memory costs one test. The
+ * list is grown with libc realloc: sec_realloc asks hugemem_tier about
+ * the old storage, which takes the lock already held while growing.
+ */
+
+/**
+ * A block handed out.
+ *
+ * @param ptr The start of the mapping, and of the block.
+ * @param map_size The size of the mapping, a multiple of HUGEMEM_PAGE.
+ * @param tier A HUGEMEM_TIER_* value.
+ */
+struct huge_block {
+    byte *ptr;
+    size_t map_size;
+    int tier;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct huge_block *blocks;
+static size_t block_count;
+static size_t block_capacity;
+static _Atomic size_t threshold = HUGEMEM_THRESHOLD;
+static _Atomic int config_flags;
+
+static inline size_t round_huge(size_t size){
+    return (size + HUGEMEM_PAGE - 1) & ~(HUGEMEM_PAGE - 1);
+}
+
+/* the list entry of a block, called with the lock held */
+static struct huge_block *find(const void *ptr){
+    for(size_t i = 0; i < block_count; i ++){
+        if(blocks[i].ptr == ptr){
+            return &blocks[i];
+        }
+    }
+    return NULL;
+}
+
+/* appends a block to the list, called with the lock held */
+static int add(struct huge_block block){
+    if(block_count == block_capacity){
+        size_t capacity = block_capacity ? block_capacity * 2 : 8;
+        struct huge_block *grown = realloc(blocks, capacity * sizeof(struct huge_block));
+        if(grown == NULL){
+            return -1;
+        }
+        blocks = grown;
+        block_capacity = capacity;
+    }
+    blocks[block_count ++] = block;
+    return 0;
+}
+
+/* maps size bytes starting at a huge page boundary */
+static byte *map_aligned(size_t size){
+    byte *raw = mmap(NULL, size + HUGEMEM_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED){
+        return NULL;
+    }
+    byte *aligned = (byte *) (((uintptr_t) raw + HUGEMEM_PAGE - 1) & ~(HUGEMEM_PAGE - 1));
+    if(aligned > raw){
+        munmap(raw, aligned - raw);
+    }
+    if(raw + HUGEMEM_PAGE > aligned){
+        munmap(aligned + size, raw + HUGEMEM_PAGE - aligned);
+    }
+    return aligned;
+}
+
+/**
+ * Sets which allocations the huge page tier serves. Blocks already handed
+ * out are not affected.
+ *
+ * @param size Allocations from this size up are served, 0 turns the tier
+ *             off. Sizes under HUGEMEM_PAGE are raised to it.
+ * @param flags HUGEMEM_HUGETLB to try reserved huge pages first.
+ *
+ * @returns None
+ */
+void hugemem_config(size_t size, int flags){
+    atomic_store(&threshold, size == 0 ? SIZE_MAX : size < HUGEMEM_PAGE ? HUGEMEM_PAGE : size);
+    atomic_store(&config_flags, flags);
+}
+
+/**
+ * Allocates a block backed by huge pages if it is large enough.
+ *
+ * @param size The size of the block.
+ *
+ * @returns The block, zeroed and aligned to HUGEMEM_PAGE, or NULL if size
+ *          is under the threshold or the mapping failed, in which case the
+ *          caller falls back to libc.
+ */
+void *hugemem_alloc(size_t size){
+    if(size < atomic_load_explicit(&threshold, memory_order_relaxed)){
+        return NULL;
+    }
+    return hugemem_map(size);
+}
+
+/**
+ * Allocates a block with a mapping of its own whatever its size, for
+ * callers that set a memory policy on the whole block. It is freed with
+ * sec_free like any other block.
+ *
+ * @param size The size of the block, rounded up to whole huge pages.
+ *
+ * @returns The block, zeroed and aligned to HUGEMEM_PAGE, or NULL if the
+ *          mapping failed.
+ */
+void *hugemem_map(size_t size){
+    if(size == 0 || size > SIZE_MAX / 2){
+        return NULL;
+    }
+    struct huge_block block;
+    block.map_size = round_huge(size);
+    block.ptr = NULL;
+    if(atomic_load_explicit(&config_flags, memory_order_relaxed) & HUGEMEM_HUGETLB){
+        block.ptr = mmap(NULL, block.map_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        block.ptr = block.ptr == MAP_FAILED ? NULL : block.ptr;
+        block.tier = HUGEMEM_TIER_HUGETLB;
+    }
+    if(block.ptr == NULL){
+        if((block.ptr = map_aligned(block.map_size)) == NULL){
+            return NULL;
+        }
+        block.tier = madvise(block.ptr, block.map_size, MADV_HUGEPAGE) == 0 ? HUGEMEM_TIER_THP : HUGEMEM_TIER_MAP;
+    }
+    pthread_mutex_lock(&lock);
+    int added = add(block);
+    pthread_mutex_unlock(&lock);
+    if(added == -1){
+        munmap(block.ptr, block.map_size);
+        return NULL;
+    }
+    return block.ptr;
+}
+
+/**
+ * Resizes a huge memory block without copying: the mapping is extended or
+ * cut in place, or its pages are moved to a new aligned address.
+ *
+ * @param ptr A block from hugemem_alloc.
+ * @param size The new size, contents up to the smaller of the sizes are
+ *             kept and any growth is zeroed.
+ *
+ * @returns The block, moved or not, or NULL if it could not be resized
+ *          this way, in which case it is left unchanged and the caller
+ *          copies it.
+ */
+void *hugemem_resize(void *ptr, size_t size){
+    if(size < atomic_load_explicit(&threshold, memory_order_relaxed) || size > SIZE_MAX / 2){
+        return NULL;
+    }
+    size_t map_size = round_huge(size);
+    pthread_mutex_lock(&lock);
+    struct huge_block *block = find(ptr);
+    byte *moved = NULL;
+    if(block != NULL && block->tier != HUGEMEM_TIER_HUGETLB){
+        if(map_size <= block->map_size){
+            if(map_size < block->map_size){
+                munmap(block->ptr + map_size, block->map_size - map_size);
+            }
+            moved = block->ptr;
+        }else if(mremap(block->ptr, block->map_size, map_size, 0) != MAP_FAILED){
+            moved = block->ptr;
+        }else{
+            byte *target = map_aligned(map_size);
+            if(target != NULL){
+                moved = mremap(block->ptr, block->map_size, map_size, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+                if(moved == MAP_FAILED){
+                    munmap(target, map_size);
+                    moved = NULL;
+                }
+            }
+        }
+        if(moved != NULL){
+            block->ptr = moved;
+            block->map_size = map_size;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return moved;
+}
+
+/**
+ * Frees a block if it came from hugemem_alloc, returning its pages to the
+ * system.
+ *
+ * @param ptr The block, may be NULL or come from elsewhere.
+ *
+ * @returns 1 if the block was freed, 0 if it is not a huge memory block.
+ */
+int hugemem_free(void *ptr){
+    if(ptr == NULL || ((uintptr_t) ptr & (HUGEMEM_PAGE - 1)) != 0){
+        return 0;
+    }
+    pthread_mutex_lock(&lock);
+    struct huge_block *block = find(ptr);
+    if(block == NULL){
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    size_t map_size = block->map_size;
+    *block = blocks[-- block_count];
+    pthread_mutex_unlock(&lock);
+    munmap(ptr, map_size);
+    return 1;
+}
+
+/**
+ * Tells how a block is backed.
+ *
+ * @param ptr The block.
+ *
+ * @returns A HUGEMEM_TIER_* value, HUGEMEM_TIER_NONE if it is not a huge
+ *          memory block.
+ */
+int hugemem_tier(const void *ptr){
+    if(ptr == NULL || ((uintptr_t) ptr & (HUGEMEM_PAGE - 1)) != 0){
+        return HUGEMEM_TIER_NONE;
+    }
+    pthread_mutex_lock(&lock);
+    struct huge_block *block = find(ptr);
+    int tier = block ? block->tier : HUGEMEM_TIER_NONE;
+    pthread_mutex_unlock(&lock);
+    return tier;
+}
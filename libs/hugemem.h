@@ -0,0 +1,28 @@
+#ifndef HUGEMEM_H
+#define HUGEMEM_H
+
+#include <stddef.h>
+
+/* the huge page size, and the alignment of every block */
+#define HUGEMEM_PAGE ((size_t) 2 << 20)
+/* blocks from this size up get huge pages unless configured otherwise */
+#define HUGEMEM_THRESHOLD ((size_t) 4 << 20)
+
+/* hugemem_config flags */
+#define HUGEMEM_HUGETLB 0x01 /* try reserved huge pages before THP */
+
+/* tiers, how a block is backed */
+#define HUGEMEM_TIER_NONE 0    /* not a huge memory block */
+#define HUGEMEM_TIER_MAP 1     /* aligned, but the kernel refused THP */
+#define HUGEMEM_TIER_THP 2     /* transparent huge pages requested */
+#define HUGEMEM_TIER_HUGETLB 3 /* reserved huge pages */
+
+/* function prototypes */
+void hugemem_config(size_t threshold, int flags);
+void *hugemem_alloc(size_t size);
+void *hugemem_map(size_t size);
+void *hugemem_resize(void *ptr, size_t size);
+int hugemem_free(void *ptr);
+int hugemem_tier(const void *ptr);
+
+#endif
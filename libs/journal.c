@@ -0,0 +1,246 @@
+#define _GNU_SOURCE
+#include "journal.h"
+#include "checksum.h"
+#include "reader.h"
+
+#include <limits.h>
+#include <sys/uio.h>
+
+/*
+ * A journal file is a sequence of records, each an 8 byte header (the
+ * CRC-32C of the length field and the payload, then the length, both
+ * little endian) followed by the payload. The file may end with a torn
+ * record from a crash during a commit, or with zeros from preallocated
+ * space, which never checksum correctly; opening the journal cuts the
+ * file after the last intact record.
+ */
+
+/* the reader refuses longer records, so appends do too */
+#define MAX_RECORD ((size_t) 1 << 30)
+
+VEC_DEFINE(IovVec, struct iovec)
+
+static inline uint32_t read32le(const byte *p){
+    return (uint32_t) p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void write32le(byte *p, uint32_t v){
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+/* the CRC of a record, the header's length field included */
+static uint32_t record_crc(const void *data, size_t size){
+    byte len[4];
+    write32le(len, size);
+    return cksum_crc32c(cksum_crc32c(0, len, 4), data, size);
+}
+
+/* the offset just past the last intact record, replaying each one */
+static uint64_t recover(int fd, journal_fn replay, void *ctx){
+    Reader *reader = reader_open(fd, 0);
+    uint64_t end = 0;
+    BuffView header, record;
+    while(reader_fixed(reader, 4, &header) == 1){
+        uint32_t crc = read32le(header.ptr);
+        if(reader_prefixed(reader, 4, LITTLE_ENDIAN, &record) != 1
+           || record_crc(record.ptr, record.len) != crc){
+            break;
+        }
+        if(replay != NULL){
+            replay(ctx, record);
+        }
+        end += 8 + record.len;
+    }
+    reader_free(reader);
+    return end;
+}
+
+/*
+ * Makes sure the file has room up to end. Writes into preallocated space
+ * do not change the file size, so the fdatasync of a commit has no
+ * metadata to flush besides, on some file systems, marking the blocks
+ * written.
+ */
+static void reserve_space(Journal *journal, uint64_t end){
+    if(journal->prealloc == 0 || end <= journal->allocated){
+        return;
+    }
+    size_t grow = end - journal->allocated;
+    grow = grow > journal->prealloc ? grow : journal->prealloc;
+    if(fallocate(journal->fd, 0, journal->allocated, grow) == -1){
+        if(errno != EOPNOTSUPP){
+            print_err_exit("fallocate", errno);
+        }
+        journal->prealloc = 0;
+        return;
+    }
+    journal->allocated += grow;
+}
+
+/* writes a batch of records from offset, however the kernel splits it */
+static void write_batch(Journal *journal, JournalBatch *batch, uint64_t offset){
+    IovVec iovs;
+    IovVec_init(&iovs, batch->size * 2);
+    for(size_t i = 0; i < batch->size; i ++){
+        struct journal_record *record = JournalBatch_at(batch, i);
+        IovVec_push(&iovs, (struct iovec) { record->header, 8 });
+        if(record->size > 0){
+            IovVec_push(&iovs, (struct iovec) { (void *) record->data, record->size });
+        }
+    }
+    struct iovec *iov = iovs.data;
+    size_t left = iovs.size;
+    while(left > 0){
+        ssize_t n = pwritev(journal->fd, iov, left < IOV_MAX ? left : IOV_MAX, offset);
+        if(n == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            print_err_exit("pwritev", errno);
+        }
+        offset += n;
+        while(left > 0 && (size_t) n >= iov->iov_len){
+            n -= iov->iov_len;
+            iov ++;
+            left --;
+        }
+        if(n > 0){
+            iov->iov_base = (byte *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    IovVec_free(&iovs);
+}
+
+/* writes and syncs everything queued, called and returning with the lock held */
+static void commit(Journal *journal){
+    JournalBatch batch = journal->queued;
+    journal->queued = journal->writing;
+    journal->writing = batch;
+    journal->committing = 1;
+    uint64_t start = journal->durable;
+    uint64_t end = journal->end;
+    pthread_mutex_unlock(&journal->lock);
+
+    reserve_space(journal, end);
+    write_batch(journal, &journal->writing, start);
+    if(fdatasync(journal->fd) == -1){
+        print_err_exit("fdatasync", errno);
+    }
+
+    pthread_mutex_lock(&journal->lock);
+    JournalBatch_clear(&journal->writing);
+    journal->durable = end;
+    journal->committing = 0;
+    journal->commits ++;
+    pthread_cond_broadcast(&journal->done);
+}
+
+/**
+ * Opens a journal, creating it if needed. The records already in it are
+ * checked and replayed in order, and anything after the last intact one,
+ * a torn record from a crash, is cut off.
+ *
+ * @param path The journal file.
+ * @param replay Called with each existing record, may be NULL.
+ * @param ctx Passed to replay.
+ *
+ * @returns The journal, positioned for appends after the last record.
+ */
+Journal *journal_open(const char *path, journal_fn replay, void *ctx){
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd == -1){
+        print_err_exit("open", errno);
+    }
+    uint64_t end = recover(fd, replay, ctx);
+    struct stat st;
+    sys_fstat(fd, &st);
+    if((uint64_t) st.st_size != end){
+        if(ftruncate(fd, end) == -1){
+            print_err_exit("ftruncate", errno);
+        }
+        if(fdatasync(fd) == -1){
+            print_err_exit("fdatasync", errno);
+        }
+    }
+
+    Journal *journal = sec_malloc(sizeof(Journal));
+    journal->fd = fd;
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_cond_init(&journal->done, NULL);
+    JournalBatch_init(&journal->queued, 0);
+    JournalBatch_init(&journal->writing, 0);
+    journal->committing = 0;
+    journal->end = end;
+    journal->durable = end;
+    journal->allocated = end;
+    journal->prealloc = JOURNAL_PREALLOC;
+    journal->commits = 0;
+    return journal;
+}
+
+/**
+ * Appends a record and waits until it is on disk. Threads appending at
+ * the same time share a commit, so the cost of the sync is spread over
+ * all of them.
+ *
+ * @param journal The journal.
+ * @param data The payload, it must stay unchanged until the call returns.
+ * @param size The payload size, at most 1 GiB.
+ *
+ * @returns The offset of the record in the file.
+ */
+uint64_t journal_append(Journal *journal, const void *data, size_t size){
+    if(size > MAX_RECORD){
+        print(STDERR_FILENO, "Error: journal record too large\n");
+        exit(EXIT_FAILURE);
+    }
+    struct journal_record record;
+    write32le(record.header, record_crc(data, size));
+    write32le(record.header + 4, size);
+    record.data = data;
+    record.size = size;
+
+    pthread_mutex_lock(&journal->lock);
+    uint64_t offset = journal->end;
+    journal->end += 8 + size;
+    uint64_t end = journal->end;
+    JournalBatch_push(&journal->queued, record);
+    while(journal->durable < end){
+        if(!journal->committing){
+            commit(journal);
+        }else{
+            pthread_cond_wait(&journal->done, &journal->lock);
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return offset;
+}
+
+/**
+ * Closes a journal, giving back the preallocated space past the last
+ * record. No appends may be in progress.
+ *
+ * @param journal The journal.
+ *
+ * @returns None
+ */
+void journal_close(Journal *journal){
+    if(journal->allocated > journal->end){
+        if(ftruncate(journal->fd, journal->end) == -1){
+            print_err_exit("ftruncate", errno);
+        }
+        if(fdatasync(journal->fd) == -1){
+            print_err_exit("fdatasync", errno);
+        }
+    }
+    sys_close(journal->fd);
+    JournalBatch_free(&journal->queued);
+    JournalBatch_free(&journal->writing);
+    pthread_cond_destroy(&journal->done);
+    pthread_mutex_destroy(&journal->lock);
+    sec_free(journal);
+}
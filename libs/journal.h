@@ -0,0 +1,71 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "buffer.h"
+#include "vec.h"
+
+/* file space is preallocated this much at a time */
+#define JOURNAL_PREALLOC ((size_t) 16 * 1024 * 1024)
+
+/**
+ * A record waiting to be written: its frame header, then the caller's
+ * bytes, which stay valid because the caller waits until they are durable.
+ *
+ * @param header The CRC-32C of the length and payload, then the length,
+ *               both little endian.
+ * @param data The payload.
+ * @param size The payload size.
+ */
+struct journal_record {
+    byte header[8];
+    const void *data;
+    size_t size;
+};
+
+VEC_DEFINE(JournalBatch, struct journal_record)
+
+/**
+ * An append-only file of checksummed records. Appends from many threads
+ * are committed together: whichever thread finds no write in progress
+ * writes everything queued so far with one pwritev and one fdatasync, and
+ * the others wait for it.
+ *
+ * @param fd The file.
+ * @param lock Protects the fields below.
+ * @param done Signalled after every commit.
+ * @param queued Records appended since the last commit started.
+ * @param writing The records of the commit in progress.
+ * @param committing Nonzero while a thread is writing.
+ * @param end The offset just past the last appended record.
+ * @param durable The offset up to which records are on disk.
+ * @param allocated The size of the file including preallocated space.
+ * @param prealloc How much space to preallocate at a time, 0 if the file
+ *                 system does not support it.
+ * @param commits The number of commits so far.
+ */
+struct journal {
+    int fd;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    JournalBatch queued;
+    JournalBatch writing;
+    int committing;
+    uint64_t end;
+    uint64_t durable;
+    uint64_t allocated;
+    size_t prealloc;
+    uint64_t commits;
+};
+typedef struct journal Journal;
+
+/* called with each record found when a journal is opened */
+typedef void (*journal_fn)(void *ctx, BuffView record);
+
+/* function prototypes */
+Journal *journal_open(const char *path, journal_fn replay, void *ctx);
+uint64_t journal_append(Journal *journal, const void *data, size_t size);
+void journal_close(Journal *journal);
+
+#endif
@@ -0,0 +1,584 @@
+#include "lz.h"
+#include "checksum.h"
+
+/*
+ * Block format (the LZ4 block layout): a sequence of
+ *   token        high nibble literal count, low nibble match length - 4,
+ *                15 meaning "continued in following bytes"
+ *   [count...]   255-continued extra literal count
+ *   literals
+ *   offset       2 bytes little endian, 1 to 65535 back into the output
+ *   [length...]  255-continued extra match length
+ * The last sequence carries literals only. Matches start at least
+ * MFLIMIT bytes before the end and the last LAST_LITERALS bytes are
+ * always literals, which leaves the decoder room for its wide copies.
+ *
+ * Frame format:
+ *   magic "LZB1", flags byte, block size u32
+ *   per block: u32 size, high bit set for a stored (uncompressed) block,
+ *              data, [u32 CRC-32C of size and data if LZ_BLOCK_CHECKSUM]
+ *   u32 0, [u32 CRC-32C of the content if LZ_CONTENT_CHECKSUM]
+ * All integers little endian.
+ */
+#define MAGIC "LZB1"
+#define HEADER_SIZE 9
+#define STORED 0x80000000u
+
+#define MIN_MATCH 4
+#define MFLIMIT 12
+#define LAST_LITERALS 5
+#define MAX_OFFSET 65535
+#define HASH_LOG 12
+/* after 2^SKIP_TRIGGER misses the search step grows by one */
+#define SKIP_TRIGGER 6
+/* the decoder writes up to this many bytes past a copy when it can */
+#define WILD 32
+
+enum { READ_HEADER, READ_BLOCK, READ_TRAILER, READ_DONE };
+
+static inline uint32_t read32(const byte *p){
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint16_t read16le(const byte *p){
+    return p[0] | p[1] << 8;
+}
+
+static inline uint32_t read32le(const byte *p){
+    return (uint32_t) p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void write32le(byte *p, uint32_t v){
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline uint32_t hash4(const byte *p){
+    return (read32(p) * 2654435761u) >> (32 - HASH_LOG);
+}
+
+/* the number of equal bytes at a and b, b not reaching limit */
+static inline size_t match_length(const byte *a, const byte *b, const byte *limit){
+    const byte *start = b;
+    while(limit - b >= 8){
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        if(x != y){
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return b - start + (__builtin_ctzll(x ^ y) >> 3);
+#else
+            return b - start + (__builtin_clzll(x ^ y) >> 3);
+#endif
+        }
+        a += 8;
+        b += 8;
+    }
+    while(b < limit && *a == *b){
+        a ++;
+        b ++;
+    }
+    return b - start;
+}
+
+static inline byte *put_length(byte *op, size_t len){
+    for(; len >= 255; len -= 255){
+        *op ++ = 255;
+    }
+    *op ++ = len;
+    return op;
+}
+
+static byte *put_sequence(byte *op, const byte *literals, size_t lit, size_t offset, size_t len){
+    byte *token = op ++;
+    *token = (lit >= 15 ? 15 : lit) << 4;
+    if(lit >= 15){
+        op = put_length(op, lit - 15);
+    }
+    memcpy(op, literals, lit);
+    op += lit;
+    if(len == 0){
+        return op;
+    }
+    *op ++ = offset;
+    *op ++ = offset >> 8;
+    len -= MIN_MATCH;
+    *token |= len >= 15 ? 15 : len;
+    if(len >= 15){
+        op = put_length(op, len - 15);
+    }
+    return op;
+}
+
+/* greedy single-probe match finder, skipping faster through incompressible data */
+static size_t compress_block(byte *dst, const byte *src, size_t n, uint32_t *table){
+    byte *op = dst;
+    const byte *anchor = src;
+    if(n >= MFLIMIT + 1){
+        const byte *ip = src + 1;
+        const byte *mflimit = src + n - MFLIMIT;
+        const byte *matchlimit = src + n - LAST_LITERALS;
+        memset(table, 0, sizeof(uint32_t) << HASH_LOG);
+        for(;;){
+            const byte *ref;
+            unsigned misses = 1 << SKIP_TRIGGER;
+            for(;;){
+                uint32_t h = hash4(ip);
+                ref = src + table[h];
+                table[h] = ip - src;
+                if(ip - ref <= MAX_OFFSET && read32(ref) == read32(ip) && ref < ip){
+                    break;
+                }
+                ip += misses ++ >> SKIP_TRIGGER;
+                if(ip > mflimit){
+                    goto last;
+                }
+            }
+            while(ip > anchor && ref > src && ip[-1] == ref[-1]){
+                ip --;
+                ref --;
+            }
+            size_t len = MIN_MATCH + match_length(ref + MIN_MATCH, ip + MIN_MATCH, matchlimit);
+            op = put_sequence(op, anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+            if(ip > mflimit){
+                break;
+            }
+            table[hash4(ip - 2)] = ip - 2 - src;
+        }
+    }
+last:
+    return put_sequence(op, anchor, src + n - anchor, 0, 0) - dst;
+}
+
+/**
+ * Returns the largest size a block of size bytes can compress to.
+ *
+ * @param size The uncompressed size.
+ *
+ * @returns The bound.
+ */
+size_t lz_bound(size_t size){
+    return size + size / 255 + 16;
+}
+
+/**
+ * Compresses a block, without framing.
+ *
+ * @param dst Receives the compressed block, at least lz_bound(size) bytes.
+ * @param src The data.
+ * @param size The number of bytes in src.
+ *
+ * @returns The compressed size.
+ */
+size_t lz_compress_block(void *dst, const void *src, size_t size){
+    uint32_t table[1 << HASH_LOG];
+    return compress_block(dst, src, size, table);
+}
+
+/*
+ * The decoder loop. Copies go 16 (or 8) bytes at a time, which may write
+ * up to olimit; olimit is oend for caller memory and oend + WILD inside
+ * Buffers, where the slack is reserved.
+ */
+static inline ssize_t decode(byte *out, byte *oend, byte *olimit, const byte *ip, size_t size){
+    const byte *iend = ip + size;
+    byte *op = out;
+    while(ip < iend){
+        unsigned token = *ip ++;
+        size_t lit = token >> 4;
+        if(lit < 15 && iend - ip >= 18 && olimit - op >= 16){
+            /* short literal run with a match after it: one fixed copy */
+            if(lit > (size_t) (oend - op)){
+                return -1;
+            }
+            memcpy(op, ip, 16);
+            ip += lit;
+            op += lit;
+        }else{
+            if(lit == 15){
+                byte b;
+                do{
+                    if(ip >= iend){
+                        return -1;
+                    }
+                    b = *ip ++;
+                    lit += b;
+                }while(b == 255);
+            }
+            if(lit > (size_t) (iend - ip) || lit > (size_t) (oend - op)){
+                return -1;
+            }
+            if(lit + 16 <= (size_t) (iend - ip) && lit + 16 <= (size_t) (olimit - op)){
+                for(size_t i = 0; i < lit; i += 16){
+                    memcpy(op + i, ip + i, 16);
+                }
+            }else{
+                memcpy(op, ip, lit);
+            }
+            ip += lit;
+            op += lit;
+            if(ip == iend){
+                break;
+            }
+            if(iend - ip < 2){
+                return -1;
+            }
+        }
+
+        size_t offset = read16le(ip);
+        ip += 2;
+        if(offset == 0 || offset > (size_t) (op - out)){
+            return -1;
+        }
+        const byte *match = op - offset;
+        size_t len = token & 15;
+        if(len < 15 && offset >= 8 && olimit - op >= 18){
+            /* short match: at most 18 bytes, in chunks that never overlap what they read */
+            if(len + MIN_MATCH > (size_t) (oend - op)){
+                return -1;
+            }
+            memcpy(op, match, 8);
+            memcpy(op + 8, match + 8, 8);
+            memcpy(op + 16, match + 16, 2);
+            op += len + MIN_MATCH;
+            continue;
+        }
+        if(len == 15){
+            byte b;
+            do{
+                if(ip >= iend){
+                    return -1;
+                }
+                b = *ip ++;
+                len += b;
+            }while(b == 255);
+        }
+        len += MIN_MATCH;
+        if(len > (size_t) (oend - op)){
+            return -1;
+        }
+        if(offset >= 16 && len + 16 <= (size_t) (olimit - op)){
+            for(size_t i = 0; i < len; i += 16){
+                memcpy(op + i, match + i, 16);
+            }
+        }else if(offset >= 8 && len + 8 <= (size_t) (olimit - op)){
+            for(size_t i = 0; i < len; i += 8){
+                memcpy(op + i, match + i, 8);
+            }
+        }else{
+            for(size_t i = 0; i < len; i ++){
+                op[i] = match[i];
+            }
+        }
+        op += len;
+    }
+    return op - out;
+}
+
+/**
+ * Decompresses a block, without framing. Corrupt input is detected, it
+ * never makes the decoder read or write out of bounds.
+ *
+ * @param dst Receives the data.
+ * @param capacity The size of dst.
+ * @param src The compressed block.
+ * @param size The number of bytes in src.
+ *
+ * @returns The decompressed size, -1 if the block is corrupt or does not
+ *          fit in capacity.
+ */
+ssize_t lz_decompress_block(void *dst, size_t capacity, const void *src, size_t size){
+    byte *out = dst;
+    return decode(out, out + capacity, out + capacity, src, size);
+}
+
+/* appends a compressed or stored block and its checksum to the frame */
+static void put_block(LzWriter *writer, const byte *data, size_t size){
+    Buffer *dst = writer->dst;
+    buff_reserve(dst, 4 + lz_bound(size) + 4);
+    byte *header = (byte *) dst->body + dst->size;
+    byte *body = header + 4;
+    size_t packed = compress_block(body, data, size, writer->table);
+    uint32_t word = packed;
+    if(packed >= size){
+        memcpy(body, data, size);
+        packed = size;
+        word = size | STORED;
+    }
+    write32le(header, word);
+    dst->size += 4 + packed;
+    if(writer->flags & LZ_BLOCK_CHECKSUM){
+        write32le((byte *) dst->body + dst->size, cksum_crc32c(0, header, 4 + packed));
+        dst->size += 4;
+    }
+    if(writer->flags & LZ_CONTENT_CHECKSUM){
+        writer->crc = cksum_crc32c(writer->crc, data, size);
+    }
+}
+
+/**
+ * Starts a compressed frame.
+ *
+ * @param dst The buffer the frame is appended to.
+ * @param block_size The uncompressed size of a block, 0 for
+ *                   LZ_DEFAULT_BLOCK. Larger blocks compress slightly
+ *                   better, matches never reach back more than 64 KiB.
+ * @param flags LZ_BLOCK_CHECKSUM and/or LZ_CONTENT_CHECKSUM, or 0.
+ *
+ * @returns The writer.
+ */
+LzWriter *lz_writer_open(Buffer *dst, size_t block_size, int flags){
+    if(block_size == 0){
+        block_size = LZ_DEFAULT_BLOCK;
+    }
+    if(block_size > LZ_MAX_BLOCK){
+        print(STDERR_FILENO, "Error: lz block size %zu above %zu\n", block_size, LZ_MAX_BLOCK);
+        exit(EXIT_FAILURE);
+    }
+    LzWriter *writer = sec_malloc(sizeof(LzWriter));
+    writer->dst = dst;
+    writer->pending = buff_init(block_size);
+    writer->table = sec_malloc(sizeof(uint32_t) << HASH_LOG);
+    writer->block_size = block_size;
+    writer->flags = flags;
+    writer->crc = 0;
+
+    byte header[HEADER_SIZE];
+    memcpy(header, MAGIC, 4);
+    header[4] = flags;
+    write32le(header + 5, block_size);
+    buff_append(dst, header, HEADER_SIZE);
+    return writer;
+}
+
+/**
+ * Adds data to a frame. Full blocks are compressed right away, straight
+ * from data when nothing is pending.
+ *
+ * @param writer The writer.
+ * @param data The data.
+ * @param size The number of bytes in data.
+ *
+ * @returns None
+ */
+void lz_writer_write(LzWriter *writer, const void *data, size_t size){
+    const byte *p = data;
+    Buffer *pending = writer->pending;
+    if(pending->size > 0){
+        size_t take = writer->block_size - pending->size;
+        take = take < size ? take : size;
+        buff_append(pending, (void *) p, take);
+        p += take;
+        size -= take;
+        if(pending->size < writer->block_size){
+            return;
+        }
+        put_block(writer, pending->body, pending->size);
+        pending->size = 0;
+    }
+    for(; size >= writer->block_size; p += writer->block_size, size -= writer->block_size){
+        put_block(writer, p, writer->block_size);
+    }
+    buff_append(pending, (void *) p, size);
+}
+
+/**
+ * Compresses what is pending, ends the frame and frees the writer.
+ *
+ * @param writer The writer.
+ *
+ * @returns None
+ */
+void lz_writer_close(LzWriter *writer){
+    if(writer->pending->size > 0){
+        put_block(writer, writer->pending->body, writer->pending->size);
+    }
+    byte trailer[8];
+    write32le(trailer, 0);
+    write32le(trailer + 4, writer->crc);
+    buff_append(writer->dst, trailer, writer->flags & LZ_CONTENT_CHECKSUM ? 8 : 4);
+    buff_free(writer->pending);
+    sec_free(writer->table);
+    sec_free(writer);
+}
+
+/**
+ * Creates a reader for one frame.
+ *
+ * @returns The reader.
+ */
+LzReader *lz_reader_open(void){
+    LzReader *reader = sec_malloc(sizeof(LzReader));
+    reader->in = buff_init(HEADER_SIZE);
+    reader->state = READ_HEADER;
+    reader->block_size = 0;
+    reader->flags = 0;
+    reader->crc = 0;
+    return reader;
+}
+
+/*
+ * Consumes the complete parts of a frame at p, returns the number of bytes
+ * used or -1 if the frame is corrupt.
+ */
+static ssize_t parse(LzReader *reader, const byte *p, size_t n, Buffer *dst){
+    size_t pos = 0;
+    while(reader->state != READ_DONE){
+        const byte *at = p + pos;
+        size_t avail = n - pos;
+        if(reader->state == READ_HEADER){
+            if(avail < HEADER_SIZE){
+                break;
+            }
+            reader->flags = at[4];
+            reader->block_size = read32le(at + 5);
+            if(memcmp(at, MAGIC, 4) != 0 || reader->block_size == 0 || reader->block_size > LZ_MAX_BLOCK){
+                return -1;
+            }
+            reader->state = READ_BLOCK;
+            pos += HEADER_SIZE;
+        }else if(reader->state == READ_BLOCK){
+            if(avail < 4){
+                break;
+            }
+            uint32_t word = read32le(at);
+            if(word == 0){
+                reader->state = READ_TRAILER;
+                pos += 4;
+                continue;
+            }
+            size_t size = word & ~STORED;
+            size_t sum = reader->flags & LZ_BLOCK_CHECKSUM ? 4 : 0;
+            if(size > reader->block_size){
+                return -1;
+            }
+            if(avail < 4 + size + sum){
+                break;
+            }
+            const byte *body = at + 4;
+            if(sum && read32le(body + size) != cksum_crc32c(0, at, 4 + size)){
+                return -1;
+            }
+            byte *out;
+            ssize_t len;
+            if(word & STORED){
+                buff_reserve(dst, size);
+                out = (byte *) dst->body + dst->size;
+                memcpy(out, body, size);
+                len = size;
+            }else{
+                buff_reserve(dst, reader->block_size + WILD);
+                out = (byte *) dst->body + dst->size;
+                len = decode(out, out + reader->block_size, out + reader->block_size + WILD, body, size);
+                if(len < 0){
+                    return -1;
+                }
+            }
+            if(reader->flags & LZ_CONTENT_CHECKSUM){
+                reader->crc = cksum_crc32c(reader->crc, out, len);
+            }
+            dst->size += len;
+            pos += 4 + size + sum;
+        }else{
+            if(reader->flags & LZ_CONTENT_CHECKSUM){
+                if(avail < 4){
+                    break;
+                }
+                if(read32le(at) != reader->crc){
+                    return -1;
+                }
+                pos += 4;
+            }
+            reader->state = READ_DONE;
+        }
+    }
+    return pos;
+}
+
+/**
+ * Feeds the next piece of a frame, decompressing every block it completes.
+ *
+ * @param reader The reader.
+ * @param data The next bytes of the frame.
+ * @param size The number of bytes in data.
+ * @param dst The buffer the content is appended to.
+ *
+ * @returns 1 once the frame is complete (bytes past its end are ignored),
+ *          0 if more input is needed, -1 if the frame is corrupt.
+ */
+int lz_reader_feed(LzReader *reader, const void *data, size_t size, Buffer *dst){
+    Buffer *in = reader->in;
+    ssize_t used;
+    if(in->size == 0){
+        /* nothing pending: parse in place and keep only the incomplete rest */
+        used = parse(reader, data, size, dst);
+        if(used >= 0 && reader->state != READ_DONE){
+            buff_append(in, (byte *) data + used, size - used);
+        }
+    }else{
+        buff_append(in, (void *) data, size);
+        used = parse(reader, in->body, in->size, dst);
+        if(used > 0){
+            memmove(in->body, (byte *) in->body + used, in->size - used);
+            in->size -= used;
+        }
+    }
+    if(used < 0){
+        return -1;
+    }
+    return reader->state == READ_DONE;
+}
+
+/**
+ * Frees a reader.
+ *
+ * @param reader The reader.
+ *
+ * @returns None
+ */
+void lz_reader_free(LzReader *reader){
+    buff_free(reader->in);
+    sec_free(reader);
+}
+
+/**
+ * Compresses a range into a complete frame of default sized blocks.
+ *
+ * @param dst The buffer the frame is appended to.
+ * @param src The data.
+ * @param size The number of bytes in src.
+ * @param flags LZ_* frame flags.
+ *
+ * @returns None
+ */
+void lz_compress(Buffer *dst, const void *src, size_t size, int flags){
+    LzWriter *writer = lz_writer_open(dst, 0, flags);
+    lz_writer_write(writer, src, size);
+    lz_writer_close(writer);
+}
+
+/**
+ * Decompresses a complete frame.
+ *
+ * @param dst The buffer the content is appended to, unchanged on error.
+ * @param src The frame.
+ * @param size The number of bytes in src.
+ *
+ * @returns 0 on success, -1 if the frame is corrupt, truncated or followed
+ *          by other bytes.
+ */
+int lz_decompress(Buffer *dst, const void *src, size_t size){
+    LzReader reader = { NULL, READ_HEADER, 0, 0, 0 };
+    size_t start = dst->size;
+    if(parse(&reader, src, size, dst) != (ssize_t) size || reader.state != READ_DONE){
+        dst->size = start;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/* frame flags */
+#define LZ_BLOCK_CHECKSUM 0x01   /* CRC-32C after every block */
+#define LZ_CONTENT_CHECKSUM 0x02 /* CRC-32C of the whole uncompressed content at the end */
+
+#define LZ_DEFAULT_BLOCK ((size_t) 64 * 1024)
+#define LZ_MAX_BLOCK ((size_t) 4 * 1024 * 1024)
+
+/**
+ * Compresses a stream into a frame, one block at a time.
+ *
+ * @param dst The buffer the frame is appended to.
+ * @param pending Input not yet forming a full block.
+ * @param table The match finder hash table.
+ * @param block_size The uncompressed size of a block.
+ * @param flags LZ_* frame flags.
+ * @param crc The running CRC-32C of the content.
+ */
+struct lz_writer {
+    Buffer *dst;
+    Buffer *pending;
+    uint32_t *table;
+    size_t block_size;
+    int flags;
+    uint32_t crc;
+};
+typedef struct lz_writer LzWriter;
+
+/**
+ * Decompresses a frame fed in arbitrary pieces.
+ *
+ * @param in Input not yet consumed, a partial header or block.
+ * @param state Where in the frame the reader is.
+ * @param block_size The uncompressed block size from the header.
+ * @param flags The frame flags from the header.
+ * @param crc The running CRC-32C of the content.
+ */
+struct lz_reader {
+    Buffer *in;
+    int state;
+    size_t block_size;
+    int flags;
+    uint32_t crc;
+};
+typedef struct lz_reader LzReader;
+
+/* function prototypes */
+size_t lz_bound(size_t size);
+size_t lz_compress_block(void *dst, const void *src, size_t size);
+ssize_t lz_decompress_block(void *dst, size_t capacity, const void *src, size_t size);
+
+LzWriter *lz_writer_open(Buffer *dst, size_t block_size, int flags);
+void lz_writer_write(LzWriter *writer, const void *data, size_t size);
+void lz_writer_close(LzWriter *writer);
+LzReader *lz_reader_open(void);
+int lz_reader_feed(LzReader *reader, const void *data, size_t size, Buffer *dst);
+void lz_reader_free(LzReader *reader);
+
+void lz_compress(Buffer *dst, const void *src, size_t size, int flags);
+int lz_decompress(Buffer *dst, const void *src, size_t size);
+
+#endif
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#include "memprof.h"
+
+#include <dlfcn.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#define TABLE_SIZE ((size_t) 1 << MEMPROF_TABLE_BITS)
+/* slots per bucket, a pointer lives in its own bucket or the next one */
+#define BUCKET 8
+#define WINDOW (2 * BUCKET)
+
+/*
+ * The live pointer table has no tombstones, which would pile up over a
+ * long run and lengthen every probe: a pointer is stored in the first
+ * empty slot of a fixed window of two buckets from its hash, every lookup
+ * scans that whole window, and freeing empties the slot. Keys are kept
+ * apart from the rest so a window is two cache lines. A sample whose
+ * window is full is dropped.
+ */
+
+/* what a live sampled pointer weighs, scaled by the period it was sampled with */
+struct live_info {
+    size_t bytes;
+    unsigned int weight;
+};
+
+volatile int memprof_active = 0;
+volatile int memprof_tracking = 0;
+
+/* the pointer of each slot, 0 when empty, and what it weighs */
+static _Atomic uintptr_t *table = NULL;
+static struct live_info *info = NULL;
+static MemprofSite sites[MEMPROF_SITES + 1]; /* last entry is "other" */
+static unsigned int period = 1;
+static _Atomic int64_t live_bytes;
+static _Atomic int64_t peak_bytes;
+static _Atomic uint64_t n_allocs;
+static _Atomic uint64_t n_frees;
+static _Atomic uint64_t n_bytes;
+static _Atomic uint64_t n_dropped;
+static _Atomic uint64_t hist[MEMPROF_CLASSES];
+static _Thread_local unsigned int countdown;
+static int exit_fd = -1;
+
+static size_t slot_of(uintptr_t key, size_t bits){
+    return (size_t) ((key >> 4) * 0x9e3779b97f4a7c15ULL >> (64 - bits));
+}
+
+static unsigned int size_class(size_t size){
+    unsigned int c = size ? 64 - __builtin_clzll(size) : 0;
+    return c < MEMPROF_CLASSES ? c : MEMPROF_CLASSES - 1;
+}
+
+static void record_site(void *site, uint64_t weight, uint64_t bytes){
+    size_t i = slot_of((uintptr_t) site, 9) % MEMPROF_SITES;
+    for(size_t probes = 0; probes < MEMPROF_SITES; probes ++){
+        void *cur = __atomic_load_n(&sites[i].site, __ATOMIC_ACQUIRE);
+        if(cur == NULL){
+            void *expected = NULL;
+            if(__atomic_compare_exchange_n(&sites[i].site, &expected, site, 0,
+                                           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+                cur = site;
+            }else{
+                cur = expected;
+            }
+        }
+        if(cur == site){
+            __atomic_fetch_add(&sites[i].allocs, weight, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&sites[i].bytes, bytes, __ATOMIC_RELAXED);
+            return;
+        }
+        i = (i + 1) % MEMPROF_SITES;
+    }
+    __atomic_fetch_add(&sites[MEMPROF_SITES].allocs, weight, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sites[MEMPROF_SITES].bytes, bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * Records an allocation made through one of the sec_* allocators.
+ *
+ * Only one in every sample_every allocations per thread is recorded, the
+ * recorded ones are weighted by the sampling period.
+ *
+ * @param ptr The pointer returned to the caller.
+ * @param size The number of bytes requested.
+ * @param site The return address of the allocator call.
+ *
+ * @returns None
+ */
+void memprof_alloc(void *ptr, size_t size, void *site){
+    if(ptr == NULL || table == NULL){
+        return;
+    }
+    if(countdown > 1){
+        countdown --;
+        return;
+    }
+    countdown = period;
+
+    uint64_t weight = period;
+    uint64_t bytes = (uint64_t) size * weight;
+    uintptr_t key = (uintptr_t) ptr;
+    size_t start = slot_of(key, MEMPROF_TABLE_BITS) & ~(size_t) (BUCKET - 1);
+    size_t probes;
+    for(probes = 0; probes < WINDOW; probes ++){
+        size_t i = (start + probes) & (TABLE_SIZE - 1);
+        uintptr_t cur = 0;
+        if(atomic_load_explicit(&table[i], memory_order_relaxed) == 0 &&
+           atomic_compare_exchange_strong(&table[i], &cur, key)){
+            info[i].bytes = bytes;
+            info[i].weight = weight;
+            break;
+        }
+    }
+    if(probes == WINDOW){
+        atomic_fetch_add_explicit(&n_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    int64_t live = atomic_fetch_add_explicit(&live_bytes, bytes, memory_order_relaxed) + bytes;
+    int64_t peak = atomic_load_explicit(&peak_bytes, memory_order_relaxed);
+    while(live > peak &&
+          !atomic_compare_exchange_weak(&peak_bytes, &peak, live)){
+    }
+    atomic_fetch_add_explicit(&n_allocs, weight, memory_order_relaxed);
+    atomic_fetch_add_explicit(&n_bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist[size_class(size)], weight, memory_order_relaxed);
+    record_site(site, weight, bytes);
+}
+
+/**
+ * Records the release of a pointer, ignoring pointers that were not sampled.
+ * The free is weighted by the period the pointer was sampled with, not
+ * the current one.
+ *
+ * @param ptr The pointer being freed.
+ *
+ * @returns None
+ */
+void memprof_free(void *ptr){
+    if(ptr == NULL || table == NULL){
+        return;
+    }
+    uintptr_t key = (uintptr_t) ptr;
+    size_t start = slot_of(key, MEMPROF_TABLE_BITS) & ~(size_t) (BUCKET - 1);
+    for(size_t probes = 0; probes < WINDOW; probes ++){
+        size_t i = (start + probes) & (TABLE_SIZE - 1);
+        if(atomic_load_explicit(&table[i], memory_order_acquire) == key){
+            struct live_info freed = info[i];
+            atomic_store_explicit(&table[i], 0, memory_order_release);
+            atomic_fetch_sub_explicit(&live_bytes, freed.bytes, memory_order_relaxed);
+            atomic_fetch_add_explicit(&n_frees, freed.weight, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+/**
+ * Starts recording allocations.
+ *
+ * @param sample_every The sampling period, 1 records every allocation while
+ *                     larger values record one allocation in that many per
+ *                     thread for low overhead in production.
+ *
+ * @returns None
+ */
+void memprof_start(unsigned int sample_every){
+    if(table == NULL){
+        info = mmap(NULL, TABLE_SIZE * sizeof(struct live_info), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        void *keys = mmap(NULL, TABLE_SIZE * sizeof(uintptr_t), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(info == MAP_FAILED || keys == MAP_FAILED){
+            print_err_exit("mmap", errno);
+        }
+        table = keys;
+        memprof_tracking = 1;
+    }
+    period = sample_every ? sample_every : 1;
+    memprof_active = 1;
+}
+
+/**
+ * Stops recording allocations, the collected profile is kept. Frees are
+ * still taken out of the live bytes, so the profile stays true to the
+ * blocks that remain allocated.
+ *
+ * @returns None
+ */
+void memprof_stop(void){
+    memprof_active = 0;
+}
+
+/**
+ * Discards the collected profile. Must not race with sec_* calls.
+ *
+ * @returns None
+ */
+void memprof_reset(void){
+    if(table != NULL){
+        memset((void *) table, 0, TABLE_SIZE * sizeof(uintptr_t));
+        memset(info, 0, TABLE_SIZE * sizeof(struct live_info));
+    }
+    memset(sites, 0, sizeof(sites));
+    atomic_store(&live_bytes, 0);
+    atomic_store(&peak_bytes, 0);
+    atomic_store(&n_allocs, 0);
+    atomic_store(&n_frees, 0);
+    atomic_store(&n_bytes, 0);
+    atomic_store(&n_dropped, 0);
+    for(int i = 0; i < MEMPROF_CLASSES; i ++){
+        atomic_store(&hist[i], 0);
+    }
+}
+
+/**
+ * Copies the current counters into a snapshot.
+ *
+ * @param stats The snapshot to fill.
+ *
+ * @returns None
+ */
+void memprof_snapshot(MemprofStats *stats){
+    stats->sample_every = period;
+    stats->live_bytes = atomic_load(&live_bytes);
+    stats->peak_bytes = atomic_load(&peak_bytes);
+    stats->allocs = atomic_load(&n_allocs);
+    stats->frees = atomic_load(&n_frees);
+    stats->bytes = atomic_load(&n_bytes);
+    stats->dropped = atomic_load(&n_dropped);
+    for(int i = 0; i < MEMPROF_CLASSES; i ++){
+        stats->hist[i] = atomic_load(&hist[i]);
+    }
+}
+
+static int by_bytes(const void *a, const void *b){
+    const MemprofSite *x = a, *y = b;
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+/**
+ * Copies the per call site counters, heaviest sites first.
+ *
+ * @param out The array to fill.
+ * @param max The number of entries in out.
+ *
+ * @returns The number of entries written.
+ */
+size_t memprof_sites(MemprofSite *out, size_t max){
+    static MemprofSite tmp[MEMPROF_SITES + 1];
+    size_t n = 0;
+    for(size_t i = 0; i <= MEMPROF_SITES; i ++){
+        if(__atomic_load_n(&sites[i].allocs, __ATOMIC_RELAXED)){
+            tmp[n].site = sites[i].site;
+            tmp[n].allocs = __atomic_load_n(&sites[i].allocs, __ATOMIC_RELAXED);
+            tmp[n].bytes = __atomic_load_n(&sites[i].bytes, __ATOMIC_RELAXED);
+            n ++;
+        }
+    }
+    qsort(tmp, n, sizeof(MemprofSite), by_bytes);
+    n = n < max ? n : max;
+    memcpy(out, tmp, n * sizeof(MemprofSite));
+    return n;
+}
+
+/* formats into a stack buffer so reporting does not allocate */
+static void emit(int fd, const char *format, ...){
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(len > 0){
+        write(fd, line, (size_t) len < sizeof(line) ? (size_t) len : sizeof(line) - 1);
+    }
+}
+
+/**
+ * Writes a human readable report of the profile to a file descriptor.
+ *
+ * Call sites are resolved with dladdr, link with -rdynamic to resolve
+ * symbols of the executable itself.
+ *
+ * @param fd The file descriptor to write to.
+ *
+ * @returns None
+ */
+void memprof_report(int fd){
+    MemprofStats stats;
+    static MemprofSite top[20];
+    memprof_snapshot(&stats);
+
+    emit(fd, "==== memprof (1 in %u sampled) ====\n", stats.sample_every);
+    emit(fd, "live bytes:  %lld\n", (long long) stats.live_bytes);
+    emit(fd, "peak bytes:  %lld\n", (long long) stats.peak_bytes);
+    emit(fd, "allocs:      %llu\n", (unsigned long long) stats.allocs);
+    emit(fd, "frees:       %llu\n", (unsigned long long) stats.frees);
+    emit(fd, "total bytes: %llu\n", (unsigned long long) stats.bytes);
+    if(stats.dropped){
+        emit(fd, "dropped:     %llu\n", (unsigned long long) stats.dropped);
+    }
+
+    emit(fd, "---- size classes ----\n");
+    for(int i = 0; i < MEMPROF_CLASSES; i ++){
+        if(stats.hist[i]){
+            size_t lo = i ? (size_t) 1 << (i - 1) : 0;
+            emit(fd, "[%12zu, %12zu) %llu\n", lo, (size_t) 1 << i,
+                 (unsigned long long) stats.hist[i]);
+        }
+    }
+
+    emit(fd, "---- call sites ----\n");
+    size_t n = memprof_sites(top, sizeof(top) / sizeof(top[0]));
+    for(size_t i = 0; i < n; i ++){
+        Dl_info info;
+        if(top[i].site == NULL){
+            emit(fd, "%12llu B %10llu x  (other)\n", (unsigned long long) top[i].bytes,
+                 (unsigned long long) top[i].allocs);
+        }else if(dladdr(top[i].site, &info) && info.dli_sname != NULL){
+            emit(fd, "%12llu B %10llu x  %s+0x%zx\n", (unsigned long long) top[i].bytes,
+                 (unsigned long long) top[i].allocs, info.dli_sname,
+                 (size_t) ((char *) top[i].site - (char *) info.dli_saddr));
+        }else{
+            emit(fd, "%12llu B %10llu x  %p\n", (unsigned long long) top[i].bytes,
+                 (unsigned long long) top[i].allocs, top[i].site);
+        }
+    }
+}
+
+static void report_exit(void){
+    memprof_stop();
+    memprof_report(exit_fd);
+}
+
+/**
+ * Arranges for the report to be written when the process exits.
+ *
+ * @param fd The file descriptor to write the report to.
+ *
+ * @returns None
+ */
+void memprof_report_at_exit(int fd){
+    if(exit_fd == -1){
+        atexit(report_exit);
+    }
+    exit_fd = fd;
+}
@@ -0,0 +1,75 @@
+#ifndef MEMPROF_H
+#define MEMPROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "syscalls.h"
+
+/* power-of-two size classes: class i holds sizes in [2^(i-1), 2^i) */
+#define MEMPROF_CLASSES 40
+/* distinct call sites tracked before new sites are folded into "other" */
+#define MEMPROF_SITES 512
+/* log2 of the live pointer table size (24 bytes per slot) */
+#define MEMPROF_TABLE_BITS 20
+
+/**
+ * Per call site allocation counters.
+ *
+ * @param site The return address of the sec_* caller.
+ * @param allocs The number of (estimated) allocations made from the site.
+ * @param bytes The number of (estimated) bytes requested from the site.
+ */
+struct memprof_site {
+    void *site;
+    uint64_t allocs;
+    uint64_t bytes;
+};
+typedef struct memprof_site MemprofSite;
+
+/**
+ * A snapshot of the allocation profile.
+ *
+ * When sampling, every counter is scaled by the sampling period so the
+ * numbers estimate the unsampled totals.
+ *
+ * @param sample_every The sampling period the profile was taken with.
+ * @param live_bytes Bytes currently allocated through sec_*.
+ * @param peak_bytes The highest value live_bytes has reached.
+ * @param allocs The number of allocations recorded.
+ * @param frees The number of frees of recorded allocations.
+ * @param bytes The total number of bytes ever requested.
+ * @param dropped Samples lost because their part of the live pointer table
+ *                was full.
+ * @param hist The size class histogram, see MEMPROF_CLASSES.
+ */
+struct memprof_stats {
+    unsigned int sample_every;
+    int64_t live_bytes;
+    int64_t peak_bytes;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t bytes;
+    uint64_t dropped;
+    uint64_t hist[MEMPROF_CLASSES];
+};
+typedef struct memprof_stats MemprofStats;
+
+/* nonzero while the profiler is recording, checked by the sec_* allocators */
+extern volatile int memprof_active;
+/* nonzero once there is a profile whose live blocks frees must be taken out of */
+extern volatile int memprof_tracking;
+
+/* function prototypes */
+void memprof_start(unsigned int sample_every);
+void memprof_stop(void);
+void memprof_reset(void);
+void memprof_snapshot(MemprofStats *stats);
+size_t memprof_sites(MemprofSite *out, size_t max);
+void memprof_report(int fd);
+void memprof_report_at_exit(int fd);
+
+/* hooks for the sec_* allocators */
+void memprof_alloc(void *ptr, size_t size, void *site);
+void memprof_free(void *ptr);
+
+#endif
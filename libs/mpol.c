@@ -0,0 +1,284 @@
+#define _GNU_SOURCE
+#include "mpol.h"
+#include "hugemem.h"
+#include "topo.h"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+/*
+ * NUMA memory placement through the raw system calls, so no libnuma is
+ * needed: mbind sets the policy of a range, set_mempolicy that of the
+ * calling thread, and move_pages migrates pages or reports where they
+ * are. Placement is advice: where the kernel lacks NUMA support or a
+ * sandbox forbids the calls, they fail with ENOSYS or EPERM and the
+ * functions here succeed without doing anything, so code using them runs
+ * unchanged on single node machines. Ranges are widened to whole pages.
+ */
+
+/* pages moved or queried per move_pages call */
+#define MOVE_BATCH 256
+
+static pthread_once_t nodes_once = PTHREAD_ONCE_INIT;
+static int node_count;
+static unsigned long memory_nodes;
+static size_t page;
+
+static void load_nodes(void){
+    Topology *topo = topo_load();
+    node_count = topo->nnodes;
+    memory_nodes = topo->memory_nodes;
+    topo_free(topo);
+    page = sysconf(_SC_PAGESIZE);
+}
+
+/* nonzero if a failed call means placement is unavailable rather than wrong */
+static int unsupported(int err){
+    return err == ENOSYS || err == EPERM;
+}
+
+/* a node number checked against the nodes with memory */
+static int valid_node(int node){
+    pthread_once(&nodes_once, load_nodes);
+    if(node < 0 || node >= 64 || !(memory_nodes & (1UL << node))){
+        errno = EINVAL;
+        return 0;
+    }
+    return 1;
+}
+
+/* applies a policy to the pages covering a range */
+static int range_policy(void *ptr, size_t len, int mode, unsigned long mask, unsigned flags){
+    pthread_once(&nodes_once, load_nodes);
+    uintptr_t start = (uintptr_t) ptr & ~(page - 1);
+    uintptr_t end = ((uintptr_t) ptr + len + page - 1) & ~(page - 1);
+    if(syscall(SYS_mbind, start, end - start, mode, &mask, sizeof(mask) * 8 + 1, flags) == -1){
+        return unsupported(errno) ? 0 : -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns the number of NUMA nodes.
+ *
+ * @returns The node count, 1 on machines without NUMA.
+ */
+int mpol_nodes(void){
+    pthread_once(&nodes_once, load_nodes);
+    return node_count;
+}
+
+/**
+ * Binds the memory of a range to a node: pages not yet touched are
+ * allocated there, and pages already present are moved.
+ *
+ * @param ptr The start of the range.
+ * @param len The length of the range.
+ * @param node The node.
+ *
+ * @returns 0 on success or if NUMA placement is unavailable, -1 with errno
+ *          set on failure, EINVAL if the node has no memory.
+ */
+int mpol_bind(void *ptr, size_t len, int node){
+    if(!valid_node(node)){
+        return -1;
+    }
+    return range_policy(ptr, len, MPOL_BIND, 1UL << node, MPOL_MF_MOVE);
+}
+
+/**
+ * Interleaves the pages of a range over every node with memory, page by
+ * page, so a range read from all nodes gets the bandwidth of all of them.
+ * Applies to pages not yet touched.
+ *
+ * @param ptr The start of the range.
+ * @param len The length of the range.
+ *
+ * @returns 0 on success or if NUMA placement is unavailable, -1 with errno
+ *          set on failure.
+ */
+int mpol_interleave(void *ptr, size_t len){
+    pthread_once(&nodes_once, load_nodes);
+    return range_policy(ptr, len, MPOL_INTERLEAVE, memory_nodes, 0);
+}
+
+/**
+ * Makes the calling thread allocate new memory on a node when it can,
+ * falling back to other nodes when that one is full.
+ *
+ * @param node The node, or -1 to go back to allocating on the node the
+ *             thread runs on.
+ *
+ * @returns 0 on success or if NUMA placement is unavailable, -1 with errno
+ *          set on failure.
+ */
+int mpol_prefer(int node){
+    unsigned long mask = 0;
+    int mode = MPOL_DEFAULT;
+    if(node != -1){
+        if(!valid_node(node)){
+            return -1;
+        }
+        mask = 1UL << node;
+        mode = MPOL_PREFERRED;
+    }
+    if(syscall(SYS_set_mempolicy, mode, node == -1 ? NULL : &mask, node == -1 ? 0 : sizeof(mask) * 8 + 1) == -1){
+        return unsupported(errno) ? 0 : -1;
+    }
+    return 0;
+}
+
+/**
+ * Moves the pages of a range that are already present to a node, without
+ * changing the policy for pages touched later.
+ *
+ * @param ptr The start of the range.
+ * @param len The length of the range.
+ * @param node The node.
+ *
+ * @returns 0 on success or if NUMA placement is unavailable, -1 with errno
+ *          set on failure.
+ */
+int mpol_move(void *ptr, size_t len, int node){
+    if(!valid_node(node)){
+        return -1;
+    }
+    uintptr_t start = (uintptr_t) ptr & ~(page - 1);
+    uintptr_t end = (uintptr_t) ptr + len;
+    void *pages[MOVE_BATCH];
+    int nodes[MOVE_BATCH], status[MOVE_BATCH];
+    while(start < end){
+        unsigned long count = 0;
+        for(; count < MOVE_BATCH && start < end; count ++, start += page){
+            pages[count] = (void *) start;
+            nodes[count] = node;
+        }
+        if(syscall(SYS_move_pages, 0, count, pages, nodes, status, MPOL_MF_MOVE) == -1){
+            return unsupported(errno) ? 0 : -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Tells which node the page holding an address is on.
+ *
+ * @param ptr The address.
+ *
+ * @returns The node, 0 if NUMA placement is unavailable, or -1 if the page
+ *          has not been touched yet.
+ */
+int mpol_node_of(const void *ptr){
+    pthread_once(&nodes_once, load_nodes);
+    void *addr = (void *) ((uintptr_t) ptr & ~(page - 1));
+    int status;
+    if(syscall(SYS_move_pages, 0, 1UL, &addr, NULL, &status, 0) == -1){
+        return unsupported(errno) ? 0 : -1;
+    }
+    return status < 0 ? -1 : status;
+}
+
+/**
+ * Creates a Buffer whose body lives on a node. The body is a mapping of
+ * its own bound to the node before anything touches it, so it is
+ * allocated there whatever thread fills it; it stays bound while
+ * buff_resize keeps it above the huge page threshold. Free it with
+ * buff_free.
+ *
+ * @param capacity The capacity.
+ * @param node The node.
+ *
+ * @returns The buffer, or NULL with errno set to EINVAL if the node has no
+ *          memory.
+ */
+Buffer *mpol_buff(size_t capacity, int node){
+    if(!valid_node(node)){
+        return NULL;
+    }
+    Buffer *buff = sec_malloc(sizeof(Buffer));
+    buff->size = 0;
+    buff->capacity = capacity;
+    buff->body = hugemem_map(capacity);
+    if(buff->body == NULL){
+        /* an unbound body still works */
+        buff->body = sec_malloc(capacity);
+    }else{
+        size_t map_size = (capacity + HUGEMEM_PAGE - 1) & ~(HUGEMEM_PAGE - 1);
+        range_policy(buff->body, map_size, MPOL_BIND, 1UL << node, 0);
+    }
+    return buff;
+}
+
+struct touch_arg {
+    byte *ptr;
+    size_t offset;
+    size_t len;
+    int cpu;
+    mpol_init_fn init;
+    void *ctx;
+};
+
+static void *touch_slice(void *arg){
+    struct touch_arg *a = arg;
+    topo_pin(a->cpu);
+    if(a->init != NULL){
+        a->init(a->ctx, a->ptr + a->offset, a->offset, a->len);
+    }else{
+        for(size_t i = 0; i < a->len; i += page){
+            a->ptr[a->offset + i] = 0;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Initializes a block from several threads, each pinned to a CPU chosen
+ * with TOPO_SPREAD and writing its own contiguous slice first, so under
+ * the default policy every page lands on the node of the thread that
+ * will use it. Slices are len / threads rounded up to whole pages; the
+ * thread with index i gets the i-th. Worker code pinned the same way then
+ * reads local memory. Without NUMA this is simply a parallel fill.
+ *
+ * @param ptr The block, not yet touched.
+ * @param len The length of the block.
+ * @param threads The number of threads.
+ * @param init Called by each thread with its slice, or NULL to write a
+ *             zero to each page.
+ * @param ctx Passed to init.
+ *
+ * @returns None
+ */
+void mpol_first_touch(void *ptr, size_t len, int threads, mpol_init_fn init, void *ctx){
+    pthread_once(&nodes_once, load_nodes);
+    if(threads < 1){
+        threads = 1;
+    }
+    Topology *topo = topo_load();
+    int *cpus = sec_malloc(threads * sizeof(int));
+    topo_place(topo, TOPO_SPREAD, threads, cpus);
+    topo_free(topo);
+
+    size_t slice = ((len + threads - 1) / threads + page - 1) & ~(page - 1);
+    pthread_t *tids = sec_malloc(threads * sizeof(pthread_t));
+    struct touch_arg *args = sec_malloc(threads * sizeof(struct touch_arg));
+    int started = 0;
+    for(int t = 0; t < threads; t ++){
+        size_t offset = (size_t) t * slice;
+        if(offset >= len){
+            break;
+        }
+        args[t] = (struct touch_arg) { ptr, offset, len - offset < slice ? len - offset : slice, cpus[t], init, ctx };
+        int err = pthread_create(&tids[t], NULL, touch_slice, &args[t]);
+        if(err != 0){
+            print_err_exit("pthread_create", err);
+        }
+        started ++;
+    }
+    for(int t = 0; t < started; t ++){
+        pthread_join(tids[t], NULL);
+    }
+    sec_free(args);
+    sec_free(tids);
+    sec_free(cpus);
+}
@@ -0,0 +1,20 @@
+#ifndef MPOL_H
+#define MPOL_H
+
+#include <stddef.h>
+#include "buffer.h"
+
+/* initializes one thread's slice of a block, see mpol_first_touch */
+typedef void (*mpol_init_fn)(void *ctx, void *slice, size_t offset, size_t len);
+
+/* function prototypes */
+int mpol_nodes(void);
+int mpol_bind(void *ptr, size_t len, int node);
+int mpol_interleave(void *ptr, size_t len);
+int mpol_prefer(int node);
+int mpol_move(void *ptr, size_t len, int node);
+int mpol_node_of(const void *ptr);
+Buffer *mpol_buff(size_t capacity, int node);
+void mpol_first_touch(void *ptr, size_t len, int threads, mpol_init_fn init, void *ctx);
+
+#endif
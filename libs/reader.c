@@ -0,0 +1,225 @@
+#include "reader.h"
+#include "scan.h"
+
+/* the smallest default read size, below this syscall overhead dominates */
+#define MIN_CHUNK ((size_t) 64 * 1024)
+/* length prefixes above this are treated as corrupt rather than allocated */
+#define MAX_RECORD ((size_t) 1 << 30)
+
+/**
+ * Returns the preferred I/O size of a file descriptor (st_blksize).
+ *
+ * @param fd The file descriptor.
+ *
+ * @returns The size in bytes.
+ */
+size_t reader_hint(int fd){
+    struct stat st;
+    sys_fstat(fd, &st);
+    return st.st_blksize > 0 ? (size_t) st.st_blksize : 4096;
+}
+
+/**
+ * Creates a reader.
+ *
+ * @param fd The file descriptor to read from, it stays owned by the caller.
+ * @param chunk The number of bytes to ask for per read, 0 for a multiple of
+ *              reader_hint(fd) of at least 64 KiB.
+ *
+ * @returns The reader.
+ */
+Reader *reader_open(int fd, size_t chunk){
+    Reader *reader = sec_malloc(sizeof(Reader));
+    if(chunk == 0){
+        size_t hint = reader_hint(fd);
+        chunk = hint >= MIN_CHUNK ? hint : (MIN_CHUNK + hint - 1) / hint * hint;
+    }
+    reader->fd = fd;
+    reader->chunk = chunk;
+    reader->buff = buff_init(chunk);
+    reader->pos = 0;
+    reader->scanned = 0;
+    reader->eof = 0;
+    return reader;
+}
+
+/**
+ * Frees a reader, without closing its file descriptor.
+ *
+ * @param reader The reader.
+ *
+ * @returns None
+ */
+void reader_free(Reader *reader){
+    buff_free(reader->buff);
+    sec_free(reader);
+}
+
+/*
+ * Reads more data. Unconsumed bytes (a record straddling the end of the
+ * previous read) are first moved to the front, and the storage grows when
+ * a single record needs more than is left.
+ */
+static void refill(Reader *reader, size_t need){
+    Buffer *buff = reader->buff;
+    size_t avail = buff->size - reader->pos;
+    if(reader->pos > 0){
+        memmove(buff->body, (byte *) buff->body + reader->pos, avail);
+        buff->size = avail;
+        reader->pos = 0;
+    }
+    buff_reserve(buff, need > avail + reader->chunk ? need - avail : reader->chunk);
+
+    ssize_t n;
+    do{
+        n = read(reader->fd, (byte *) buff->body + buff->size, buff->capacity - buff->size);
+    }while(n == -1 && errno == EINTR);
+    if(n == -1){
+        print_err_exit("read", errno);
+    }
+    if(n == 0){
+        reader->eof = 1;
+    }
+    buff->size += n;
+}
+
+/* makes need bytes available at pos, returns 0 if the input ends first */
+static int fill(Reader *reader, size_t need){
+    while(reader->buff->size - reader->pos < need){
+        if(reader->eof){
+            return 0;
+        }
+        refill(reader, need);
+    }
+    return 1;
+}
+
+static BuffView view_at(Reader *reader, size_t off, size_t len){
+    BuffView view = { (byte *) reader->buff->body + reader->pos + off, len };
+    return view;
+}
+
+/**
+ * Returns the next line without its '\n' (or "\r\n"). A final line without
+ * a newline is returned as well.
+ *
+ * @param reader The reader.
+ * @param line Receives the line, valid until the next call on the reader.
+ *
+ * @returns 1 if a line was returned, 0 at the end of the input.
+ */
+int reader_line(Reader *reader, BuffView *line){
+    for(;;){
+        Buffer *buff = reader->buff;
+        const byte *start = (byte *) buff->body + reader->pos;
+        size_t avail = buff->size - reader->pos;
+        const byte *nl = scan_byte(start + reader->scanned, avail - reader->scanned, '\n');
+        if(nl != NULL){
+            size_t len = nl - start;
+            *line = view_at(reader, 0, len > 0 && nl[-1] == '\r' ? len - 1 : len);
+            reader->pos += len + 1;
+            reader->scanned = 0;
+            return 1;
+        }
+        reader->scanned = avail;
+        if(reader->eof){
+            if(avail == 0){
+                return 0;
+            }
+            *line = view_at(reader, 0, avail);
+            reader->pos += avail;
+            reader->scanned = 0;
+            return 1;
+        }
+        refill(reader, avail + 1);
+    }
+}
+
+/**
+ * Returns the next fixed size record.
+ *
+ * @param reader The reader.
+ * @param size The record size.
+ * @param record Receives the record, valid until the next call on the reader.
+ *
+ * @returns 1 if a record was returned, 0 at the end of the input, -1 if the
+ *          input ends in the middle of a record (the partial record is
+ *          consumed).
+ */
+int reader_fixed(Reader *reader, size_t size, BuffView *record){
+    if(!fill(reader, size)){
+        size_t avail = reader->buff->size - reader->pos;
+        reader->pos += avail;
+        return avail ? -1 : 0;
+    }
+    *record = view_at(reader, 0, size);
+    reader->pos += size;
+    return 1;
+}
+
+/* decodes a LEB128 length at pos, returns its width or 0 if incomplete/invalid */
+static int varint_at(Reader *reader, uint64_t *len){
+    const byte *p = (byte *) reader->buff->body + reader->pos;
+    size_t avail = reader->buff->size - reader->pos;
+    *len = 0;
+    for(size_t i = 0; i < avail && i < 10; i ++){
+        *len |= (uint64_t) (p[i] & 0x7f) << (7 * i);
+        if(!(p[i] & 0x80)){
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the next length prefixed record.
+ *
+ * @param reader The reader.
+ * @param width The size of the length prefix: 1, 2, 4 or 8 bytes, or 0 for
+ *              an unsigned LEB128 varint.
+ * @param endianess LITTLE_ENDIAN or BIG_ENDIAN, the byte order of fixed
+ *                  width prefixes.
+ * @param record Receives the payload without the prefix, valid until the
+ *               next call on the reader.
+ *
+ * @returns 1 if a record was returned, 0 at the end of the input, -1 if the
+ *          input ends in the middle of a record or the length is corrupt
+ *          (the rest of the input is consumed).
+ */
+int reader_prefixed(Reader *reader, int width, int endianess, BuffView *record){
+    uint64_t len = 0;
+    size_t header;
+    if(width == 0){
+        int n;
+        for(size_t want = 1; (n = varint_at(reader, &len)) == 0 && want <= 10; want ++){
+            if(!fill(reader, want)){
+                break;
+            }
+        }
+        header = n;
+    }else{
+        if(width != 1 && width != 2 && width != 4 && width != 8){
+            print(STDERR_FILENO, "Error: reader prefix width %d\n", width);
+            exit(EXIT_FAILURE);
+        }
+        header = fill(reader, width) ? (size_t) width : 0;
+        const byte *p = (byte *) reader->buff->body + reader->pos;
+        for(int i = 0; header && i < width; i ++){
+            len |= (uint64_t) p[endianess == BIG_ENDIAN ? i : width - 1 - i] << (8 * (width - 1 - i));
+        }
+    }
+
+    if(header == 0 || len > MAX_RECORD || !fill(reader, header + len)){
+        size_t avail = reader->buff->size - reader->pos;
+        do{
+            reader->pos = reader->buff->size;
+            if(!reader->eof){
+                refill(reader, 0);
+            }
+        }while(reader->pos != reader->buff->size);
+        return avail || len ? -1 : 0;
+    }
+    *record = view_at(reader, header, len);
+    reader->pos += header + len;
+    return 1;
+}
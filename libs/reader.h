@@ -0,0 +1,35 @@
+#ifndef READER_H
+#define READER_H
+
+#include "buffer.h"
+
+/**
+ * A buffered reader over a file descriptor that hands out records as views
+ * into its own storage: one copy from the kernel, none after that.
+ *
+ * @param fd The file descriptor read from, owned by the caller.
+ * @param buff The refillable storage.
+ * @param pos The offset of the first unconsumed byte in buff.
+ * @param scanned How far past pos a pending line has already been searched.
+ * @param chunk The preferred number of bytes per read.
+ * @param eof Nonzero once read returned 0.
+ */
+struct reader {
+    int fd;
+    Buffer *buff;
+    size_t pos;
+    size_t scanned;
+    size_t chunk;
+    int eof;
+};
+typedef struct reader Reader;
+
+/* function prototypes */
+size_t reader_hint(int fd);
+Reader *reader_open(int fd, size_t chunk);
+void reader_free(Reader *reader);
+int reader_line(Reader *reader, BuffView *line);
+int reader_fixed(Reader *reader, size_t size, BuffView *record);
+int reader_prefixed(Reader *reader, int width, int endianess, BuffView *record);
+
+#endif
@@ -0,0 +1,224 @@
+#include "region.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+/* allocations are aligned for SSE loads, the first one to a cache line */
+#define ALIGN 16
+#define HEADER 64
+
+/**
+ * Creates a shared region. Children forked after this call see the same
+ * memory at the same address; the memory is released when the last
+ * process unmaps it or exits.
+ *
+ * @param capacity The size of the region in bytes, fixed for its lifetime.
+ *
+ * @returns The region.
+ */
+Region *region_create(size_t capacity){
+    if(capacity < HEADER){
+        capacity = HEADER;
+    }
+    Region *region = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(region == MAP_FAILED){
+        print_err_exit("mmap", errno);
+    }
+    region->capacity = capacity;
+    atomic_init(&region->used, HEADER);
+    return region;
+}
+
+/**
+ * Unmaps a region from this process. Pointers into it become invalid here,
+ * other processes keep their mapping.
+ *
+ * @param region The region.
+ *
+ * @returns None
+ */
+void region_free(Region *region){
+    munmap(region, region->capacity);
+}
+
+/**
+ * Allocates shared memory from a region, from any of the processes sharing
+ * it. The memory is zeroed and 16 byte aligned, and it is never reused.
+ *
+ * @param region The region.
+ * @param size The number of bytes.
+ *
+ * @returns The memory, or NULL if the region is full.
+ */
+void *region_alloc(Region *region, size_t size){
+    size_t rounded = (size + ALIGN - 1) / ALIGN * ALIGN;
+    size_t used = atomic_load_explicit(&region->used, memory_order_relaxed);
+    do{
+        if(rounded < size || rounded > region->capacity - used){
+            return NULL;
+        }
+    }while(!atomic_compare_exchange_weak_explicit(&region->used, &used, used + rounded,
+                                                  memory_order_relaxed, memory_order_relaxed));
+    return (byte *) region + used;
+}
+
+/**
+ * Returns how much of a region has been allocated.
+ *
+ * @param region The region.
+ *
+ * @returns The bytes used, including the region's own header.
+ */
+size_t region_used(Region *region){
+    return atomic_load(&region->used);
+}
+
+/**
+ * Allocates a Buffer in a region, the struct and the body both, so every
+ * process sharing the region can reach it. Appends update size, body and
+ * capacity without any synchronization, so the buffer must have a single
+ * writer at a time, and readers in other processes must agree with it
+ * when the contents are complete, for example through a SeqLock record
+ * holding the size they may read. The buff_* functions work on it as long
+ * as they stay within its capacity; grow it with region_buff_reserve or
+ * region_buff_append, never buff_resize, and never buff_free it.
+ *
+ * @param region The region.
+ * @param capacity The initial capacity.
+ *
+ * @returns The buffer, or NULL if the region is full.
+ */
+Buffer *region_buff(Region *region, size_t capacity){
+    Buffer *buff = region_alloc(region, sizeof(Buffer));
+    if(buff == NULL){
+        return NULL;
+    }
+    buff->size = 0;
+    buff->capacity = capacity;
+    buff->body = capacity ? region_alloc(region, capacity) : NULL;
+    if(capacity && buff->body == NULL){
+        return NULL;
+    }
+    return buff;
+}
+
+/**
+ * Makes room for at least extra more bytes in a region Buffer, moving its
+ * body to a larger allocation in the region if needed. The old body is not
+ * reclaimed, so grow geometrically or reserve up front. Only the single
+ * writer of the buffer may call it.
+ *
+ * @param region The region the buffer was allocated in.
+ * @param buff The buffer.
+ * @param extra The number of bytes about to be written after the contents.
+ *
+ * @returns 0 on success, -1 if the region is full, with the buffer unchanged.
+ */
+int region_buff_reserve(Region *region, Buffer *buff, size_t extra){
+    size_t need = buff->size + extra;
+    if(need <= buff->capacity){
+        return 0;
+    }
+    size_t grow = buff->capacity * 2;
+    size_t capacity = grow > need ? grow : need;
+    void *body = region_alloc(region, capacity);
+    if(body == NULL && capacity > need){
+        capacity = need;
+        body = region_alloc(region, capacity);
+    }
+    if(body == NULL){
+        return -1;
+    }
+    if(buff->size > 0){
+        memcpy(body, buff->body, buff->size);
+    }
+    buff->body = body;
+    buff->capacity = capacity;
+    return 0;
+}
+
+/**
+ * Appends to a region Buffer, growing it inside the region. Only the
+ * single writer of the buffer may call it.
+ *
+ * @param region The region the buffer was allocated in.
+ * @param buff The buffer.
+ * @param data The bytes to append.
+ * @param size The number of bytes.
+ *
+ * @returns 0 on success, -1 if the region is full, with the buffer unchanged.
+ */
+int region_buff_append(Region *region, Buffer *buff, const void *data, size_t size){
+    if(region_buff_reserve(region, buff, size) == -1){
+        return -1;
+    }
+    memcpy((byte *) buff->body + buff->size, data, size);
+    buff->size += size;
+    return 0;
+}
+
+/**
+ * Initializes a sequence lock, before it is shared.
+ *
+ * @param lock The lock.
+ *
+ * @returns None
+ */
+void seqlock_init(SeqLock *lock){
+    atomic_init(&lock->seq, 0);
+}
+
+/**
+ * Replaces the record a sequence lock protects. Writers from several
+ * processes are serialized, each waiting for the previous one to finish.
+ *
+ * @param lock The lock.
+ * @param record The record, in shared memory.
+ * @param data The new contents.
+ * @param size The size of the record.
+ *
+ * @returns None
+ */
+void seqlock_write(SeqLock *lock, void *record, const void *data, size_t size){
+    uint32_t seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    for(;;){
+        if(seq & 1){
+            sched_yield();
+            seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+        }else if(atomic_compare_exchange_weak_explicit(&lock->seq, &seq, seq + 1,
+                                                       memory_order_acquire, memory_order_relaxed)){
+            break;
+        }
+    }
+    /* the odd count must be visible before any byte of the record changes */
+    atomic_thread_fence(memory_order_release);
+    memcpy(record, data, size);
+    atomic_store_explicit(&lock->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * Copies out the record a sequence lock protects, retrying until the copy
+ * did not overlap a write.
+ *
+ * @param lock The lock.
+ * @param record The record, in shared memory.
+ * @param out Receives the contents.
+ * @param size The size of the record.
+ *
+ * @returns None
+ */
+void seqlock_read(SeqLock *lock, const void *record, void *out, size_t size){
+    for(;;){
+        uint32_t seq = atomic_load_explicit(&lock->seq, memory_order_acquire);
+        if(seq & 1){
+            sched_yield();
+            continue;
+        }
+        memcpy(out, record, size);
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&lock->seq, memory_order_relaxed) == seq){
+            return;
+        }
+    }
+}
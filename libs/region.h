@@ -0,0 +1,49 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/**
+ * A fixed size block of memory shared between a process and the children
+ * it forks afterwards, at the same address in all of them, so pointers
+ * into it can be passed around freely. Space is handed out by a bump
+ * allocator that any of the processes may call; it is only given back
+ * when the region is destroyed. The struct itself is the start of the
+ * shared memory.
+ *
+ * @param capacity The size of the mapping.
+ * @param used The bytes handed out so far, including this header.
+ */
+struct region {
+    size_t capacity;
+    _Atomic size_t used;
+};
+typedef struct region Region;
+
+/**
+ * A sequence lock, for a small record written now and then by one process
+ * and read often by many. Readers never block the writer: they copy the
+ * record and retry if a write overlapped the copy.
+ *
+ * @param seq Even while the record is stable, odd during a write.
+ */
+struct seqlock {
+    _Atomic uint32_t seq;
+};
+typedef struct seqlock SeqLock;
+
+/* function prototypes */
+Region *region_create(size_t capacity);
+void region_free(Region *region);
+void *region_alloc(Region *region, size_t size);
+size_t region_used(Region *region);
+Buffer *region_buff(Region *region, size_t capacity);
+int region_buff_reserve(Region *region, Buffer *buff, size_t extra);
+int region_buff_append(Region *region, Buffer *buff, const void *data, size_t size);
+
+void seqlock_init(SeqLock *lock);
+void seqlock_write(SeqLock *lock, void *record, const void *data, size_t size);
+void seqlock_read(SeqLock *lock, const void *record, void *out, size_t size);
+
+#endif
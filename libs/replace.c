@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include "replace.h"
+
+#include <stdatomic.h>
+
+VEC_DEFINE(DirList, char *)
+
+/* makes temporary names unique within the process */
+static _Atomic unsigned long tmp_counter;
+
+static char *copy_string(const char *s, size_t len){
+    char *copy = sec_malloc(len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/* the directory part of a path, "." if it has none */
+static char *dir_of(const char *path){
+    const char *slash = strrchr(path, '/');
+    if(slash == NULL){
+        return copy_string(".", 1);
+    }
+    if(slash == path){
+        return copy_string("/", 1);
+    }
+    return copy_string(path, slash - path);
+}
+
+/* a name next to path, hidden and unique, for the new contents */
+static char *tmp_name(const char *path){
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t) (slash - path + 1) : 0;
+    Buffer *name = buff_init(64);
+    buff_append(name, (void *) path, dir_len);
+    buff_appendf(name, ".%s.tmp%ld.%lu", path + dir_len, (long) getpid(),
+                 atomic_fetch_add(&tmp_counter, 1));
+    char *tmp = copy_string(name->body, name->size);
+    buff_free(name);
+    return tmp;
+}
+
+static int write_all(int fd, const void *data, size_t size){
+    for(size_t done = 0; done < size; ){
+        ssize_t n = write(fd, (const byte *) data + done, size - done);
+        if(n == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/* closes and removes a file that was not put in place, keeping errno */
+static void discard(struct replace_entry *entry){
+    int err = errno;
+    if(entry->fd != -1){
+        close(entry->fd);
+    }
+    if(entry->tmp != NULL){
+        unlink(entry->tmp);
+        sec_free(entry->tmp);
+    }
+    sec_free(entry->path);
+    errno = err;
+}
+
+/* gives an O_TMPFILE file its temporary name, so it can be renamed */
+static int name_tmpfile(struct replace_entry *entry){
+    char proc[64];
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", entry->fd);
+    entry->tmp = tmp_name(entry->path);
+    if(linkat(AT_FDCWD, proc, AT_FDCWD, entry->tmp, AT_SYMLINK_FOLLOW) == 0
+       || linkat(entry->fd, "", AT_FDCWD, entry->tmp, AT_EMPTY_PATH) == 0){
+        return 0;
+    }
+    sec_free(entry->tmp);
+    entry->tmp = NULL;
+    return -1;
+}
+
+static int cmp_dir(char *const *a, char *const *b){
+    return strcmp(*a, *b);
+}
+
+/**
+ * Starts a batch of file replacements.
+ *
+ * @returns The batch.
+ */
+ReplaceBatch *replace_begin(void){
+    ReplaceBatch *batch = sec_malloc(sizeof(ReplaceBatch));
+    ReplaceList_init(&batch->files, 0);
+    return batch;
+}
+
+/**
+ * Writes the new contents of a file, leaving the current file untouched
+ * until replace_commit. The data goes to an unnamed O_TMPFILE inode in the
+ * target's directory, or where that is not supported, to a hidden
+ * temporary file next to it. Writeback starts right away, so the sync at
+ * commit overlaps with writing the rest of the batch.
+ *
+ * @param batch The batch.
+ * @param path The file to replace or create.
+ * @param data The new contents.
+ * @param size The size of the contents.
+ * @param mode The permissions of the new file.
+ *
+ * @returns 0 on success, -1 with errno set if the file could not be
+ *          written, in which case it is left out of the batch.
+ */
+int replace_add(ReplaceBatch *batch, const char *path, const void *data, size_t size, mode_t mode){
+    struct replace_entry entry;
+    entry.path = copy_string(path, strlen(path));
+    entry.tmp = NULL;
+
+    char *dir = dir_of(path);
+    entry.fd = open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+    sec_free(dir);
+    if(entry.fd == -1){
+        if(errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL){
+            discard(&entry);
+            return -1;
+        }
+        entry.tmp = tmp_name(path);
+        entry.fd = open(entry.tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if(entry.fd == -1){
+            sec_free(entry.tmp);
+            entry.tmp = NULL;
+            discard(&entry);
+            return -1;
+        }
+    }
+    /* creating applies the umask, the replacement gets exactly mode */
+    if(fchmod(entry.fd, mode) == -1 || write_all(entry.fd, data, size) == -1){
+        discard(&entry);
+        return -1;
+    }
+    sync_file_range(entry.fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+    ReplaceList_push(&batch->files, entry);
+    return 0;
+}
+
+/**
+ * Puts every file of a batch in place: syncs the new contents, renames
+ * each over its target, then syncs each directory involved once. Each file
+ * is replaced atomically, the batch as a whole is not: if a step fails
+ * midway, the files before it are already replaced and the rest are
+ * discarded. The batch is freed either way.
+ *
+ * @param batch The batch.
+ *
+ * @returns 0 on success, -1 with errno set on the first failure.
+ */
+int replace_commit(ReplaceBatch *batch){
+    ReplaceList *files = &batch->files;
+    int err = 0;
+    size_t i = 0;
+    for(; i < files->size && err == 0; i ++){
+        if(fdatasync(ReplaceList_at(files, i)->fd) == -1){
+            err = errno;
+        }
+    }
+
+    DirList dirs;
+    DirList_init(&dirs, 0);
+    for(i = 0; i < files->size && err == 0; i ++){
+        struct replace_entry *entry = ReplaceList_at(files, i);
+        if((entry->tmp == NULL && name_tmpfile(entry) == -1) || rename(entry->tmp, entry->path) == -1){
+            err = errno;
+            break;
+        }
+        sec_free(entry->tmp);
+        entry->tmp = NULL;
+        DirList_push(&dirs, dir_of(entry->path));
+        discard(entry);
+    }
+    for(; i < files->size; i ++){
+        discard(ReplaceList_at(files, i));
+    }
+
+    DirList_sort(&dirs, cmp_dir);
+    for(i = 0; i < dirs.size; i ++){
+        if(i > 0 && strcmp(dirs.data[i], dirs.data[i - 1]) == 0){
+            continue;
+        }
+        int fd = open(dirs.data[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(fd == -1 || fsync(fd) == -1){
+            err = err ? err : errno;
+        }
+        if(fd != -1){
+            close(fd);
+        }
+    }
+    for(i = 0; i < dirs.size; i ++){
+        sec_free(dirs.data[i]);
+    }
+    DirList_free(&dirs);
+
+    ReplaceList_free(files);
+    sec_free(batch);
+    errno = err;
+    return err ? -1 : 0;
+}
+
+/**
+ * Drops a batch without touching any target file.
+ *
+ * @param batch The batch.
+ *
+ * @returns None
+ */
+void replace_abort(ReplaceBatch *batch){
+    for(size_t i = 0; i < batch->files.size; i ++){
+        discard(ReplaceList_at(&batch->files, i));
+    }
+    ReplaceList_free(&batch->files);
+    sec_free(batch);
+}
+
+/**
+ * Atomically replaces or creates a single file, durable on return.
+ *
+ * @param path The file.
+ * @param data The new contents.
+ * @param size The size of the contents.
+ * @param mode The permissions of the new file.
+ *
+ * @returns 0 on success, -1 with errno set on failure, leaving the file
+ *          as it was.
+ */
+int replace_file(const char *path, const void *data, size_t size, mode_t mode){
+    ReplaceBatch *batch = replace_begin();
+    if(replace_add(batch, path, data, size, mode) == -1){
+        int err = errno;
+        replace_abort(batch);
+        errno = err;
+        return -1;
+    }
+    return replace_commit(batch);
+}
@@ -0,0 +1,46 @@
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include "buffer.h"
+#include "vec.h"
+
+/**
+ * A file written but not yet in place.
+ *
+ * @param path Where it goes, a copy owned by the batch.
+ * @param fd The new contents.
+ * @param tmp The temporary name the contents are under, or NULL for an
+ *            O_TMPFILE file that has no name yet.
+ */
+struct replace_entry {
+    char *path;
+    int fd;
+    char *tmp;
+};
+
+VEC_DEFINE(ReplaceList, struct replace_entry)
+
+/**
+ * Files being replaced together. Each one is written to a new inode, then
+ * all are synced, renamed over their targets, and each directory involved
+ * is synced once. Readers see every file either entirely old or entirely
+ * new. With O_TMPFILE a crash before commit leaves nothing behind, but
+ * commit links each file to a temporary name next to its target just
+ * before renaming it, so a crash in between can leave a .name.tmpPID.N
+ * file, as it always can without O_TMPFILE.
+ *
+ * @param files The files added so far.
+ */
+struct replace_batch {
+    ReplaceList files;
+};
+typedef struct replace_batch ReplaceBatch;
+
+/* function prototypes */
+ReplaceBatch *replace_begin(void);
+int replace_add(ReplaceBatch *batch, const char *path, const void *data, size_t size, mode_t mode);
+int replace_commit(ReplaceBatch *batch);
+void replace_abort(ReplaceBatch *batch);
+int replace_file(const char *path, const void *data, size_t size, mode_t mode);
+
+#endif
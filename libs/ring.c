@@ -0,0 +1,450 @@
+#define _GNU_SOURCE
+#include "ring.h"
+
+#include <limits.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define RING_MAGIC 0x31474e4952ULL /* "RING1" */
+
+/* tries before a waiting call sleeps in the kernel */
+#define SPIN 256
+
+/*
+ * The part of the queue in shared memory. Each index sits on its own cache
+ * line, so producers and consumers only contend on the line they both
+ * need. head counts messages claimed by producers, tail messages claimed
+ * by consumers; both only grow, and a message lives in slot pos & mask.
+ *
+ * SPSC slots hold just the message and the indices double as the publish
+ * points. MPMC slots start with a sequence number: pos when the slot is
+ * free for the producer of pos, pos + 1 once that message is written, and
+ * pos + capacity once it has been read, which frees it for the next lap.
+ *
+ * A process about to sleep on an empty (full) queue sets data_sleeping
+ * (space_sleeping), then checks the queue once more and waits on the futex
+ * word data_event (space_event). The other side only makes the wake call
+ * when it finds the flag set, and clears it, so a busy queue costs no
+ * syscalls and a sleeping one a single wake.
+ */
+struct ring_shared {
+    uint64_t magic;
+    uint64_t msg_size;
+    uint64_t capacity;
+    uint64_t mode;
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Alignas(64) _Atomic uint32_t data_event;
+    _Atomic uint32_t data_sleeping;
+    _Alignas(64) _Atomic uint32_t space_event;
+    _Atomic uint32_t space_sleeping;
+    _Alignas(64) byte slots[];
+};
+
+static inline void cpu_relax(void){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*
+ * Waits for another process to finish with a slot it has claimed. That
+ * takes a few hundred cycles unless it was preempted in between, so spin
+ * briefly and then give it the CPU.
+ */
+static void await_seq(_Atomic uint64_t *seq, uint64_t value){
+    for(int spins = 0; atomic_load_explicit(seq, memory_order_acquire) != value; spins ++){
+        if(spins < SPIN){
+            cpu_relax();
+        }else{
+            sched_yield();
+        }
+    }
+}
+
+static size_t stride(size_t msg_size, int mode){
+    if(mode == RING_SPSC){
+        return msg_size;
+    }
+    return (sizeof(uint64_t) + msg_size + 7) / 8 * 8;
+}
+
+static inline _Atomic uint64_t *seq(const Ring *ring, uint64_t pos){
+    return (_Atomic uint64_t *) (ring->slots + (pos & ring->mask) * ring->slot_stride);
+}
+
+static inline byte *msg(const Ring *ring, uint64_t pos){
+    return ring->slots + (pos & ring->mask) * ring->slot_stride + sizeof(uint64_t);
+}
+
+static void futex_wait(_Atomic uint32_t *word, uint32_t expected){
+    if(syscall(SYS_futex, word, FUTEX_WAIT, expected, NULL, NULL, 0) == -1
+       && errno != EAGAIN && errno != EINTR){
+        print_err_exit("futex", errno);
+    }
+}
+
+/*
+ * Called after publishing, wakes everyone sleeping on event. Clearing the
+ * flag means later calls skip the syscall until someone sleeps again.
+ */
+static inline void wake(_Atomic uint32_t *event, _Atomic uint32_t *sleeping){
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(sleeping, memory_order_relaxed) != 0
+       && atomic_exchange(sleeping, 0) != 0){
+        atomic_fetch_add(event, 1);
+        syscall(SYS_futex, event, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+/* sleeps on event unless the queue changes first, see ring_shared */
+static void sleep_on(Ring *ring, _Atomic uint32_t *event, _Atomic uint32_t *sleeping, int empty){
+    uint32_t seen = atomic_load(event);
+    atomic_store(sleeping, 1);
+    size_t count = ring_count(ring);
+    if(empty ? count == 0 : count > ring->mask){
+        futex_wait(event, seen);
+    }
+}
+
+/* fills in the process local part from a mapping */
+static Ring *attach(struct ring_shared *shared, size_t map_size){
+    Ring *ring = sec_malloc(sizeof(Ring));
+    ring->shared = shared;
+    ring->slots = shared->slots;
+    ring->map_size = map_size;
+    ring->mask = shared->capacity - 1;
+    ring->msg_size = shared->msg_size;
+    ring->mode = shared->mode;
+    ring->slot_stride = stride(ring->msg_size, ring->mode);
+    ring->head_cache = atomic_load(&shared->head);
+    ring->tail_cache = atomic_load(&shared->tail);
+    return ring;
+}
+
+/**
+ * Creates a queue in a new shared memory object. Without a name the object
+ * is anonymous and only reaches the children forked afterwards; with one
+ * it appears under /dev/shm until ring_unlink.
+ *
+ * @param name The shm_open name, "/something", or NULL.
+ * @param msg_size The size of every message, at least 1.
+ * @param capacity The number of messages the queue holds, rounded up to a
+ *                 power of two.
+ * @param mode RING_SPSC or RING_MPMC.
+ *
+ * @returns The queue.
+ */
+Ring *ring_create(const char *name, size_t msg_size, size_t capacity, int mode){
+    if(msg_size == 0 || capacity == 0 || (mode != RING_SPSC && mode != RING_MPMC)){
+        print(STDERR_FILENO, "Error: invalid ring parameters\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t slots = 2;
+    while(slots < capacity){
+        slots *= 2;
+    }
+    size_t map_size = sizeof(struct ring_shared) + slots * stride(msg_size, mode);
+
+    int fd;
+    if(name == NULL){
+        if((fd = memfd_create("ring", MFD_CLOEXEC)) == -1){
+            print_err_exit("memfd_create", errno);
+        }
+    }else if((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1){
+        print_err_exit("shm_open", errno);
+    }
+    if(ftruncate(fd, map_size) == -1){
+        print_err_exit("ftruncate", errno);
+    }
+    struct ring_shared *shared = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(shared == MAP_FAILED){
+        print_err_exit("mmap", errno);
+    }
+    close(fd);
+
+    /* the object starts zeroed */
+    shared->msg_size = msg_size;
+    shared->capacity = slots;
+    shared->mode = mode;
+    Ring *ring = attach(shared, map_size);
+    if(mode == RING_MPMC){
+        for(uint64_t i = 0; i < slots; i ++){
+            atomic_init(seq(ring, i), i);
+        }
+    }
+    atomic_store_explicit((_Atomic uint64_t *) &shared->magic, RING_MAGIC, memory_order_release);
+    return ring;
+}
+
+/**
+ * Attaches to a named queue made by ring_create in another process.
+ *
+ * @param name The name the queue was created with.
+ *
+ * @returns The queue, or NULL if it does not exist or is not initialized yet.
+ */
+Ring *ring_open(const char *name){
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd == -1){
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == -1){
+        print_err_exit("fstat", errno);
+    }
+    if((size_t) st.st_size < sizeof(struct ring_shared)){
+        close(fd);
+        return NULL;
+    }
+    struct ring_shared *shared = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(shared == MAP_FAILED){
+        print_err_exit("mmap", errno);
+    }
+    close(fd);
+    if(atomic_load_explicit((_Atomic uint64_t *) &shared->magic, memory_order_acquire) != RING_MAGIC){
+        munmap(shared, st.st_size);
+        return NULL;
+    }
+    return attach(shared, st.st_size);
+}
+
+/**
+ * Detaches this process from a queue. The memory goes away once every
+ * process has closed it and, if it is named, it has been unlinked.
+ *
+ * @param ring The queue.
+ *
+ * @returns None
+ */
+void ring_close(Ring *ring){
+    munmap(ring->shared, ring->map_size);
+    sec_free(ring);
+}
+
+/**
+ * Removes the name of a queue, processes attached to it keep using it.
+ *
+ * @param name The name the queue was created with.
+ *
+ * @returns None
+ */
+void ring_unlink(const char *name){
+    if(shm_unlink(name) == -1){
+        print_err_exit("shm_unlink", errno);
+    }
+}
+
+/* copies count messages between msgs and the slots from pos, across the wrap */
+static void spsc_copy(Ring *ring, uint64_t pos, void *msgs, size_t count, int in){
+    size_t first = ring->mask + 1 - (pos & ring->mask);
+    first = first < count ? first : count;
+    byte *at = ring->slots + (pos & ring->mask) * ring->msg_size;
+    if(in){
+        memcpy(at, msgs, first * ring->msg_size);
+        memcpy(ring->slots, (byte *) msgs + first * ring->msg_size, (count - first) * ring->msg_size);
+    }else{
+        memcpy(msgs, at, first * ring->msg_size);
+        memcpy((byte *) msgs + first * ring->msg_size, ring->slots, (count - first) * ring->msg_size);
+    }
+}
+
+static size_t spsc_enqueue(Ring *ring, const void *msgs, size_t count){
+    struct ring_shared *s = ring->shared;
+    uint64_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    uint64_t capacity = ring->mask + 1;
+    if(capacity - (head - ring->tail_cache) < count){
+        ring->tail_cache = atomic_load_explicit(&s->tail, memory_order_acquire);
+    }
+    size_t room = capacity - (head - ring->tail_cache);
+    count = count < room ? count : room;
+    if(count > 0){
+        spsc_copy(ring, head, (void *) msgs, count, 1);
+        atomic_store_explicit(&s->head, head + count, memory_order_release);
+    }
+    return count;
+}
+
+static size_t spsc_dequeue(Ring *ring, void *msgs, size_t max){
+    struct ring_shared *s = ring->shared;
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    if(ring->head_cache - tail < max){
+        ring->head_cache = atomic_load_explicit(&s->head, memory_order_acquire);
+    }
+    size_t avail = ring->head_cache - tail;
+    max = max < avail ? max : avail;
+    if(max > 0){
+        spsc_copy(ring, tail, msgs, max, 0);
+        atomic_store_explicit(&s->tail, tail + max, memory_order_release);
+    }
+    return max;
+}
+
+/*
+ * MPMC: a batch claims a run of positions with one CAS on the index, and
+ * then fills (drains) each slot once its sequence number says the other
+ * side is done with it. The bound on the run comes from the other index,
+ * read after ours. Our index may be stale by then, with the other side
+ * already past it, which shows as a negative distance and is retried
+ * rather than taken for a full (empty) ring; a CAS that succeeds means
+ * the run really was free (full).
+ */
+static size_t mpmc_enqueue(Ring *ring, const void *msgs, size_t count){
+    struct ring_shared *s = ring->shared;
+    uint64_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+    size_t n;
+    for(;;){
+        uint64_t tail = atomic_load_explicit(&s->tail, memory_order_acquire);
+        /* consumers drained past a stale head: reread it, the ring is not full */
+        if((int64_t) (head - tail) < 0){
+            head = atomic_load_explicit(&s->head, memory_order_relaxed);
+            continue;
+        }
+        uint64_t used = head - tail;
+        if(used > ring->mask){
+            return 0;
+        }
+        n = ring->mask + 1 - used;
+        n = count < n ? count : n;
+        if(atomic_compare_exchange_weak_explicit(&s->head, &head, head + n,
+                                                 memory_order_relaxed, memory_order_relaxed)){
+            break;
+        }
+    }
+    for(size_t i = 0; i < n; i ++){
+        uint64_t pos = head + i;
+        await_seq(seq(ring, pos), pos);
+        memcpy(msg(ring, pos), (const byte *) msgs + i * ring->msg_size, ring->msg_size);
+        atomic_store_explicit(seq(ring, pos), pos + 1, memory_order_release);
+    }
+    return n;
+}
+
+static size_t mpmc_dequeue(Ring *ring, void *msgs, size_t max){
+    struct ring_shared *s = ring->shared;
+    uint64_t tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+    size_t n;
+    do{
+        uint64_t head = atomic_load_explicit(&s->head, memory_order_acquire);
+        if((int64_t) (head - tail) <= 0){
+            return 0;
+        }
+        n = head - tail;
+        n = max < n ? max : n;
+    }while(!atomic_compare_exchange_weak_explicit(&s->tail, &tail, tail + n,
+                                                  memory_order_relaxed, memory_order_relaxed));
+    for(size_t i = 0; i < n; i ++){
+        uint64_t pos = tail + i;
+        await_seq(seq(ring, pos), pos + 1);
+        memcpy((byte *) msgs + i * ring->msg_size, msg(ring, pos), ring->msg_size);
+        atomic_store_explicit(seq(ring, pos), pos + ring->mask + 1, memory_order_release);
+    }
+    return n;
+}
+
+/**
+ * Adds as many of the messages as fit without waiting.
+ *
+ * @param ring The queue.
+ * @param msgs The messages, count * msg_size bytes.
+ * @param count The number of messages.
+ *
+ * @returns The number of messages added, from the start of msgs.
+ */
+size_t ring_enqueue(Ring *ring, const void *msgs, size_t count){
+    size_t n = ring->mode == RING_SPSC ? spsc_enqueue(ring, msgs, count)
+                                       : mpmc_enqueue(ring, msgs, count);
+    if(n > 0){
+        wake(&ring->shared->data_event, &ring->shared->data_sleeping);
+    }
+    return n;
+}
+
+/**
+ * Takes up to max messages without waiting.
+ *
+ * @param ring The queue.
+ * @param msgs Receives the messages, room for max * msg_size bytes.
+ * @param max The most messages to take.
+ *
+ * @returns The number of messages taken, 0 if the queue was empty.
+ */
+size_t ring_dequeue(Ring *ring, void *msgs, size_t max){
+    size_t n = ring->mode == RING_SPSC ? spsc_dequeue(ring, msgs, max)
+                                       : mpmc_dequeue(ring, msgs, max);
+    if(n > 0){
+        wake(&ring->shared->space_event, &ring->shared->space_sleeping);
+    }
+    return n;
+}
+
+/**
+ * Returns how many messages are in a queue, or being written or read.
+ *
+ * @param ring The queue.
+ *
+ * @returns The number of messages.
+ */
+size_t ring_count(Ring *ring){
+    uint64_t tail = atomic_load(&ring->shared->tail);
+    uint64_t head = atomic_load(&ring->shared->head);
+    int64_t n = head - tail;
+    return n < 0 ? 0 : ((uint64_t) n > ring->mask + 1 ? ring->mask + 1 : (size_t) n);
+}
+
+/**
+ * Adds all the messages, sleeping while the queue is full.
+ *
+ * @param ring The queue.
+ * @param msgs The messages, count * msg_size bytes.
+ * @param count The number of messages.
+ *
+ * @returns None
+ */
+void ring_enqueue_wait(Ring *ring, const void *msgs, size_t count){
+    struct ring_shared *s = ring->shared;
+    for(int spins = 0; count > 0; ){
+        size_t n = ring_enqueue(ring, msgs, count);
+        msgs = (const byte *) msgs + n * ring->msg_size;
+        count -= n;
+        if(n > 0 || count == 0){
+            spins = 0;
+            continue;
+        }
+        if(++ spins < SPIN){
+            cpu_relax();
+            continue;
+        }
+        sleep_on(ring, &s->space_event, &s->space_sleeping, 0);
+        spins = 0;
+    }
+}
+
+/**
+ * Takes at least one and up to max messages, sleeping while the queue is
+ * empty.
+ *
+ * @param ring The queue.
+ * @param msgs Receives the messages, room for max * msg_size bytes.
+ * @param max The most messages to take, at least 1.
+ *
+ * @returns The number of messages taken.
+ */
+size_t ring_dequeue_wait(Ring *ring, void *msgs, size_t max){
+    struct ring_shared *s = ring->shared;
+    for(int spins = 0; ; ){
+        size_t n = ring_dequeue(ring, msgs, max);
+        if(n > 0){
+            return n;
+        }
+        if(++ spins < SPIN){
+            cpu_relax();
+            continue;
+        }
+        sleep_on(ring, &s->data_event, &s->data_sleeping, 1);
+        spins = 0;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/* ring modes */
+#define RING_SPSC 0 /* one producer process and one consumer process */
+#define RING_MPMC 1 /* any number of each */
+
+struct ring_shared;
+
+/**
+ * A bounded queue of fixed size messages in shared memory. Create it
+ * before sys_fork and the children inherit it, or give it a name and
+ * attach from unrelated processes with ring_open.
+ *
+ * @param shared The queue state and slots, mapped MAP_SHARED.
+ * @param slots The first slot, inside shared.
+ * @param map_size The size of the mapping.
+ * @param mask The number of slots minus one.
+ * @param slot_stride The distance between slots.
+ * @param msg_size The size of a message.
+ * @param mode RING_SPSC or RING_MPMC.
+ * @param head_cache This process's last view of the producer index, so an
+ *                   SPSC consumer only reads the shared one when it looks empty.
+ * @param tail_cache This process's last view of the consumer index, likewise
+ *                   for an SPSC producer.
+ */
+struct ring {
+    struct ring_shared *shared;
+    byte *slots;
+    size_t map_size;
+    uint64_t mask;
+    size_t slot_stride;
+    size_t msg_size;
+    int mode;
+    uint64_t head_cache;
+    uint64_t tail_cache;
+};
+typedef struct ring Ring;
+
+/* function prototypes */
+Ring *ring_create(const char *name, size_t msg_size, size_t capacity, int mode);
+Ring *ring_open(const char *name);
+void ring_close(Ring *ring);
+void ring_unlink(const char *name);
+size_t ring_enqueue(Ring *ring, const void *msgs, size_t count);
+size_t ring_dequeue(Ring *ring, void *msgs, size_t max);
+void ring_enqueue_wait(Ring *ring, const void *msgs, size_t count);
+size_t ring_dequeue_wait(Ring *ring, void *msgs, size_t max);
+size_t ring_count(Ring *ring);
+
+#endif
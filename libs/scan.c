@@ -0,0 +1,468 @@
+#include "scan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+typedef const byte *(*find_byte_fn)(const byte *p, size_t n, byte c);
+typedef const byte *(*find_any_fn)(const byte *p, size_t n, const ByteSet *set);
+typedef const byte *(*find_sub_fn)(const byte *p, size_t n, const byte *needle, size_t nlen);
+
+static const byte *find_byte_scalar(const byte *p, size_t n, byte c);
+static const byte *find_any_scalar(const byte *p, size_t n, const ByteSet *set);
+static const byte *find_sub_scalar(const byte *p, size_t n, const byte *needle, size_t nlen);
+
+/* resolved once at load time from the CPU features, see select_impl */
+static find_byte_fn find_byte = find_byte_scalar;
+static find_any_fn find_any = find_any_scalar;
+static find_sub_fn find_sub = find_sub_scalar;
+static const char *impl_name = "scalar";
+
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+/* scalar: eight bytes at a time, a zero byte of x ^ c marks a match */
+static const byte *find_byte_scalar(const byte *p, size_t n, byte c){
+    const byte *end = p + n;
+    uint64_t pattern = ONES * c;
+    while(end - p >= 8){
+        uint64_t w;
+        memcpy(&w, p, 8);
+        w ^= pattern;
+        uint64_t hit = (w - ONES) & ~w & HIGHS;
+        if(hit){
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return p + (__builtin_ctzll(hit) >> 3);
+#else
+            return p + (__builtin_clzll(hit) >> 3);
+#endif
+        }
+        p += 8;
+    }
+    for(; p < end; p ++){
+        if(*p == c){
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const byte *find_any_scalar(const byte *p, size_t n, const ByteSet *set){
+    for(const byte *end = p + n; p < end; p ++){
+        if(set->bits[*p >> 3] & (1 << (*p & 7))){
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const byte *find_sub_scalar(const byte *p, size_t n, const byte *needle, size_t nlen){
+    if(nlen > n){
+        return NULL;
+    }
+    const byte *last = p + n - nlen;
+    while(p <= last){
+        p = find_byte(p, last - p + 1, needle[0]);
+        if(p == NULL){
+            return NULL;
+        }
+        if(memcmp(p + 1, needle + 1, nlen - 1) == 0){
+            return p;
+        }
+        p ++;
+    }
+    return NULL;
+}
+
+#ifdef HAVE_X86_SIMD
+/* SSE2 is part of the x86-64 baseline */
+static const byte *find_byte_sse2(const byte *p, size_t n, byte c){
+    const byte *end = p + n;
+    __m128i v = _mm_set1_epi8((char) c);
+    while(end - p >= 16){
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), v));
+        if(m){
+            return p + __builtin_ctz(m);
+        }
+        p += 16;
+    }
+    return find_byte_scalar(p, end - p, c);
+}
+
+/* compares against every member, worth it for small sets only */
+static const byte *find_any_sse2(const byte *p, size_t n, const ByteSet *set){
+    if(set->count > 16){
+        return find_any_scalar(p, n, set);
+    }
+    const byte *end = p + n;
+    __m128i members[16];
+    for(int i = 0; i < set->count; i ++){
+        members[i] = _mm_set1_epi8((char) set->list[i]);
+    }
+    while(end - p >= 16){
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i hit = _mm_setzero_si128();
+        for(int i = 0; i < set->count; i ++){
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, members[i]));
+        }
+        unsigned m = _mm_movemask_epi8(hit);
+        if(m){
+            return p + __builtin_ctz(m);
+        }
+        p += 16;
+    }
+    return find_any_scalar(p, end - p, set);
+}
+
+/* filters candidates on the first and last needle byte, 16 positions at a time */
+static const byte *find_sub_sse2(const byte *p, size_t n, const byte *needle, size_t nlen){
+    __m128i first = _mm_set1_epi8((char) needle[0]);
+    __m128i last = _mm_set1_epi8((char) needle[nlen - 1]);
+    size_t i = 0;
+    for(; i + nlen - 1 + 16 <= n; i += 16){
+        __m128i a = _mm_loadu_si128((const __m128i *) (p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + i + nlen - 1));
+        unsigned m = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while(m){
+            size_t at = i + __builtin_ctz(m);
+            if(memcmp(p + at + 1, needle + 1, nlen - 2) == 0){
+                return p + at;
+            }
+            m &= m - 1;
+        }
+    }
+    return find_sub_scalar(p + i, n - i, needle, nlen);
+}
+
+__attribute__((target("avx2")))
+static const byte *find_byte_avx2(const byte *p, size_t n, byte c){
+    const byte *end = p + n;
+    __m256i v = _mm256_set1_epi8((char) c);
+    while(end - p >= 64){
+        __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), v);
+        __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + 32)), v);
+        if(!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b))){
+            unsigned ma = _mm256_movemask_epi8(a);
+            if(ma){
+                return p + __builtin_ctz(ma);
+            }
+            return p + 32 + __builtin_ctz((unsigned) _mm256_movemask_epi8(b));
+        }
+        p += 64;
+    }
+    while(end - p >= 32){
+        unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), v));
+        if(m){
+            return p + __builtin_ctz(m);
+        }
+        p += 32;
+    }
+    return find_byte_sse2(p, end - p, c);
+}
+
+/*
+ * Exact membership for any set in four shuffles: the low nibble indexes a
+ * table of which high nibbles (mod 8) are members, one table for bytes
+ * below 0x80 and one for the rest (pshufb yields 0 for indices with the top
+ * bit set, which selects between them), and the high nibble picks the bit.
+ */
+__attribute__((target("avx2")))
+static const byte *find_any_avx2(const byte *p, size_t n, const ByteSet *set){
+    const byte *end = p + n;
+    __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) set->lo));
+    __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) set->hi));
+    __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                    1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i top = _mm256_set1_epi8(-128);
+    __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i zero = _mm256_setzero_si256();
+    while(end - p >= 32){
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        __m256i rows = _mm256_or_si256(_mm256_shuffle_epi8(lo, v),
+                                       _mm256_shuffle_epi8(hi, _mm256_xor_si256(v, top)));
+        __m256i col = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        unsigned m = ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(rows, col), zero));
+        if(m){
+            return p + __builtin_ctz(m);
+        }
+        p += 32;
+    }
+    return find_any_scalar(p, end - p, set);
+}
+
+__attribute__((target("avx2")))
+static const byte *find_sub_avx2(const byte *p, size_t n, const byte *needle, size_t nlen){
+    __m256i first = _mm256_set1_epi8((char) needle[0]);
+    __m256i last = _mm256_set1_epi8((char) needle[nlen - 1]);
+    size_t i = 0;
+    for(; i + nlen - 1 + 32 <= n; i += 32){
+        __m256i a = _mm256_loadu_si256((const __m256i *) (p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (p + i + nlen - 1));
+        unsigned m = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                           _mm256_cmpeq_epi8(b, last)));
+        while(m){
+            size_t at = i + __builtin_ctz(m);
+            if(memcmp(p + at + 1, needle + 1, nlen - 2) == 0){
+                return p + at;
+            }
+            m &= m - 1;
+        }
+    }
+    return find_sub_scalar(p + i, n - i, needle, nlen);
+}
+#endif
+
+/* picks the widest implementation the CPU supports, SCAN_IMPL=scalar|sse2 caps it */
+__attribute__((constructor))
+static void select_impl(void){
+#ifdef HAVE_X86_SIMD
+    const char *cap = getenv("SCAN_IMPL");
+    if(cap != NULL && strcmp(cap, "scalar") == 0){
+        return;
+    }
+    find_byte = find_byte_sse2;
+    find_any = find_any_sse2;
+    find_sub = find_sub_sse2;
+    impl_name = "sse2";
+    if(cap != NULL && strcmp(cap, "sse2") == 0){
+        return;
+    }
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        find_byte = find_byte_avx2;
+        find_any = find_any_avx2;
+        find_sub = find_sub_avx2;
+        impl_name = "avx2";
+    }
+#endif
+}
+
+/**
+ * Returns the name of the implementation in use: "avx2", "sse2" or "scalar".
+ *
+ * @returns The name.
+ */
+const char *scan_impl(void){
+    return impl_name;
+}
+
+/**
+ * Prepares a set of bytes for scan_any.
+ *
+ * @param set The set to fill.
+ * @param bytes The members, duplicates are fine.
+ * @param n The number of bytes in members.
+ *
+ * @returns None
+ */
+void scan_set_init(ByteSet *set, const void *bytes, size_t n){
+    const byte *b = bytes;
+    memset(set, 0, sizeof(ByteSet));
+    for(size_t i = 0; i < n; i ++){
+        byte c = b[i];
+        if(set->bits[c >> 3] & (1 << (c & 7))){
+            continue;
+        }
+        set->bits[c >> 3] |= 1 << (c & 7);
+        if(c < 0x80){
+            set->lo[c & 0x0f] |= 1 << ((c >> 4) & 7);
+        }else{
+            set->hi[c & 0x0f] |= 1 << ((c >> 4) & 7);
+        }
+        if(set->count < 16){
+            set->list[set->count] = c;
+        }
+        set->count ++;
+    }
+}
+
+/**
+ * Finds the first occurrence of a byte.
+ *
+ * @param data The memory to search.
+ * @param size The number of bytes to search.
+ * @param c The byte to find.
+ *
+ * @returns A pointer to the first match, or NULL.
+ */
+const void *scan_byte(const void *data, size_t size, byte c){
+    return find_byte(data, size, c);
+}
+
+/**
+ * Finds the first byte that is a member of a set.
+ *
+ * @param data The memory to search.
+ * @param size The number of bytes to search.
+ * @param set The set, prepared with scan_set_init.
+ *
+ * @returns A pointer to the first match, or NULL.
+ */
+const void *scan_any(const void *data, size_t size, const ByteSet *set){
+    return find_any(data, size, set);
+}
+
+/**
+ * Finds the first occurrence of a byte string.
+ *
+ * @param data The memory to search.
+ * @param size The number of bytes to search.
+ * @param needle The string to find.
+ * @param nlen The length of the string, an empty string matches at data.
+ *
+ * @returns A pointer to the first match, or NULL.
+ */
+const void *scan_sub(const void *data, size_t size, const void *needle, size_t nlen){
+    if(nlen == 0){
+        return data;
+    }
+    if(nlen > size){
+        return NULL;
+    }
+    if(nlen == 1){
+        return find_byte(data, size, *(const byte *) needle);
+    }
+    return find_sub(data, size, needle, nlen);
+}
+
+/* converts a match inside buff to an index */
+static ssize_t index_of(Buffer *buff, const void *match){
+    return match ? (const byte *) match - (const byte *) buff->body : -1;
+}
+
+/**
+ * Finds a byte in a buffer.
+ *
+ * @param buff The buffer.
+ * @param from The index to start searching at.
+ * @param c The byte to find.
+ *
+ * @returns The index of the first match at or after from, or -1.
+ */
+ssize_t buff_find_byte(Buffer *buff, size_t from, byte c){
+    if(from >= buff->size){
+        return -1;
+    }
+    return index_of(buff, scan_byte((byte *) buff->body + from, buff->size - from, c));
+}
+
+/**
+ * Finds any byte of a set in a buffer.
+ *
+ * @param buff The buffer.
+ * @param from The index to start searching at.
+ * @param set The set, prepared with scan_set_init.
+ *
+ * @returns The index of the first match at or after from, or -1.
+ */
+ssize_t buff_find_any(Buffer *buff, size_t from, const ByteSet *set){
+    if(from >= buff->size){
+        return -1;
+    }
+    return index_of(buff, scan_any((byte *) buff->body + from, buff->size - from, set));
+}
+
+/**
+ * Finds a byte string in a buffer.
+ *
+ * @param buff The buffer.
+ * @param from The index to start searching at.
+ * @param needle The string to find.
+ * @param nlen The length of the string.
+ *
+ * @returns The index of the first match at or after from, or -1.
+ */
+ssize_t buff_find_sub(Buffer *buff, size_t from, const void *needle, size_t nlen){
+    if(from > buff->size){
+        return -1;
+    }
+    return index_of(buff, scan_sub((byte *) buff->body + from, buff->size - from, needle, nlen));
+}
+
+/**
+ * Starts splitting a buffer on a set of separator bytes.
+ *
+ * With skip_empty 0 every separator ends a field, so adjacent separators
+ * give empty fields and n separators always give n + 1 fields. With
+ * skip_empty set, runs of separators count as one and empty fields are
+ * never returned, which tokenizes.
+ *
+ * @param it The iterator.
+ * @param buff The buffer to split.
+ * @param delims The separator bytes as a string.
+ * @param skip_empty Whether to skip empty fields.
+ *
+ * @returns None
+ */
+void buff_split_init(BuffSplit *it, Buffer *buff, const char *delims, int skip_empty){
+    it->pos = buff->body;
+    it->end = (byte *) buff->body + buff->size;
+    scan_set_init(&it->set, delims, strlen(delims));
+    it->skip_empty = skip_empty;
+    it->done = 0;
+}
+
+/**
+ * Returns the next field.
+ *
+ * @param it The iterator.
+ * @param field Receives a view of the field, without the separator.
+ *
+ * @returns 1 if a field was returned, 0 at the end.
+ */
+int buff_split_next(BuffSplit *it, BuffView *field){
+    while(!it->done){
+        const byte *sep = scan_any(it->pos, it->end - it->pos, &it->set);
+        const byte *stop = sep ? sep : it->end;
+        field->ptr = it->pos;
+        field->len = stop - it->pos;
+        if(sep){
+            it->pos = sep + 1;
+        }else{
+            it->pos = it->end;
+            it->done = 1;
+        }
+        if(field->len > 0 || !it->skip_empty){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Starts iterating over the lines of a buffer.
+ *
+ * @param it The iterator.
+ * @param buff The buffer.
+ *
+ * @returns None
+ */
+void buff_lines_init(BuffLines *it, Buffer *buff){
+    it->pos = buff->body;
+    it->end = (byte *) buff->body + buff->size;
+}
+
+/**
+ * Returns the next line. Lines end at '\n', a preceding '\r' is dropped as
+ * well, and a final line without a newline is returned too.
+ *
+ * @param it The iterator.
+ * @param line Receives a view of the line without its terminator.
+ *
+ * @returns 1 if a line was returned, 0 at the end.
+ */
+int buff_lines_next(BuffLines *it, BuffView *line){
+    if(it->pos >= it->end){
+        return 0;
+    }
+    const byte *nl = scan_byte(it->pos, it->end - it->pos, '\n');
+    const byte *stop = nl ? nl : it->end;
+    line->ptr = it->pos;
+    line->len = stop - it->pos;
+    if(nl && line->len > 0 && stop[-1] == '\r'){
+        line->len --;
+    }
+    it->pos = nl ? nl + 1 : it->end;
+    return 1;
+}
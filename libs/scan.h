@@ -0,0 +1,71 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/**
+ * A set of bytes prepared for scan_any.
+ *
+ * @param bits A 256-bit membership bitmap, used by the scalar path.
+ * @param lo Per low nibble, which (b >> 4) & 7 values are members for
+ *           bytes below 0x80, used by the SIMD path.
+ * @param hi The same for bytes from 0x80 up.
+ * @param list The members, when there are at most 16 of them.
+ * @param count The number of members.
+ */
+struct byte_set {
+    uint8_t bits[32];
+    uint8_t lo[16];
+    uint8_t hi[16];
+    byte list[16];
+    int count;
+};
+typedef struct byte_set ByteSet;
+
+/**
+ * Iterates over the fields of a buffer separated by any of a set of bytes.
+ *
+ * @param pos The start of the next field.
+ * @param end The end of the buffer contents.
+ * @param set The separators.
+ * @param skip_empty Nonzero to skip empty fields, as tokenizers do.
+ * @param done Nonzero once the last field has been returned.
+ */
+struct buff_split {
+    const byte *pos;
+    const byte *end;
+    ByteSet set;
+    int skip_empty;
+    int done;
+};
+typedef struct buff_split BuffSplit;
+
+/**
+ * Iterates over the lines of a buffer.
+ *
+ * @param pos The start of the next line.
+ * @param end The end of the buffer contents.
+ */
+struct buff_lines {
+    const byte *pos;
+    const byte *end;
+};
+typedef struct buff_lines BuffLines;
+
+/* function prototypes */
+void scan_set_init(ByteSet *set, const void *bytes, size_t n);
+const void *scan_byte(const void *data, size_t size, byte c);
+const void *scan_any(const void *data, size_t size, const ByteSet *set);
+const void *scan_sub(const void *data, size_t size, const void *needle, size_t nlen);
+const char *scan_impl(void);
+
+ssize_t buff_find_byte(Buffer *buff, size_t from, byte c);
+ssize_t buff_find_any(Buffer *buff, size_t from, const ByteSet *set);
+ssize_t buff_find_sub(Buffer *buff, size_t from, const void *needle, size_t nlen);
+void buff_split_init(BuffSplit *it, Buffer *buff, const char *delims, int skip_empty);
+int buff_split_next(BuffSplit *it, BuffView *field);
+void buff_lines_init(BuffLines *it, Buffer *buff);
+int buff_lines_next(BuffLines *it, BuffView *line);
+
+#endif
@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+#include "secheap.h"
+#include "buffer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/*
+ * The secure heap is a single region, locked in memory, left out of core
+ * dumps and fenced by an inaccessible page on each side, reserved once so
+ * that the cost of mlock and mprotect is not paid per allocation. It is a
+ * buddy allocator: blocks are powers of two from SECHEAP_MIN up, each
+ * aligned to its own size from the start of the region, with a free list
+ * per class threaded through the free blocks. A block is split in halves
+ * until it fits a request, and a freed block merges with its buddy, the
+ * other half of the block it was split from, whenever that is free too,
+ * so a heap emptied of small keys can serve large ones again. The class
+ * of every block, and whether it is free, is kept in a side table outside
+ * the region, one byte per SECHEAP_MIN bytes, written at the first byte
+ * of each block and zero elsewhere, so nothing but the free list links is
+ * stored among the secrets.
+ */
+
+#define CLASSES 48
+/* set in the side table for a free block */
+#define FREE 0x80
+
+/* the links of a free block, stored at its start */
+struct free_block {
+    struct free_block *next;
+    struct free_block *prev;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+/* the usable region, 0 sized while there is none */
+static _Atomic uintptr_t base;
+static _Atomic size_t size;
+static size_t page;
+static struct free_block *free_lists[CLASSES];
+static uint8_t *classes;
+static size_t used;
+
+/* the class of the smallest block that holds size bytes */
+static int class_of(size_t request){
+    if(request <= SECHEAP_MIN){
+        return 0;
+    }
+    return 64 - __builtin_clzll(request - 1) - __builtin_ctz(SECHEAP_MIN);
+}
+
+static inline size_t class_size(int c){
+    return (size_t) SECHEAP_MIN << c;
+}
+
+/* the offset of a block from the start of the region */
+static inline size_t offset_of(const void *block){
+    return (uintptr_t) block - atomic_load_explicit(&base, memory_order_relaxed);
+}
+
+/* puts a block on the free list of class c, called with the lock held */
+static void push_free(byte *ptr, int c){
+    struct free_block *block = (struct free_block *) ptr;
+    block->prev = NULL;
+    block->next = free_lists[c];
+    if(block->next != NULL){
+        block->next->prev = block;
+    }
+    free_lists[c] = block;
+    classes[offset_of(ptr) / SECHEAP_MIN] = FREE | c;
+}
+
+/* takes a block off the free list of class c, called with the lock held */
+static void unlink_free(struct free_block *block, int c){
+    if(block->prev != NULL){
+        block->prev->next = block->next;
+    }else{
+        free_lists[c] = block->next;
+    }
+    if(block->next != NULL){
+        block->next->prev = block->prev;
+    }
+    block->next = NULL;
+    block->prev = NULL;
+}
+
+/* a free block of class c, split from a larger one if needed, called with the lock held */
+static byte *take(int c){
+    for(int k = c; k < CLASSES; k ++){
+        struct free_block *found = free_lists[k];
+        if(found == NULL){
+            continue;
+        }
+        unlink_free(found, k);
+        byte *block = (byte *) found;
+        /* keep the lower half, free the upper halves */
+        while(k > c){
+            k --;
+            push_free(block + class_size(k), k);
+        }
+        classes[offset_of(block) / SECHEAP_MIN] = c;
+        return block;
+    }
+    return NULL;
+}
+
+/* frees a block of class c, merging it with free buddies, called with the lock held */
+static void give(byte *block, int c){
+    size_t region = atomic_load_explicit(&size, memory_order_relaxed);
+    size_t offset = offset_of(block);
+    while(c + 1 < CLASSES){
+        size_t buddy = offset ^ class_size(c);
+        if(buddy + class_size(c) > region || classes[buddy / SECHEAP_MIN] != (FREE | c)){
+            break;
+        }
+        byte *other = block + ((ptrdiff_t) buddy - (ptrdiff_t) offset);
+        unlink_free((struct free_block *) other, c);
+        /* the upper half stops being a block */
+        if(buddy < offset){
+            classes[offset / SECHEAP_MIN] = 0;
+            block = other;
+            offset = buddy;
+        }else{
+            classes[buddy / SECHEAP_MIN] = 0;
+        }
+        c ++;
+    }
+    push_free(block, c);
+}
+
+/**
+ * Reserves the secure heap. The region is locked in memory so it is never
+ * swapped out, excluded from core dumps, and has an inaccessible guard
+ * page on each side. It can only be set up once.
+ *
+ * @param request The size of the region, rounded up to whole pages.
+ *
+ * @returns 0 on success, -1 with errno set if the region could not be
+ *          mapped or locked, EBUSY if it already exists. Locking fails with
+ *          ENOMEM or EPERM when request exceeds RLIMIT_MEMLOCK.
+ */
+int secheap_init(size_t request){
+    pthread_mutex_lock(&lock);
+    if(atomic_load(&size) != 0){
+        pthread_mutex_unlock(&lock);
+        errno = EBUSY;
+        return -1;
+    }
+    page = sysconf(_SC_PAGESIZE);
+    request = request == 0 ? page : (request + page - 1) & ~(page - 1);
+
+    byte *map = mmap(NULL, request + 2 * page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(map == MAP_FAILED){
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    byte *region = map + page;
+    classes = mmap(NULL, request / SECHEAP_MIN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(classes == MAP_FAILED
+       || mprotect(region, request, PROT_READ | PROT_WRITE) == -1
+       || mlock(region, request) == -1){
+        int err = errno;
+        if(classes != MAP_FAILED){
+            munmap(classes, request / SECHEAP_MIN);
+        }
+        munmap(map, request + 2 * page);
+        pthread_mutex_unlock(&lock);
+        errno = err;
+        return -1;
+    }
+    madvise(map, request + 2 * page, MADV_DONTDUMP);
+
+    used = 0;
+    memset(free_lists, 0, sizeof(free_lists));
+    atomic_store(&base, (uintptr_t) region);
+    atomic_store(&size, request);
+    /* cover the region with the largest blocks aligned to their size */
+    for(size_t offset = 0; offset < request;){
+        int c = CLASSES - 1;
+        while(class_size(c) > request - offset || (offset & (class_size(c) - 1)) != 0){
+            c --;
+        }
+        push_free(region + offset, c);
+        offset += class_size(c);
+    }
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+/**
+ * Allocates a block from the secure heap.
+ *
+ * @param request The size of the block.
+ *
+ * @returns The block, zeroed and aligned to SECHEAP_MIN, or NULL with errno
+ *          set to ENOMEM if the heap is full or was never set up.
+ */
+void *secheap_alloc(size_t request){
+    int c = class_of(request);
+    pthread_mutex_lock(&lock);
+    byte *block = NULL;
+    if(c < CLASSES && atomic_load_explicit(&size, memory_order_relaxed) != 0){
+        block = take(c);
+    }
+    if(block != NULL){
+        used += class_size(c);
+    }
+    pthread_mutex_unlock(&lock);
+    if(block == NULL){
+        errno = ENOMEM;
+        return NULL;
+    }
+    /* free blocks are wiped but for their links */
+    memset(block, 0, sizeof(struct free_block));
+    return block;
+}
+
+/**
+ * Wipes and frees a block if it belongs to the secure heap.
+ *
+ * @param ptr The block, may be NULL or come from elsewhere.
+ *
+ * @returns 1 if the block was freed, 0 if it is not a secure heap block.
+ */
+int secheap_free(void *ptr){
+    if(!secheap_owns(ptr)){
+        return 0;
+    }
+    int c = classes[offset_of(ptr) / SECHEAP_MIN];
+    if(c & FREE){
+        print(STDERR_FILENO, "Error: secure heap block freed twice\n");
+        exit(EXIT_FAILURE);
+    }
+    explicit_bzero(ptr, class_size(c));
+    pthread_mutex_lock(&lock);
+    used -= class_size(c);
+    give(ptr, c);
+    pthread_mutex_unlock(&lock);
+    return 1;
+}
+
+/**
+ * Tells whether a pointer is in the secure heap.
+ *
+ * @param ptr The pointer.
+ *
+ * @returns 1 if it is, 0 otherwise.
+ */
+int secheap_owns(const void *ptr){
+    uintptr_t offset = (uintptr_t) ptr - atomic_load_explicit(&base, memory_order_relaxed);
+    return offset < atomic_load_explicit(&size, memory_order_relaxed);
+}
+
+/**
+ * Returns the bytes of the secure heap currently allocated, blocks
+ * counted at their rounded up size.
+ *
+ * @returns The allocated bytes.
+ */
+size_t secheap_used(void){
+    pthread_mutex_lock(&lock);
+    size_t n = used;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+/**
+ * Wipes and releases the secure heap. Blocks still allocated from it
+ * become invalid.
+ *
+ * @returns None
+ */
+void secheap_done(void){
+    pthread_mutex_lock(&lock);
+    size_t request = atomic_load(&size);
+    if(request != 0){
+        byte *region = (byte *) atomic_load(&base);
+        atomic_store(&size, 0);
+        atomic_store(&base, 0);
+        explicit_bzero(region, request);
+        munlock(region, request);
+        munmap(region - page, request + 2 * page);
+        munmap(classes, request / SECHEAP_MIN);
+        classes = NULL;
+    }
+    pthread_mutex_unlock(&lock);
+}
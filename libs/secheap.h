@@ -0,0 +1,17 @@
+#ifndef SECHEAP_H
+#define SECHEAP_H
+
+#include <stddef.h>
+
+/* the smallest block, every block is aligned to it */
+#define SECHEAP_MIN 16
+
+/* function prototypes */
+int secheap_init(size_t size);
+void *secheap_alloc(size_t size);
+int secheap_free(void *ptr);
+int secheap_owns(const void *ptr);
+size_t secheap_used(void);
+void secheap_done(void);
+
+#endif
@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+#include "serial.h"
+
+#include <poll.h>
+#include <sys/ioctl.h>
+
+/* the default number of bytes requested from the kernel per read */
+#define DEFAULT_CHUNK 4096
+
+#ifdef __linux__
+/* the kernel's termios2, which carries the speed in bits per second (BOTHER) */
+struct serial_termios2 {
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+};
+#define SERIAL_TCGETS2 _IOR('T', 0x2A, struct serial_termios2)
+#define SERIAL_TCSETS2 _IOW('T', 0x2B, struct serial_termios2)
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#endif
+
+/* the B* constants, anything else goes through BOTHER */
+static const struct {
+    unsigned int baud;
+    speed_t code;
+} speeds[] = {
+    { 50, B50 }, { 75, B75 }, { 110, B110 }, { 134, B134 }, { 150, B150 },
+    { 200, B200 }, { 300, B300 }, { 600, B600 }, { 1200, B1200 }, { 1800, B1800 },
+    { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 }, { 19200, B19200 },
+    { 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 }, { 230400, B230400 },
+#ifdef B460800
+    { 460800, B460800 }, { 500000, B500000 }, { 576000, B576000 }, { 921600, B921600 },
+    { 1000000, B1000000 }, { 1152000, B1152000 }, { 1500000, B1500000 },
+    { 2000000, B2000000 }, { 2500000, B2500000 }, { 3000000, B3000000 },
+    { 3500000, B3500000 }, { 4000000, B4000000 },
+#endif
+};
+
+/**
+ * Opens a tty and configures it as a raw 8N1 serial port.
+ *
+ * @param path The device, e.g. /dev/ttyUSB0.
+ * @param baud The line speed in bits per second, any value the driver
+ *             accepts, not only the standard rates.
+ * @param flags A combination of SERIAL_NONBLOCK and SERIAL_RTSCTS.
+ *
+ * @returns The port.
+ */
+SerialPort *serial_open(const char *path, unsigned int baud, int flags){
+    int fd = sys_open(path, O_RDWR | O_NOCTTY | ((flags & SERIAL_NONBLOCK) ? O_NONBLOCK : 0));
+    return serial_attach(fd, baud, flags);
+}
+
+/**
+ * Configures an already open tty as a raw 8N1 serial port. The port owns
+ * the descriptor from now on.
+ *
+ * @param fd The tty file descriptor.
+ * @param baud The line speed in bits per second.
+ * @param flags A combination of SERIAL_NONBLOCK and SERIAL_RTSCTS.
+ *
+ * @returns The port.
+ */
+SerialPort *serial_attach(int fd, unsigned int baud, int flags){
+    SerialPort *port = sec_malloc(sizeof(SerialPort));
+    struct termios tio;
+    port->fd = fd;
+    port->flags = flags;
+    port->rx = buff_init(DEFAULT_CHUNK * 2);
+    port->rx_pos = 0;
+    port->chunk = DEFAULT_CHUNK;
+    port->tx = buff_init(DEFAULT_CHUNK);
+
+    sys_tcgetattr(fd, &port->saved);
+    tio = port->saved;
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CSTOPB;
+    if(flags & SERIAL_RTSCTS){
+        tio.c_cflag |= CRTSCTS;
+    }else{
+        tio.c_cflag &= ~CRTSCTS;
+    }
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    sys_tcsetattr(fd, TCSANOW, &tio);
+    serial_set_speed(port, baud);
+    sys_tcflush(fd, TCIOFLUSH);
+    return port;
+}
+
+/**
+ * Opens a pseudo terminal pair and returns its slave end as a serial port,
+ * so code talking to a device can be exercised without hardware.
+ *
+ * @param peer Receives the master end, which plays the device.
+ *
+ * @returns The port.
+ */
+SerialPort *serial_open_pty(int *peer){
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master == -1 || grantpt(master) == -1 || unlockpt(master) == -1){
+        print_err_exit("posix_openpt", errno);
+    }
+    char *name = ptsname(master);
+    if(name == NULL){
+        print_err_exit("ptsname", errno);
+    }
+    *peer = master;
+    return serial_open(name, 115200, 0);
+}
+
+/**
+ * Restores the original tty attributes, closes the descriptor and frees the port.
+ *
+ * @param port The port.
+ *
+ * @returns None
+ */
+void serial_close(SerialPort *port){
+    tcsetattr(port->fd, TCSANOW, &port->saved);
+    sys_close(port->fd);
+    buff_free(port->rx);
+    buff_free(port->tx);
+    sec_free(port);
+}
+
+/**
+ * Changes the line speed. Standard rates use cfsetspeed, other rates are
+ * set in bits per second through the Linux termios2 interface.
+ *
+ * @param port The port.
+ * @param baud The line speed in bits per second.
+ *
+ * @returns None
+ */
+void serial_set_speed(SerialPort *port, unsigned int baud){
+    for(size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i ++){
+        if(speeds[i].baud == baud){
+            struct termios tio;
+            sys_tcgetattr(port->fd, &tio);
+            sys_cfsetspeed(&tio, speeds[i].code);
+            sys_tcsetattr(port->fd, TCSANOW, &tio);
+            port->baud = baud;
+            return;
+        }
+    }
+#ifdef __linux__
+    struct serial_termios2 tio2;
+    if(ioctl(port->fd, SERIAL_TCGETS2, &tio2) == -1){
+        print_err_exit("TCGETS2", errno);
+    }
+    tio2.c_cflag &= ~CBAUD;
+    tio2.c_cflag |= BOTHER;
+    tio2.c_ispeed = baud;
+    tio2.c_ospeed = baud;
+    if(ioctl(port->fd, SERIAL_TCSETS2, &tio2) == -1){
+        print_err_exit("TCSETS2", errno);
+    }
+    port->baud = baud;
+#else
+    print(STDERR_FILENO, "Error: unsupported serial speed %u\n", baud);
+    exit(EXIT_FAILURE);
+#endif
+}
+
+/**
+ * Sets the latency/throughput trade-off of blocking reads.
+ *
+ * A read returns once vmin bytes have arrived, or vtime tenths of a second
+ * after the last byte. vmin 0 and vtime 0 polls, a large vmin batches many
+ * bytes per syscall at the cost of latency, a small vtime bounds that
+ * latency. Ignored with SERIAL_NONBLOCK.
+ *
+ * @param port The port.
+ * @param vmin The minimum number of bytes per read.
+ * @param vtime The inter-byte timeout in tenths of a second.
+ *
+ * @returns None
+ */
+void serial_set_timing(SerialPort *port, byte vmin, byte vtime){
+    struct termios tio;
+    sys_tcgetattr(port->fd, &tio);
+    tio.c_cc[VMIN] = vmin;
+    tio.c_cc[VTIME] = vtime;
+    sys_tcsetattr(port->fd, TCSANOW, &tio);
+}
+
+/**
+ * Sets how many bytes each read asks for. Larger chunks mean fewer
+ * syscalls at high baud rates.
+ *
+ * @param port The port.
+ * @param chunk The read size in bytes.
+ *
+ * @returns None
+ */
+void serial_set_chunk(SerialPort *port, size_t chunk){
+    port->chunk = chunk ? chunk : DEFAULT_CHUNK;
+}
+
+/* moves the unconsumed bytes to the front of rx */
+static void compact(SerialPort *port){
+    Buffer *rx = port->rx;
+    size_t left = rx->size - port->rx_pos;
+    memmove(rx->body, (byte *) rx->body + port->rx_pos, left);
+    rx->size = left;
+    port->rx_pos = 0;
+}
+
+/**
+ * Reads whatever the driver has, up to one chunk, straight into the
+ * receive buffer.
+ *
+ * @param port The port.
+ *
+ * @returns The number of bytes read, 0 if nothing was available or the
+ *          VTIME timeout expired.
+ */
+ssize_t serial_read(SerialPort *port){
+    Buffer *rx = port->rx;
+    if(port->rx_pos == rx->size){
+        rx->size = 0;
+        port->rx_pos = 0;
+    }else if(port->rx_pos >= rx->size / 2 || rx->capacity - rx->size < port->chunk){
+        compact(port);
+    }
+    buff_reserve(rx, port->chunk);
+
+    ssize_t n = read(port->fd, (byte *) rx->body + rx->size, port->chunk);
+    if(n == -1){
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR){
+            return 0;
+        }
+        print_err_exit("read", errno);
+    }
+    rx->size += n;
+    return n;
+}
+
+/**
+ * Returns the number of received bytes not yet consumed.
+ *
+ * @param port The port.
+ *
+ * @returns The number of bytes.
+ */
+size_t serial_available(SerialPort *port){
+    return port->rx->size - port->rx_pos;
+}
+
+/**
+ * Returns the received bytes not yet consumed. The pointer is valid until
+ * the next serial_read.
+ *
+ * @param port The port.
+ *
+ * @returns The first unconsumed byte.
+ */
+void *serial_data(SerialPort *port){
+    return (byte *) port->rx->body + port->rx_pos;
+}
+
+/**
+ * Marks received bytes as consumed.
+ *
+ * @param port The port.
+ * @param n The number of bytes, at most serial_available.
+ *
+ * @returns None
+ */
+void serial_consume(SerialPort *port, size_t n){
+    size_t avail = serial_available(port);
+    port->rx_pos += n < avail ? n : avail;
+}
+
+/**
+ * Extracts the next SLIP frame from the received bytes. Empty frames, such
+ * as the END byte many senders put before each frame, are skipped.
+ *
+ * @param port The port.
+ * @param frame Receives the decoded frame, replacing its contents.
+ *
+ * @returns 1 if a frame was extracted, 0 if no complete frame has been
+ *          received yet, -1 if a frame with an invalid escape was dropped.
+ */
+int serial_next_frame(SerialPort *port, Buffer *frame){
+    byte *data, *end;
+    size_t avail;
+    for(;;){
+        data = serial_data(port);
+        avail = serial_available(port);
+        end = memchr(data, SLIP_END, avail);
+        if(end == NULL){
+            return 0;
+        }
+        if(end != data){
+            break;
+        }
+        serial_consume(port, 1);
+    }
+
+    frame->size = 0;
+    buff_reserve(frame, end - data);
+    int ok = 1;
+    byte *p = data;
+    while(p < end){
+        byte *esc = memchr(p, SLIP_ESC, end - p);
+        if(esc == NULL){
+            buff_append(frame, p, end - p);
+            break;
+        }
+        buff_append(frame, p, esc - p);
+        if(esc + 1 == end || (esc[1] != SLIP_ESC_END && esc[1] != SLIP_ESC_ESC)){
+            ok = 0;
+            break;
+        }
+        buff_append_byte(frame, esc[1] == SLIP_ESC_END ? SLIP_END : SLIP_ESC);
+        p = esc + 2;
+    }
+    serial_consume(port, end - data + 1);
+    if(!ok){
+        frame->size = 0;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * Writes all bytes, waiting for the driver when the port is non-blocking.
+ *
+ * @param port The port.
+ * @param data The bytes.
+ * @param size The number of bytes.
+ *
+ * @returns None
+ */
+void serial_write(SerialPort *port, const void *data, size_t size){
+    const byte *p = data;
+    while(size > 0){
+        ssize_t n = write(port->fd, p, size);
+        if(n == -1){
+            if(errno == EAGAIN || errno == EWOULDBLOCK){
+                struct pollfd pfd = { port->fd, POLLOUT, 0 };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            if(errno == EINTR){
+                continue;
+            }
+            print_err_exit("write", errno);
+        }
+        p += n;
+        size -= n;
+    }
+}
+
+/**
+ * SLIP-encodes a frame (END, payload with END and ESC escaped, END) and
+ * sends it with a single write.
+ *
+ * @param port The port.
+ * @param data The payload.
+ * @param size The payload size.
+ *
+ * @returns None
+ */
+void serial_write_frame(SerialPort *port, const void *data, size_t size){
+    Buffer *tx = port->tx;
+    const byte *p = data, *end = p + size;
+    tx->size = 0;
+    buff_reserve(tx, size * 2 + 2);
+    buff_append_byte(tx, SLIP_END);
+    while(p < end){
+        const byte *run = p;
+        while(p < end && *p != SLIP_END && *p != SLIP_ESC){
+            p ++;
+        }
+        buff_append(tx, (void *) run, p - run);
+        if(p < end){
+            buff_append_byte(tx, SLIP_ESC);
+            buff_append_byte(tx, *p == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC);
+            p ++;
+        }
+    }
+    buff_append_byte(tx, SLIP_END);
+    serial_write(port, tx->body, tx->size);
+}
@@ -0,0 +1,56 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "buffer.h"
+
+/* serial_open flags */
+#define SERIAL_NONBLOCK 1 /* reads return immediately instead of honoring VMIN/VTIME */
+#define SERIAL_RTSCTS 2   /* hardware flow control */
+
+/* SLIP framing bytes (RFC 1055) used by serial_next_frame and serial_write_frame */
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+/**
+ * A serial port in raw 8N1 mode with a receive buffer.
+ *
+ * @param fd The tty file descriptor.
+ * @param flags The serial_open flags.
+ * @param baud The configured line speed in bits per second.
+ * @param rx Bytes received and not yet consumed, starting at rx_pos.
+ * @param rx_pos The offset of the first unconsumed byte in rx.
+ * @param chunk The number of bytes each read asks the kernel for.
+ * @param tx Scratch space for encoding outgoing frames.
+ * @param saved The attributes to restore on serial_close.
+ */
+struct serial_port {
+    int fd;
+    int flags;
+    unsigned int baud;
+    Buffer *rx;
+    size_t rx_pos;
+    size_t chunk;
+    Buffer *tx;
+    struct termios saved;
+};
+typedef struct serial_port SerialPort;
+
+/* function prototypes */
+SerialPort *serial_open(const char *path, unsigned int baud, int flags);
+SerialPort *serial_attach(int fd, unsigned int baud, int flags);
+SerialPort *serial_open_pty(int *peer);
+void serial_close(SerialPort *port);
+void serial_set_speed(SerialPort *port, unsigned int baud);
+void serial_set_timing(SerialPort *port, byte vmin, byte vtime);
+void serial_set_chunk(SerialPort *port, size_t chunk);
+ssize_t serial_read(SerialPort *port);
+size_t serial_available(SerialPort *port);
+void *serial_data(SerialPort *port);
+void serial_consume(SerialPort *port, size_t n);
+int serial_next_frame(SerialPort *port, Buffer *frame);
+void serial_write(SerialPort *port, const void *data, size_t size);
+void serial_write_frame(SerialPort *port, const void *data, size_t size);
+
+#endif
@@ -0,0 +1,165 @@
+#include "slab.h"
+#include "memprof.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+/* the first object of a slab starts past the slab link, 16 byte aligned */
+#define SLAB_HEADER 16
+/* a slab holds at least this many objects */
+#define MIN_OBJECTS 8
+
+static void lock(SlabCache *cache){
+    while(atomic_flag_test_and_set_explicit(&cache->lock, memory_order_acquire)){
+        sched_yield();
+    }
+}
+
+static void unlock(SlabCache *cache){
+    atomic_flag_clear_explicit(&cache->lock, memory_order_release);
+}
+
+/* maps a new slab and makes it the one objects are carved from */
+static __attribute__((noinline, cold)) void grow(SlabCache *cache){
+    void *slab = mmap(NULL, cache->slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(slab == MAP_FAILED){
+        print_err_exit("mmap", errno);
+    }
+    *(void **) slab = cache->slabs;
+    cache->slabs = slab;
+    cache->bump = (byte *) slab + SLAB_HEADER;
+    cache->bump_end = (byte *) slab + cache->slab_size;
+    cache->stats.slabs ++;
+    cache->stats.slab_bytes += cache->slab_size;
+}
+
+/**
+ * Creates a cache for objects of one size. Objects are aligned like
+ * malloc would align an object of that size: to 16 bytes when the size is
+ * a multiple of 16, to 8 bytes otherwise.
+ *
+ * @param object_size The size of the objects.
+ * @param flags SLAB_ZERO_ON_FREE to wipe every object as it is freed,
+ *              SLAB_LOCKED to allow calls from several threads at once.
+ *
+ * @returns The cache.
+ */
+SlabCache *slab_create(size_t object_size, int flags){
+    size_t page = sysconf(_SC_PAGESIZE);
+    if(object_size < sizeof(void *)){
+        object_size = sizeof(void *);
+    }
+    object_size = (object_size + 7) & ~(size_t) 7;
+    size_t slab_size = SLAB_HEADER + MIN_OBJECTS * object_size;
+    slab_size = slab_size < page ? page : (slab_size + page - 1) & ~(page - 1);
+
+    SlabCache *cache = sec_calloc(1, sizeof(SlabCache));
+    cache->object_size = object_size;
+    cache->slab_size = slab_size;
+    cache->flags = flags;
+    atomic_flag_clear(&cache->lock);
+    cache->stats.object_size = object_size;
+    return cache;
+}
+
+/**
+ * Allocates an object from a cache. Its contents are undefined.
+ *
+ * @param cache The cache.
+ *
+ * @returns The object.
+ */
+void *slab_alloc(SlabCache *cache){
+    if(cache->flags & SLAB_LOCKED){
+        lock(cache);
+    }
+    void *object = cache->free;
+    if(object != NULL){
+        cache->free = *(void **) object;
+    }else{
+        if(cache->bump + cache->object_size > cache->bump_end){
+            grow(cache);
+        }
+        object = cache->bump;
+        cache->bump += cache->object_size;
+    }
+    cache->stats.allocs ++;
+    cache->stats.in_use ++;
+    if(cache->flags & SLAB_LOCKED){
+        unlock(cache);
+    }
+    if(memprof_active){
+        memprof_alloc(object, cache->object_size, __builtin_return_address(0));
+    }
+    return object;
+}
+
+/**
+ * Returns an object to its cache, wiping it first if the cache was created
+ * with SLAB_ZERO_ON_FREE.
+ *
+ * @param cache The cache the object came from.
+ * @param object The object, may be NULL.
+ *
+ * @returns None
+ */
+void slab_free(SlabCache *cache, void *object){
+    if(object == NULL){
+        return;
+    }
+    if(memprof_tracking){
+        memprof_free(object);
+    }
+    if(cache->flags & SLAB_ZERO_ON_FREE){
+        explicit_bzero(object, cache->object_size);
+    }
+    if(cache->flags & SLAB_LOCKED){
+        lock(cache);
+    }
+    *(void **) object = cache->free;
+    cache->free = object;
+    cache->stats.frees ++;
+    cache->stats.in_use --;
+    if(cache->flags & SLAB_LOCKED){
+        unlock(cache);
+    }
+}
+
+/**
+ * Reads the counters of a cache.
+ *
+ * @param cache The cache.
+ * @param stats Where to store the counters.
+ *
+ * @returns None
+ */
+void slab_stats(SlabCache *cache, SlabStats *stats){
+    if(cache->flags & SLAB_LOCKED){
+        lock(cache);
+    }
+    *stats = cache->stats;
+    if(cache->flags & SLAB_LOCKED){
+        unlock(cache);
+    }
+}
+
+/**
+ * Destroys a cache, giving its slabs back to the system. Objects still
+ * allocated from it become invalid.
+ *
+ * @param cache The cache.
+ *
+ * @returns None
+ */
+void slab_destroy(SlabCache *cache){
+    void *slab = cache->slabs;
+    while(slab != NULL){
+        void *next = *(void **) slab;
+        if(cache->flags & SLAB_ZERO_ON_FREE){
+            explicit_bzero(slab, cache->slab_size);
+        }
+        munmap(slab, cache->slab_size);
+        slab = next;
+    }
+    sec_free(cache);
+}
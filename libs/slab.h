@@ -0,0 +1,68 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "buffer.h"
+
+/* slab cache flags */
+#define SLAB_ZERO_ON_FREE 0x01 /* wipe objects as they are freed */
+#define SLAB_LOCKED 0x02       /* the cache is used from several threads */
+
+/**
+ * The counters of a slab cache.
+ *
+ * @param object_size The size of an object, after rounding for alignment.
+ * @param allocs The number of allocations.
+ * @param frees The number of frees.
+ * @param in_use The number of objects currently allocated.
+ * @param slabs The number of slabs.
+ * @param slab_bytes The memory held by the slabs.
+ */
+struct slab_stats {
+    size_t object_size;
+    uint64_t allocs;
+    uint64_t frees;
+    size_t in_use;
+    size_t slabs;
+    size_t slab_bytes;
+};
+typedef struct slab_stats SlabStats;
+
+/**
+ * A cache of same sized objects, carved from page sized slabs. Free
+ * objects are kept on a list threaded through the objects themselves, so
+ * an allocation pops the list and a free pushes onto it. Slabs are only
+ * returned to the system when the cache is destroyed.
+ *
+ * @param free The first free object, each holding a pointer to the next.
+ * @param bump The next never used object in the newest slab.
+ * @param bump_end The end of the newest slab.
+ * @param object_size The size of an object.
+ * @param slab_size The size of a slab.
+ * @param flags SLAB_* flags.
+ * @param lock Taken around every operation when SLAB_LOCKED is set.
+ * @param slabs The slabs, linked through their first word.
+ * @param stats The counters.
+ */
+struct slab_cache {
+    void *free;
+    byte *bump;
+    byte *bump_end;
+    size_t object_size;
+    size_t slab_size;
+    int flags;
+    atomic_flag lock;
+    void *slabs;
+    SlabStats stats;
+};
+typedef struct slab_cache SlabCache;
+
+/* function prototypes */
+SlabCache *slab_create(size_t object_size, int flags);
+void *slab_alloc(SlabCache *cache);
+void slab_free(SlabCache *cache, void *object);
+void slab_stats(SlabCache *cache, SlabStats *stats);
+void slab_destroy(SlabCache *cache);
+
+#endif
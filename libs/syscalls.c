@@ -1,4 +1,8 @@
 #include "syscalls.h"
+#include "hugemem.h"
+#include "memprof.h"
+#include "secheap.h"
+#include "tcache.h"
 
 /**
  * Prints formatted output to a file descriptor.
@@ -16,11 +20,11 @@ void print(int fd, const char *format, ...) {
     va_list cpy;
     va_copy(cpy, args);
     size_t len = vsnprintf(NULL, 0, format, cpy) + 1;
-    char *out = malloc(len);
+    char *out = sec_malloc(len);
     vsnprintf(out, len, format, args);
     write(fd, out, len - 1);
 
-    free(out);
+    sec_free(out);
     va_end(args);
 }
 
@@ -34,10 +38,10 @@ void print(int fd, const char *format, ...) {
  */
 void println(int fd, const char *msg){
     size_t len = snprintf(NULL, 0, "%s\n", msg) + 1;
-    char *out = malloc(len);
+    char *out = sec_malloc(len);
     snprintf(out, len, "%s\n", msg);
-    write(fd, out, len);
-    free(out);
+    write(fd, out, len - 1);
+    sec_free(out);
 }
 
 /* 
@@ -82,14 +86,24 @@ void print_err_exit(const char *msg, int errnum){
 }
 
 /**
- * Allocates a block of memory of the specified size.
+ * Allocates a block of memory of the specified size. Blocks up to
+ * TCACHE_MAX_SIZE come from the calling thread's cache, blocks from the
+ * huge page threshold up get a mapping of their own backed by huge pages,
+ * the rest come from libc; all are aligned to at least 16 bytes.
  *
  * @param size The size of the memory block to allocate.
  *
  * @returns A pointer to the allocated memory block.
  */
 void *sec_malloc(size_t size){
-    return malloc(size);
+    void *res = tcache_alloc(size);
+    if(res == NULL && (res = hugemem_alloc(size)) == NULL){
+        res = malloc(size);
+    }
+    if(memprof_active){
+        memprof_alloc(res, size, __builtin_return_address(0));
+    }
+    return res;
 }
 
 /**
@@ -103,14 +117,26 @@ void *sec_malloc(size_t size){
  */
 void *sec_calloc(size_t nmemb, size_t size){
     void *res;
-    if((res = calloc(nmemb, size)) == NULL){
+    size_t total;
+    int overflow = __builtin_mul_overflow(nmemb, size, &total);
+    if(!overflow && (res = tcache_alloc(total)) != NULL){
+        memset(res, 0, total);
+    }else if(!overflow && (res = hugemem_alloc(total)) != NULL){
+        /* fresh mappings are zeroed */
+    }else if((res = calloc(nmemb, size)) == NULL){
         print_err_exit("calloc", errno);
     }
+    if(memprof_active){
+        memprof_alloc(res, nmemb * size, __builtin_return_address(0));
+    }
     return res;
 }
 
 /**
- * Reallocates memory for a given block of memory.
+ * Reallocates memory for a given block of memory. The old block is wiped,
+ * and a block from the secure heap is moved within it. Huge page blocks
+ * are resized by remapping their pages, which copies nothing and leaves
+ * no old copy behind.
  *
  * @param old A pointer to the old memory block.
  * @param sizeOld The size of the old memory block.
@@ -119,22 +145,74 @@ void *sec_calloc(size_t nmemb, size_t size){
  * @returns A pointer to the new memory block.
  */
 void *sec_realloc(void *old, size_t sizeOld, size_t sizeNew){
-    void *new = sec_malloc(sizeNew);
-    memcpy(new, old, sizeOld);
+    void *new;
+    if(hugemem_tier(old) != HUGEMEM_TIER_NONE && (new = hugemem_resize(old, sizeNew)) != NULL){
+        if(memprof_tracking){
+            memprof_free(old);
+        }
+        if(memprof_active){
+            memprof_alloc(new, sizeNew, __builtin_return_address(0));
+        }
+        return new;
+    }
+    if(secheap_owns(old)){
+        if((new = secheap_alloc(sizeNew)) == NULL){
+            print(STDERR_FILENO, "Error: secure heap exhausted\n");
+            exit(EXIT_FAILURE);
+        }
+    }else if((new = tcache_alloc(sizeNew)) == NULL && (new = hugemem_alloc(sizeNew)) == NULL){
+        new = malloc(sizeNew);
+    }
+    if(memprof_active){
+        memprof_alloc(new, sizeNew, __builtin_return_address(0));
+    }
+    memcpy(new, old, sizeOld < sizeNew ? sizeOld : sizeNew);
     memset(old, 0, sizeOld);
-    free(old);
+    sec_free(old);
     return new;
 }
 
 /**
- * Frees the memory allocated for a pointer.
+ * Frees the memory allocated for a pointer, by any thread. Blocks from the
+ * secure heap are wiped first.
  *
  * @param ptr A pointer to the memory to be freed.
  *
  * @returns None
  */
 void sec_free(void *ptr){
-   free(ptr);
+    if(memprof_tracking){
+        memprof_free(ptr);
+    }
+    if(!tcache_free(ptr) && !secheap_free(ptr) && !hugemem_free(ptr)){
+        free(ptr);
+    }
+}
+
+/**
+ * Tells which allocator served a block from sec_malloc, sec_calloc or
+ * sec_realloc.
+ *
+ * @param ptr The block.
+ *
+ * @returns A SEC_TIER_* value.
+ */
+int sec_tier(const void *ptr){
+    if(tcache_owns(ptr)){
+        return SEC_TIER_CACHE;
+    }
+    if(secheap_owns(ptr)){
+        return SEC_TIER_SECURE;
+    }
+    switch(hugemem_tier(ptr)){
+    case HUGEMEM_TIER_HUGETLB:
+        return SEC_TIER_HUGETLB;
+    case HUGEMEM_TIER_THP:
+        return SEC_TIER_THP;
+    case HUGEMEM_TIER_MAP:
+        return SEC_TIER_MAP;
+    }
+    return SEC_TIER_LIBC;
 }
 
 /**
@@ -842,6 +920,23 @@ int sys_tcgetattr(int fd, struct termios *termios_p){
     return res;
 }
 
+/**
+ * Sets the terminal attributes.
+ *
+ * @param fd The file descriptor of the terminal.
+ * @param optional_actions When the change takes effect: TCSANOW, TCSADRAIN or TCSAFLUSH.
+ * @param termios_p The attributes to apply.
+ *
+ * @returns 0 on success.
+ */
+int sys_tcsetattr(int fd, int optional_actions, const struct termios *termios_p){
+    int res;
+    if ((res = tcsetattr(fd, optional_actions, termios_p)) == -1){
+        print_err_exit("tcsetattr", errno);
+    }
+    return res;
+}
+
 /**
  * Sends a break signal to the terminal.
  *
@@ -1097,6 +1192,54 @@ speed_t sys_cfgetospeed (struct termios *termios_p){
     return res;
 }
 
+/**
+ * Sets the input speed stored in a termios structure.
+ *
+ * @param termios_p The terminal attributes to modify.
+ * @param speed The speed, one of the B* constants.
+ *
+ * @returns 0 on success.
+ */
+int sys_cfsetispeed(struct termios *termios_p, speed_t speed){
+    int res;
+    if ((res = cfsetispeed(termios_p, speed)) == -1){
+        print_err_exit("cfsetispeed", errno);
+    }
+    return res;
+}
+
+/**
+ * Sets the output speed stored in a termios structure.
+ *
+ * @param termios_p The terminal attributes to modify.
+ * @param speed The speed, one of the B* constants.
+ *
+ * @returns 0 on success.
+ */
+int sys_cfsetospeed(struct termios *termios_p, speed_t speed){
+    int res;
+    if ((res = cfsetospeed(termios_p, speed)) == -1){
+        print_err_exit("cfsetospeed", errno);
+    }
+    return res;
+}
+
+/**
+ * Sets both the input and the output speed stored in a termios structure.
+ *
+ * @param termios_p The terminal attributes to modify.
+ * @param speed The speed, one of the B* constants.
+ *
+ * @returns 0 on success.
+ */
+int sys_cfsetspeed(struct termios *termios_p, speed_t speed){
+    int res;
+    if ((res = cfsetspeed(termios_p, speed)) == -1){
+        print_err_exit("cfsetspeed", errno);
+    }
+    return res;
+}
+
 /**
  * Reads data from a file descriptor into a buffer.
  *
@@ -1214,6 +1357,23 @@ int sys_sigaction(int sig, const struct sigaction *restrict act, struct sigactio
     return res;
 }
 
+/**
+ * Arms or disarms one of the process interval timers.
+ *
+ * @param which The timer, ITIMER_REAL, ITIMER_VIRTUAL or ITIMER_PROF.
+ * @param new_value The new expiry and reload interval, zero to disarm.
+ * @param old_value Receives the previous setting, may be NULL.
+ *
+ * @returns 0 on success.
+ */
+int sys_setitimer(int which, const struct itimerval *new_value, struct itimerval *old_value){
+    int res;
+    if ((res = setitimer(which, new_value, old_value)) == -1){
+        print_err_exit("setitimer", errno);
+    }
+    return res;
+}
+
 void sys_exit(int status){
    _exit(status);
 }
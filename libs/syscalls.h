@@ -14,6 +14,7 @@
 #include <string.h>
 
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/times.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
@@ -23,14 +24,24 @@
 #include <utime.h>
 #include <wait.h>
 
+/* which allocator served a block, see sec_tier */
+#define SEC_TIER_LIBC 0    /* the libc heap */
+#define SEC_TIER_CACHE 1   /* the per-thread small block caches */
+#define SEC_TIER_SECURE 2  /* the locked secure heap */
+#define SEC_TIER_MAP 3     /* a mapping of its own, small pages */
+#define SEC_TIER_THP 4     /* a mapping of its own, transparent huge pages */
+#define SEC_TIER_HUGETLB 5 /* a mapping of its own, reserved huge pages */
+
 void print(int fd, const char *format, ...);
 void println(int fd, const char *msg);
 void *sec_malloc(size_t size);
 void *sec_calloc(size_t nmemb, size_t size);
 void *sec_realloc(void *old, size_t sizeOld, size_t sizeNew);
 void sec_free(void *ptr);
+int sec_tier(const void *ptr);
 void bin_dump(unsigned char *addr, size_t size, int endianess);
 void print_err(const char *msg, int errnum);
+void print_err_exit(const char *msg, int errnum);
 
 char *sys_getlogin (void);
 char *sys_ctermid(char *s);
@@ -41,6 +52,9 @@ clock_t sys_times(struct tms *buf);
 DIR *sys_opendir(const char *name);
 FILE *sys_fdopen (int fildes, const char *mode);
 int sys_access(const char *pathname, int mode);
+int sys_cfsetispeed(struct termios *termios_p, speed_t speed);
+int sys_cfsetospeed(struct termios *termios_p, speed_t speed);
+int sys_cfsetspeed(struct termios *termios_p, speed_t speed);
 int sys_chdir(const char *path);
 int sys_chmod(const char *path, mode_t mode);
 int sys_chown(const char *path, uid_t owner, gid_t group);
@@ -66,6 +80,7 @@ int sys_pipe(int filedes[2]);
 int sys_rename(const char *oldpath, const char *newpath);
 int sys_rmdir(const char *pathname);
 int sys_setjmp(jmp_buf env);
+int sys_setitimer(int which, const struct itimerval *new_value, struct itimerval *old_value);
 int sys_setpgid(pid_t pid, pid_t pgid);
 int sys_sigaddset(sigset_t *set, int signum);
 int sys_sigdelset(sigset_t *set, int signum);
@@ -82,6 +97,7 @@ int sys_tcflow ( int fd, int action );
 int sys_tcflush ( int fd, int queue_selector );
 int sys_tcgetattr ( int fd, struct termios *termios_p);
 int sys_tcsendbreak ( int fd, int duration );
+int sys_tcsetattr(int fd, int optional_actions, const struct termios *termios_p);
 int sys_tcsetpgrp ( int fd, pid_t pgrpid );
 int sys_uname(struct utsname *buf);
 int sys_unlink(const char *pathname);
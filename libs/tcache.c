@@ -0,0 +1,313 @@
+#include "tcache.h"
+#include "syscalls.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/*
+ * Small blocks come from one reserved range of address space, split into
+ * chunks that each serve a single size class, so a pointer's class is
+ * found from its address alone and pointers from libc are told apart by
+ * a range check. Every thread keeps a free list per class and allocates
+ * and frees on it without locking. Lists move between threads and a
+ * shared pool in batches: a thread with an empty list takes a batch from
+ * the pool, a thread whose list grew past two batches gives one back.
+ * A block may be freed by any thread, it simply joins that thread's list.
+ * Within a free block, the first word links to the next block of its
+ * list and, while the block heads a batch in the pool, the second word
+ * links to the next batch.
+ */
+
+#define CHUNK_SHIFT 16
+#define CHUNK_SIZE ((size_t) 1 << CHUNK_SHIFT)
+#define CLASSES 20
+
+/* block sizes, multiples of 16 so every block is aligned for SSE loads */
+static const uint16_t class_size[CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024,
+};
+
+/* the smallest class for each size rounded up to 16 bytes, by size / 16 */
+static const uint8_t size_class[TCACHE_MAX_SIZE / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7,
+    8, 8, 9, 9, 10, 10, 11, 11,
+    12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15,
+    16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 17, 17,
+    18, 18, 18, 18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19, 19,
+};
+
+/* how many blocks move between a thread and the pool at a time, about 4 KiB */
+static const uint8_t class_batch[CLASSES] = {
+    64, 64, 64, 64, 51, 42, 36, 32,
+    25, 21, 18, 16, 12, 10, 9, 8,
+    8, 8, 8, 8,
+};
+
+/**
+ * The blocks of one class not cached by a thread.
+ *
+ * @param lock Protects the fields below.
+ * @param batches Full batches given back by threads.
+ * @param loose Single blocks left over when a thread flushed its cache.
+ * @param bump The next never used block of the newest chunk.
+ * @param end The end of the newest chunk.
+ */
+struct pool {
+    pthread_mutex_t lock;
+    void *batches;
+    void *loose;
+    char *bump;
+    char *end;
+};
+
+/**
+ * A thread's free blocks of one class.
+ *
+ * @param head The first block.
+ * @param count The number of blocks.
+ */
+struct bin {
+    void *head;
+    uint32_t count;
+};
+
+static struct pool pools[CLASSES];
+static _Thread_local struct bin bins[CLASSES];
+static _Thread_local int registered;
+
+/* the reserved range, 0 sized until the first allocation or if it failed */
+static _Atomic uintptr_t arena_base;
+static _Atomic size_t arena_size;
+static _Atomic size_t arena_used;
+/* the class of each chunk in use, plus one */
+static uint8_t chunk_class[TCACHE_ARENA_SIZE >> CHUNK_SHIFT];
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+
+/*
+ * Other destructors may still allocate and free after this one ran, so
+ * the thread is unregistered: its next call registers it again, which
+ * sets the key and makes pthread run this destructor once more.
+ */
+static void flush_on_exit(void *unused){
+    (void) unused;
+    tcache_flush();
+    registered = 0;
+}
+
+/* holds every pool lock across fork, so the child gets consistent pools */
+static void fork_prepare(void){
+    for(int c = 0; c < CLASSES; c ++){
+        pthread_mutex_lock(&pools[c].lock);
+    }
+}
+
+static void fork_release(void){
+    for(int c = CLASSES - 1; c >= 0; c --){
+        pthread_mutex_unlock(&pools[c].lock);
+    }
+}
+
+static void init(void){
+    for(int c = 0; c < CLASSES; c ++){
+        pthread_mutex_init(&pools[c].lock, NULL);
+    }
+    pthread_key_create(&exit_key, flush_on_exit);
+    pthread_atfork(fork_prepare, fork_release, fork_release);
+
+    void *base = mmap(NULL, TCACHE_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(base != MAP_FAILED){
+        atomic_store(&arena_base, (uintptr_t) base);
+        atomic_store(&arena_size, TCACHE_ARENA_SIZE);
+    }
+}
+
+/* sets the thread up to flush its cache when it exits */
+static __attribute__((noinline)) void register_thread(void){
+    pthread_once(&init_once, init);
+    pthread_setspecific(exit_key, &registered);
+    registered = 1;
+}
+
+/* links up to count blocks carved from the pool's chunks, called with the lock held */
+static uint32_t carve(struct pool *pool, int c, uint32_t count, void **head){
+    size_t size = class_size[c];
+    uint32_t n = 0;
+    void **link = head;
+    while(n < count){
+        if(pool->bump + size > pool->end){
+            size_t used = atomic_fetch_add(&arena_used, CHUNK_SIZE);
+            if(used + CHUNK_SIZE > atomic_load_explicit(&arena_size, memory_order_relaxed)){
+                break;
+            }
+            chunk_class[used >> CHUNK_SHIFT] = c + 1;
+            pool->bump = (char *) atomic_load_explicit(&arena_base, memory_order_relaxed) + used;
+            pool->end = pool->bump + CHUNK_SIZE;
+        }
+        *link = pool->bump;
+        link = (void **) pool->bump;
+        pool->bump += size;
+        n ++;
+    }
+    *link = NULL;
+    return n;
+}
+
+/* fills an empty bin from the pool and takes a block from it */
+static __attribute__((noinline)) void *refill(int c){
+    if(!registered){
+        register_thread();
+    }
+    struct pool *pool = &pools[c];
+    struct bin *bin = &bins[c];
+    pthread_mutex_lock(&pool->lock);
+    if(pool->batches != NULL){
+        bin->head = pool->batches;
+        bin->count = class_batch[c];
+        pool->batches = ((void **) pool->batches)[1];
+    }else if(pool->loose != NULL){
+        bin->head = pool->loose;
+        bin->count = 1;
+        void **last = pool->loose;
+        while(bin->count < class_batch[c] && *last != NULL){
+            last = *last;
+            bin->count ++;
+        }
+        pool->loose = *last;
+        *last = NULL;
+    }else{
+        bin->count = carve(pool, c, class_batch[c], &bin->head);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    void *ptr = bin->head;
+    if(ptr != NULL){
+        bin->head = *(void **) ptr;
+        bin->count --;
+    }
+    return ptr;
+}
+
+/* gives the oldest batch of a full bin back to the pool */
+static __attribute__((noinline)) void drain(int c){
+    struct bin *bin = &bins[c];
+    uint32_t keep = bin->count - class_batch[c];
+    void **last = bin->head;
+    for(uint32_t i = 1; i < keep; i ++){
+        last = *last;
+    }
+    void **batch = *last;
+    *last = NULL;
+    bin->count = keep;
+
+    struct pool *pool = &pools[c];
+    pthread_mutex_lock(&pool->lock);
+    batch[1] = pool->batches;
+    pool->batches = batch;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Allocates a small block from the calling thread's cache.
+ *
+ * @param size The size of the block.
+ *
+ * @returns The block, aligned to 16 bytes, or NULL if the size is over
+ *          TCACHE_MAX_SIZE or the reserved range is exhausted, in which
+ *          case the caller falls back to libc.
+ */
+void *tcache_alloc(size_t size){
+    if(size > TCACHE_MAX_SIZE){
+        return NULL;
+    }
+    int c = size_class[(size + 15) >> 4];
+    struct bin *bin = &bins[c];
+    void *ptr = bin->head;
+    if(__builtin_expect(ptr == NULL, 0)){
+        return refill(c);
+    }
+    bin->head = *(void **) ptr;
+    bin->count --;
+    return ptr;
+}
+
+/**
+ * Frees a block if it came from tcache_alloc, from any thread.
+ *
+ * @param ptr The block, may be NULL or come from elsewhere.
+ *
+ * @returns 1 if the block was freed, 0 if it is not a cached block.
+ */
+int tcache_free(void *ptr){
+    uintptr_t offset = (uintptr_t) ptr - atomic_load_explicit(&arena_base, memory_order_relaxed);
+    if(offset >= atomic_load_explicit(&arena_size, memory_order_relaxed)){
+        return 0;
+    }
+    if(__builtin_expect(!registered, 0)){
+        register_thread();
+    }
+    int c = chunk_class[offset >> CHUNK_SHIFT] - 1;
+    struct bin *bin = &bins[c];
+    *(void **) ptr = bin->head;
+    bin->head = ptr;
+    if(__builtin_expect(++ bin->count >= 2u * class_batch[c], 0)){
+        drain(c);
+    }
+    return 1;
+}
+
+/**
+ * Tells whether a pointer is in the range small blocks are served from.
+ *
+ * @param ptr The pointer.
+ *
+ * @returns 1 if it is, 0 otherwise.
+ */
+int tcache_owns(const void *ptr){
+    uintptr_t offset = (uintptr_t) ptr - atomic_load_explicit(&arena_base, memory_order_relaxed);
+    return offset < atomic_load_explicit(&arena_size, memory_order_relaxed);
+}
+
+/**
+ * Gives all blocks cached by the calling thread back to the shared pool.
+ * Runs by itself when a thread that allocated exits; a thread about to
+ * idle for long may call it to let others reuse its blocks.
+ *
+ * @returns None
+ */
+void tcache_flush(void){
+    for(int c = 0; c < CLASSES; c ++){
+        struct bin *bin = &bins[c];
+        if(bin->head == NULL){
+            continue;
+        }
+        struct pool *pool = &pools[c];
+        pthread_mutex_lock(&pool->lock);
+        while(bin->count >= class_batch[c]){
+            void **batch = bin->head;
+            void **last = batch;
+            for(uint32_t i = 1; i < class_batch[c]; i ++){
+                last = *last;
+            }
+            bin->head = *last;
+            bin->count -= class_batch[c];
+            *last = NULL;
+            batch[1] = pool->batches;
+            pool->batches = batch;
+        }
+        while(bin->head != NULL){
+            void **block = bin->head;
+            bin->head = *block;
+            *block = pool->loose;
+            pool->loose = block;
+        }
+        bin->count = 0;
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef TCACHE_H
+#define TCACHE_H
+
+#include <stddef.h>
+
+/* requests up to this size are served from the caches, larger ones by libc */
+#define TCACHE_MAX_SIZE 1024
+/* address space reserved for small blocks, only touched pages use memory */
+#define TCACHE_ARENA_SIZE ((size_t) 16 << 30)
+
+/* function prototypes */
+void *tcache_alloc(size_t size);
+int tcache_free(void *ptr);
+int tcache_owns(const void *ptr);
+void tcache_flush(void);
+
+#endif
@@ -0,0 +1,330 @@
+#include "term.h"
+#include "timing.h"
+
+#include <sys/ioctl.h>
+
+#define CSI "\x1b["
+/* worst case bytes per cell: a cursor move, a full SGR sequence and the character */
+#define CELL_WORST 40
+
+static void emit(Buffer *out, const char *s, size_t len){
+    buff_append(out, (void *) s, len);
+}
+
+/* a decimal number followed by suffix, unless suffix is '\0' */
+static void emit_num(Buffer *out, int n, char suffix){
+    char num[16];
+    int len = snprintf(num, sizeof(num), "%d", n);
+    emit(out, num, len);
+    if(suffix){
+        buff_append_byte(out, suffix);
+    }
+}
+
+static int same_style(const Cell *a, const Cell *b){
+    return a->fg == b->fg && a->bg == b->bg && a->attr == b->attr;
+}
+
+static void emit_style(Buffer *out, const Cell *cell){
+    emit(out, CSI "0", 3);
+    if(cell->attr & TERM_BOLD){
+        emit(out, ";1", 2);
+    }
+    if(cell->attr & TERM_UNDERLINE){
+        emit(out, ";4", 2);
+    }
+    if(cell->attr & TERM_REVERSE){
+        emit(out, ";7", 2);
+    }
+    if(cell->fg){
+        buff_append_byte(out, ';');
+        emit_num(out, cell->fg > TERM_BRIGHT ? 90 + cell->fg - 9 : 30 + cell->fg - 1, '\0');
+    }
+    if(cell->bg){
+        buff_append_byte(out, ';');
+        emit_num(out, cell->bg > TERM_BRIGHT ? 100 + cell->bg - 9 : 40 + cell->bg - 1, '\0');
+    }
+    buff_append_byte(out, 'm');
+}
+
+/**
+ * Creates a double-buffered terminal. The back frame starts blank and the
+ * first term_present draws every cell.
+ *
+ * @param fd The terminal file descriptor, usually STDOUT_FILENO.
+ * @param rows The number of rows, 0 to ask the terminal.
+ * @param cols The number of columns, 0 to ask the terminal.
+ *
+ * @returns The new terminal.
+ */
+Term *term_open(int fd, int rows, int cols){
+    Term *term = sec_malloc(sizeof(Term));
+    struct winsize ws;
+    if((rows <= 0 || cols <= 0) && ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col){
+        rows = rows > 0 ? rows : ws.ws_row;
+        cols = cols > 0 ? cols : ws.ws_col;
+    }
+    term->fd = fd;
+    term->rows = rows > 0 ? rows : 24;
+    term->cols = cols > 0 ? cols : 80;
+    term->front = sec_calloc((size_t) term->rows * term->cols, sizeof(Cell));
+    term->back = sec_calloc((size_t) term->rows * term->cols, sizeof(Cell));
+    term->out = buff_init(term->rows * term->cols * CELL_WORST + 64);
+    term->raw = 0;
+    term->next_frame = 0;
+    term_clear(term);
+    term_invalidate(term);
+    return term;
+}
+
+/**
+ * Leaves raw mode if needed and frees the terminal.
+ *
+ * @param term The terminal.
+ *
+ * @returns None
+ */
+void term_close(Term *term){
+    if(term->raw){
+        term_raw_leave(term);
+    }
+    sec_free(term->front);
+    sec_free(term->back);
+    buff_free(term->out);
+    sec_free(term);
+}
+
+/**
+ * Switches the terminal to raw mode: no echo, no line buffering, no output
+ * post-processing and non-blocking reads. Signals such as Ctrl-C stay
+ * enabled. Also switches to the alternate screen and hides the cursor.
+ *
+ * @param term The terminal.
+ *
+ * @returns None
+ */
+void term_raw_enter(Term *term){
+    struct termios raw;
+    sys_tcgetattr(term->fd, &term->saved);
+    raw = term->saved;
+    raw.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+    raw.c_oflag &= ~OPOST;
+    raw.c_lflag &= ~(ECHO | ECHONL | ICANON | IEXTEN);
+    raw.c_cflag &= ~(CSIZE | PARENB);
+    raw.c_cflag |= CS8;
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    sys_tcsetattr(term->fd, TCSAFLUSH, &raw);
+    term->raw = 1;
+
+    const char enter[] = CSI "?1049h" CSI "?25l" CSI "0m" CSI "2J";
+    sys_write(term->fd, enter, sizeof(enter) - 1);
+    term_invalidate(term);
+}
+
+/**
+ * Restores the attributes saved by term_raw_enter, the main screen and the
+ * cursor.
+ *
+ * @param term The terminal.
+ *
+ * @returns None
+ */
+void term_raw_leave(Term *term){
+    const char leave[] = CSI "0m" CSI "?25h" CSI "?1049l";
+    sys_write(term->fd, leave, sizeof(leave) - 1);
+    sys_tcsetattr(term->fd, TCSAFLUSH, &term->saved);
+    term->raw = 0;
+}
+
+/**
+ * Blanks the back frame.
+ *
+ * @param term The terminal.
+ *
+ * @returns None
+ */
+void term_clear(Term *term){
+    size_t cells = (size_t) term->rows * term->cols;
+    for(size_t i = 0; i < cells; i ++){
+        term->back[i].ch = ' ';
+        term->back[i].fg = TERM_DEFAULT;
+        term->back[i].bg = TERM_DEFAULT;
+        term->back[i].attr = 0;
+    }
+}
+
+/**
+ * Sets one cell of the back frame. Out of range positions are ignored and
+ * control characters are drawn as spaces.
+ *
+ * @param term The terminal.
+ * @param row The row, from 0.
+ * @param col The column, from 0.
+ * @param ch The character.
+ * @param fg The foreground color.
+ * @param bg The background color.
+ * @param attr The attribute flags.
+ *
+ * @returns None
+ */
+void term_put(Term *term, int row, int col, byte ch, byte fg, byte bg, byte attr){
+    if(row < 0 || row >= term->rows || col < 0 || col >= term->cols){
+        return;
+    }
+    Cell *cell = &term->back[(size_t) row * term->cols + col];
+    cell->ch = (ch < 0x20 || ch == 0x7f) ? ' ' : ch;
+    cell->fg = fg;
+    cell->bg = bg;
+    cell->attr = attr;
+}
+
+/**
+ * Writes a string into the back frame, clipped at the end of the row.
+ *
+ * @param term The terminal.
+ * @param row The row, from 0.
+ * @param col The column of the first character.
+ * @param str The string.
+ * @param fg The foreground color.
+ * @param bg The background color.
+ * @param attr The attribute flags.
+ *
+ * @returns The number of characters drawn.
+ */
+int term_puts(Term *term, int row, int col, const char *str, byte fg, byte bg, byte attr){
+    int n = 0;
+    for(; str[n] != '\0' && col + n < term->cols; n ++){
+        term_put(term, row, col + n, (byte) str[n], fg, bg, attr);
+    }
+    return n;
+}
+
+/**
+ * Forgets what is on screen so the next term_present redraws every cell,
+ * for example after something else wrote to the terminal.
+ *
+ * @param term The terminal.
+ *
+ * @returns None
+ */
+void term_invalidate(Term *term){
+    memset(term->front, 0xff, (size_t) term->rows * term->cols * sizeof(Cell));
+}
+
+/**
+ * Sends the differences between the back and the front frame to the
+ * terminal in one write and makes the back frame the new front frame. The
+ * back frame keeps its contents, so a frame can be drawn incrementally.
+ *
+ * Cursor movement picks the shortest of CR LF, re-sending up to three
+ * unchanged characters, a relative forward move or an absolute position,
+ * and colors are only re-sent when they change, which keeps the byte count
+ * low on slow serial links.
+ *
+ * @param term The terminal.
+ *
+ * @returns The number of bytes written.
+ */
+size_t term_present(Term *term){
+    Buffer *out = term->out;
+    int cur_row = -1, cur_col = -1;
+    Cell style = { 0, 0, 0, 0 };
+    int style_known = 0;
+
+    buff_clear(out);
+    for(int r = 0; r < term->rows; r ++){
+        Cell *back = term->back + (size_t) r * term->cols;
+        Cell *front = term->front + (size_t) r * term->cols;
+        for(int c = 0; c < term->cols; c ++){
+            if(memcmp(&back[c], &front[c], sizeof(Cell)) == 0){
+                continue;
+            }
+
+            if(cur_row == r && cur_col == c){
+                /* already there */
+            }else if(cur_row == r && c > cur_col && c - cur_col <= 3){
+                int k;
+                for(k = cur_col; k < c && style_known && same_style(&back[k], &style); k ++){
+                }
+                if(k == c){
+                    for(k = cur_col; k < c; k ++){
+                        buff_append_byte(out, back[k].ch);
+                    }
+                }else{
+                    emit(out, CSI, 2);
+                    emit_num(out, c - cur_col, 'C');
+                }
+            }else if(cur_row == r && c > cur_col){
+                emit(out, CSI, 2);
+                emit_num(out, c - cur_col, 'C');
+            }else if(cur_row + 1 == r && cur_row >= 0 && c == 0){
+                emit(out, "\r\n", 2);
+            }else{
+                emit(out, CSI, 2);
+                emit_num(out, r + 1, ';');
+                emit_num(out, c + 1, 'H');
+            }
+
+            if(!style_known || !same_style(&back[c], &style)){
+                emit_style(out, &back[c]);
+                style = back[c];
+                style_known = 1;
+            }
+            buff_append_byte(out, back[c].ch);
+            front[c] = back[c];
+            cur_row = r;
+            /* the cursor position after writing the last column is terminal dependent */
+            cur_col = c + 1 < term->cols ? c + 1 : -1;
+            if(cur_col == -1){
+                cur_row = -1;
+            }
+        }
+    }
+
+    size_t len = buff_size(out);
+    for(size_t off = 0; off < len; ){
+        off += sys_write(term->fd, (byte *) buff_body(out) + off, len - off);
+    }
+    return len;
+}
+
+/**
+ * Sleeps until the next frame is due, for a steady frame rate. A caller
+ * that falls more than a frame behind starts a new schedule instead of
+ * rushing to catch up.
+ *
+ * @param term The terminal.
+ * @param fps The target frames per second.
+ *
+ * @returns None
+ */
+void term_pace(Term *term, unsigned int fps){
+    uint64_t period = 1000000000ULL / (fps ? fps : 1);
+    uint64_t now = clk_now_ns();
+    if(term->next_frame == 0 || now > term->next_frame + period){
+        term->next_frame = now;
+    }
+    term->next_frame += period;
+    if(term->next_frame > now){
+        struct timespec ts;
+        uint64_t wait = term->next_frame - now;
+        ts.tv_sec = wait / 1000000000ULL;
+        ts.tv_nsec = wait % 1000000000ULL;
+        while(nanosleep(&ts, &ts) == -1 && errno == EINTR){
+        }
+    }
+}
+
+/**
+ * Reads one pending input byte without blocking. Requires raw mode.
+ *
+ * @param term The terminal.
+ *
+ * @returns The byte, or -1 if no input is pending.
+ */
+int term_read_key(Term *term){
+    byte key;
+    ssize_t n = read(term->fd, &key, 1);
+    return n == 1 ? key : -1;
+}
@@ -0,0 +1,83 @@
+#ifndef TERM_H
+#define TERM_H
+
+#include <stdint.h>
+#include "buffer.h"
+
+/* cell colors: TERM_DEFAULT or one of the eight ANSI colors, +8 for bright */
+#define TERM_DEFAULT 0
+#define TERM_BLACK 1
+#define TERM_RED 2
+#define TERM_GREEN 3
+#define TERM_YELLOW 4
+#define TERM_BLUE 5
+#define TERM_MAGENTA 6
+#define TERM_CYAN 7
+#define TERM_WHITE 8
+#define TERM_BRIGHT 8
+
+/* cell attributes */
+#define TERM_BOLD 1
+#define TERM_UNDERLINE 2
+#define TERM_REVERSE 4
+
+/**
+ * One character cell of a frame.
+ *
+ * @param ch The character, a single byte.
+ * @param fg The foreground color.
+ * @param bg The background color.
+ * @param attr A combination of the TERM_BOLD, TERM_UNDERLINE and TERM_REVERSE flags.
+ */
+struct term_cell {
+    byte ch;
+    byte fg;
+    byte bg;
+    byte attr;
+};
+typedef struct term_cell Cell;
+
+/**
+ * A double-buffered terminal.
+ *
+ * Drawing goes to the back frame. term_present compares it with the front
+ * frame, which mirrors what the terminal shows, and sends only the changed
+ * cells in a single write.
+ *
+ * @param fd The terminal file descriptor.
+ * @param rows The number of rows.
+ * @param cols The number of columns.
+ * @param front The cells currently on screen.
+ * @param back The cells of the frame being drawn.
+ * @param out The escape sequences of the frame being presented.
+ * @param saved The terminal attributes to restore on term_close.
+ * @param raw Nonzero while the terminal is in raw mode.
+ * @param next_frame The clk_now_ns deadline used by term_pace.
+ */
+struct term {
+    int fd;
+    int rows;
+    int cols;
+    Cell *front;
+    Cell *back;
+    Buffer *out;
+    struct termios saved;
+    int raw;
+    uint64_t next_frame;
+};
+typedef struct term Term;
+
+/* function prototypes */
+Term *term_open(int fd, int rows, int cols);
+void term_close(Term *term);
+void term_raw_enter(Term *term);
+void term_raw_leave(Term *term);
+void term_clear(Term *term);
+void term_put(Term *term, int row, int col, byte ch, byte fg, byte bg, byte attr);
+int term_puts(Term *term, int row, int col, const char *str, byte fg, byte bg, byte attr);
+void term_invalidate(Term *term);
+size_t term_present(Term *term);
+void term_pace(Term *term, unsigned int fps);
+int term_read_key(Term *term);
+
+#endif
@@ -0,0 +1,226 @@
+#include "timing.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define NSEC_PER_SEC 1000000000ULL
+/* how long clk_tsc_calibrate compares the TSC against the monotonic clock */
+#define CALIBRATE_NS 20000000ULL
+
+static pthread_once_t calibrated = PTHREAD_ONCE_INIT;
+static uint64_t tsc_hz = NSEC_PER_SEC;
+static uint64_t tsc_mult = (uint64_t) 1 << 32; /* ns per cycle, 32.32 fixed point */
+
+static uint64_t read_clock(clockid_t id, const char *name){
+    struct timespec ts;
+    if(clock_gettime(id, &ts) == -1){
+        print_err_exit(name, errno);
+    }
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Reads the monotonic clock.
+ *
+ * glibc serves CLOCK_MONOTONIC from the vDSO, so this does not enter the
+ * kernel and costs a few tens of nanoseconds.
+ *
+ * @returns Nanoseconds since an arbitrary fixed point in the past.
+ */
+uint64_t clk_now_ns(void){
+    return read_clock(CLOCK_MONOTONIC, "clock_gettime");
+}
+
+/**
+ * Reads the coarse monotonic clock, which only advances once per scheduler
+ * tick but is cheaper than clk_now_ns.
+ *
+ * @returns Nanoseconds since an arbitrary fixed point in the past.
+ */
+uint64_t clk_coarse_ns(void){
+#ifdef CLOCK_MONOTONIC_COARSE
+    return read_clock(CLOCK_MONOTONIC_COARSE, "clock_gettime");
+#else
+    return read_clock(CLOCK_MONOTONIC, "clock_gettime");
+#endif
+}
+
+/**
+ * Returns the CPU time consumed by the calling thread.
+ *
+ * @returns Nanoseconds of user and system time.
+ */
+uint64_t clk_thread_cpu_ns(void){
+    return read_clock(CLOCK_THREAD_CPUTIME_ID, "clock_gettime");
+}
+
+/**
+ * Returns the CPU time consumed by all threads of the process.
+ *
+ * @returns Nanoseconds of user and system time.
+ */
+uint64_t clk_process_cpu_ns(void){
+    return read_clock(CLOCK_PROCESS_CPUTIME_ID, "clock_gettime");
+}
+
+/**
+ * Reads the cycle counter (rdtsc). On targets without one the monotonic
+ * clock is returned, so clk_tsc_to_ns stays valid everywhere.
+ *
+ * @returns The current cycle count.
+ */
+uint64_t clk_cycles(void){
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return clk_now_ns();
+#endif
+}
+
+/**
+ * Checks whether the TSC ticks at a constant rate regardless of frequency
+ * scaling and sleep states, which makes it usable as a clock.
+ *
+ * @returns 1 if the TSC is invariant, 0 otherwise.
+ */
+int clk_tsc_invariant(void){
+#ifdef HAVE_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if(__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)){
+        return (edx >> 8) & 1;
+    }
+#endif
+    return 0;
+}
+
+static void calibrate(void){
+#ifdef HAVE_TSC
+    uint64_t t0 = clk_now_ns();
+    uint64_t c0 = clk_cycles();
+    uint64_t t1, c1;
+    do{
+        t1 = clk_now_ns();
+        c1 = clk_cycles();
+    }while(t1 - t0 < CALIBRATE_NS);
+    tsc_hz = (uint64_t) ((unsigned __int128) (c1 - c0) * NSEC_PER_SEC / (t1 - t0));
+    tsc_mult = (uint64_t) (((unsigned __int128) NSEC_PER_SEC << 32) / tsc_hz);
+#endif
+}
+
+/**
+ * Measures the TSC frequency against the monotonic clock. Runs once, later
+ * calls return immediately. Called implicitly by clk_tsc_hz and
+ * clk_tsc_to_ns, call it up front to keep the 20 ms spin out of timed code.
+ *
+ * @returns None
+ */
+void clk_tsc_calibrate(void){
+    pthread_once(&calibrated, calibrate);
+}
+
+/**
+ * Returns the calibrated frequency of clk_cycles.
+ *
+ * @returns Cycles per second.
+ */
+uint64_t clk_tsc_hz(void){
+    clk_tsc_calibrate();
+    return tsc_hz;
+}
+
+/**
+ * Converts a clk_cycles difference to nanoseconds.
+ *
+ * @param cycles The number of cycles.
+ *
+ * @returns The equivalent number of nanoseconds.
+ */
+uint64_t clk_tsc_to_ns(uint64_t cycles){
+    clk_tsc_calibrate();
+    return (uint64_t) (((unsigned __int128) cycles * tsc_mult) >> 32);
+}
+
+/**
+ * Stops a stopwatch and clears its accumulated time.
+ *
+ * @param sw The stopwatch.
+ *
+ * @returns None
+ */
+void sw_reset(Stopwatch *sw){
+    sw->start = 0;
+    sw->elapsed = 0;
+    sw->laps = 0;
+}
+
+/**
+ * Starts (or restarts) timing a lap.
+ *
+ * @param sw The stopwatch.
+ *
+ * @returns None
+ */
+void sw_start(Stopwatch *sw){
+    sw->start = clk_now_ns();
+}
+
+/**
+ * Ends the current lap and adds it to the accumulated time.
+ *
+ * @param sw The stopwatch.
+ *
+ * @returns The duration of the lap in nanoseconds, 0 if it was not running.
+ */
+uint64_t sw_stop(Stopwatch *sw){
+    if(sw->start == 0){
+        return 0;
+    }
+    uint64_t lap = clk_now_ns() - sw->start;
+    sw->start = 0;
+    sw->elapsed += lap;
+    sw->laps ++;
+    return lap;
+}
+
+/**
+ * Returns the accumulated time, including the running lap if any.
+ *
+ * @param sw The stopwatch.
+ *
+ * @returns The elapsed time in nanoseconds.
+ */
+uint64_t sw_elapsed_ns(Stopwatch *sw){
+    if(sw->start == 0){
+        return sw->elapsed;
+    }
+    return sw->elapsed + (clk_now_ns() - sw->start);
+}
+
+/**
+ * Begins a CLK_SCOPE block. Not meant to be called directly.
+ *
+ * @param total_ns The counter the block's duration is added to.
+ *
+ * @returns The scope state.
+ */
+struct clk_scope clk_scope_begin(uint64_t *total_ns){
+    clk_tsc_calibrate();
+    struct clk_scope scope = { clk_cycles(), total_ns };
+    return scope;
+}
+
+/**
+ * Ends a CLK_SCOPE block, invoked by the cleanup attribute.
+ *
+ * @param scope The scope state.
+ *
+ * @returns None
+ */
+void clk_scope_end(struct clk_scope *scope){
+    *scope->total += clk_tsc_to_ns(clk_cycles() - scope->start);
+}
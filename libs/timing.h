@@ -0,0 +1,58 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+#include "syscalls.h"
+
+/**
+ * A stopwatch accumulating elapsed monotonic time across start/stop pairs.
+ *
+ * @param start The clk_now_ns() value of the last start, 0 when stopped.
+ * @param elapsed The nanoseconds accumulated by completed start/stop pairs.
+ * @param laps The number of completed start/stop pairs.
+ */
+struct stopwatch {
+    uint64_t start;
+    uint64_t elapsed;
+    uint64_t laps;
+};
+typedef struct stopwatch Stopwatch;
+
+/**
+ * The state behind CLK_SCOPE, adds the time spent in a block to a counter.
+ *
+ * @param start The clk_cycles() value when the block was entered.
+ * @param total The counter receiving the elapsed nanoseconds.
+ */
+struct clk_scope {
+    uint64_t start;
+    uint64_t *total;
+};
+
+#define CLK_CONCAT_(a, b) a##b
+#define CLK_CONCAT(a, b) CLK_CONCAT_(a, b)
+
+/* adds the nanoseconds spent until the end of the enclosing block to *total_ns */
+#define CLK_SCOPE(total_ns) \
+    struct clk_scope CLK_CONCAT(clk_scope_, __LINE__) \
+        __attribute__((cleanup(clk_scope_end))) = clk_scope_begin(total_ns)
+
+/* function prototypes */
+uint64_t clk_now_ns(void);
+uint64_t clk_coarse_ns(void);
+uint64_t clk_thread_cpu_ns(void);
+uint64_t clk_process_cpu_ns(void);
+uint64_t clk_cycles(void);
+int clk_tsc_invariant(void);
+void clk_tsc_calibrate(void);
+uint64_t clk_tsc_hz(void);
+uint64_t clk_tsc_to_ns(uint64_t cycles);
+void sw_reset(Stopwatch *sw);
+void sw_start(Stopwatch *sw);
+uint64_t sw_stop(Stopwatch *sw);
+uint64_t sw_elapsed_ns(Stopwatch *sw);
+struct clk_scope clk_scope_begin(uint64_t *total_ns);
+void clk_scope_end(struct clk_scope *scope);
+
+#endif
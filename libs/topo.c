@@ -0,0 +1,394 @@
+#define _GNU_SOURCE
+#include "topo.h"
+#include "syscalls.h"
+#include "vec.h"
+
+#include <sched.h>
+
+/*
+ * The layout comes from sysfs: /sys/devices/system/cpu/cpuN/topology for
+ * the core and package of each CPU and its SMT siblings, cpuN/cache for
+ * the caches and which CPUs share them, and /sys/devices/system/node for
+ * the CPUs of each NUMA node. Where a file is missing, as in some
+ * containers, every CPU is taken to be a core of its own on node 0, and
+ * the cache sizes come from sysconf.
+ */
+
+#define SYS_CPU "/sys/devices/system/cpu"
+#define SYS_NODE "/sys/devices/system/node"
+
+VEC_DEFINE(CpuOrder, const TopoCpu *)
+
+/* reads a small sysfs file into buf, NUL terminated, -1 if missing */
+static int read_text(const char *path, char *buf, size_t size){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1){
+        return -1;
+    }
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if(n < 0){
+        return -1;
+    }
+    while(n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == ' ')){
+        n --;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+static long read_long(const char *path, long fallback){
+    char buf[64];
+    if(read_text(path, buf, sizeof(buf)) <= 0){
+        return fallback;
+    }
+    return strtol(buf, NULL, 10);
+}
+
+/* parses a CPU list such as "0-3,8,10-11", -1 if malformed */
+static int parse_cpulist(const char *s, cpu_set_t *set){
+    CPU_ZERO(set);
+    while(*s != '\0'){
+        char *end;
+        long first = strtol(s, &end, 10);
+        long last = first;
+        if(end == s){
+            return -1;
+        }
+        if(*end == '-'){
+            s = end + 1;
+            last = strtol(s, &end, 10);
+            if(end == s){
+                return -1;
+            }
+        }
+        for(long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu ++){
+            CPU_SET(cpu, set);
+        }
+        s = *end == ',' ? end + 1 : end;
+        if(*end != ',' && *end != '\0'){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int read_cpulist(const char *path, cpu_set_t *set){
+    char buf[4096];
+    if(read_text(path, buf, sizeof(buf)) == -1){
+        return -1;
+    }
+    return parse_cpulist(buf, set);
+}
+
+/* the lowest CPU of a set, -1 if empty */
+static int first_cpu(const cpu_set_t *set){
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu ++){
+        if(CPU_ISSET(cpu, set)){
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+/* fills in the caches of one CPU, and the machine's from the first CPU */
+static void load_caches(Topology *topo, TopoCpu *cpu){
+    char path[128], buf[64];
+    for(int index = 0; ; index ++){
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/level", cpu->cpu, index);
+        int level = read_long(path, -1);
+        if(level == -1){
+            break;
+        }
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/type", cpu->cpu, index);
+        if(level >= TOPO_LEVELS || read_text(path, buf, sizeof(buf)) == -1 || strcmp(buf, "Instruction") == 0){
+            continue;
+        }
+        cpu_set_t shared;
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu->cpu, index);
+        if(read_cpulist(path, &shared) == 0){
+            cpu->cache_id[level] = first_cpu(&shared);
+        }
+        if(cpu != topo->cpus){
+            continue;
+        }
+        TopoCache *cache = &topo->caches[level];
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/size", cpu->cpu, index);
+        if(read_text(path, buf, sizeof(buf)) > 0){
+            char *unit;
+            cache->size = strtoul(buf, &unit, 10);
+            cache->size <<= *unit == 'K' ? 10 : *unit == 'M' ? 20 : *unit == 'G' ? 30 : 0;
+        }
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/coherency_line_size", cpu->cpu, index);
+        cache->line_size = read_long(path, 64);
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/cache/index%d/ways_of_associativity", cpu->cpu, index);
+        cache->ways = read_long(path, 0);
+        cache->sharing = cpu->cache_id[level] == -1 ? 1 : CPU_COUNT(&shared);
+    }
+}
+
+/* cache sizes from the C library, when sysfs has none */
+static void sysconf_caches(Topology *topo){
+    static const int names[TOPO_LEVELS][3] = {
+        { 0, 0, 0 },
+        { _SC_LEVEL1_DCACHE_SIZE, _SC_LEVEL1_DCACHE_LINESIZE, _SC_LEVEL1_DCACHE_ASSOC },
+        { _SC_LEVEL2_CACHE_SIZE, _SC_LEVEL2_CACHE_LINESIZE, _SC_LEVEL2_CACHE_ASSOC },
+        { _SC_LEVEL3_CACHE_SIZE, _SC_LEVEL3_CACHE_LINESIZE, _SC_LEVEL3_CACHE_ASSOC },
+    };
+    for(int level = 1; level < TOPO_LEVELS; level ++){
+        TopoCache *cache = &topo->caches[level];
+        if(cache->size == 0){
+            long size = sysconf(names[level][0]);
+            long line = sysconf(names[level][1]);
+            long ways = sysconf(names[level][2]);
+            cache->size = size > 0 ? size : 0;
+            cache->line_size = line > 0 ? line : 64;
+            cache->ways = ways > 0 ? ways : 0;
+            cache->sharing = 1;
+        }
+    }
+}
+
+/* assigns each CPU its node from the node CPU lists, and finds the nodes with memory */
+static void load_nodes(Topology *topo){
+    cpu_set_t nodes;
+    topo->memory_nodes = 1;
+    if(read_cpulist(SYS_NODE "/online", &nodes) == -1){
+        return;
+    }
+    char path[128];
+    for(int node = 0; node < CPU_SETSIZE; node ++){
+        cpu_set_t set;
+        snprintf(path, sizeof(path), SYS_NODE "/node%d/cpulist", node);
+        if(!CPU_ISSET(node, &nodes) || read_cpulist(path, &set) == -1){
+            continue;
+        }
+        for(int i = 0; i < topo->ncpus; i ++){
+            if(CPU_ISSET(topo->cpus[i].cpu, &set)){
+                topo->cpus[i].node = node;
+            }
+        }
+        if(node + 1 > topo->nnodes){
+            topo->nnodes = node + 1;
+        }
+    }
+    cpu_set_t memory;
+    if(read_cpulist(SYS_NODE "/has_memory", &memory) == -1){
+        memory = nodes;
+    }
+    topo->memory_nodes = 0;
+    for(int node = 0; node < 64; node ++){
+        if(CPU_ISSET(node, &memory)){
+            topo->memory_nodes |= (uint64_t) 1 << node;
+        }
+    }
+}
+
+/**
+ * Reads the CPU, cache and NUMA layout of the machine. The CPUs the
+ * process may run on, as limited by its affinity mask or a container,
+ * are marked allowed.
+ *
+ * @returns The topology.
+ */
+Topology *topo_load(void){
+    cpu_set_t online, allowed;
+    if(read_cpulist(SYS_CPU "/online", &online) == -1){
+        CPU_ZERO(&online);
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for(long cpu = 0; cpu < n && cpu < CPU_SETSIZE; cpu ++){
+            CPU_SET(cpu, &online);
+        }
+    }
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == -1){
+        allowed = online;
+    }
+
+    Topology *topo = sec_calloc(1, sizeof(Topology));
+    topo->cpus = sec_calloc(CPU_COUNT(&online), sizeof(TopoCpu));
+    topo->nnodes = 1;
+    char path[128];
+    for(int c = 0; c < CPU_SETSIZE; c ++){
+        if(!CPU_ISSET(c, &online)){
+            continue;
+        }
+        TopoCpu *cpu = &topo->cpus[topo->ncpus ++];
+        cpu->cpu = c;
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/topology/physical_package_id", c);
+        cpu->package = read_long(path, 0);
+        cpu->allowed = CPU_ISSET(c, &allowed) != 0;
+        topo->nallowed += cpu->allowed;
+        for(int level = 0; level < TOPO_LEVELS; level ++){
+            cpu->cache_id[level] = -1;
+        }
+        load_caches(topo, cpu);
+
+        /* siblings share the core of the first of them */
+        cpu_set_t siblings;
+        snprintf(path, sizeof(path), SYS_CPU "/cpu%d/topology/thread_siblings_list", c);
+        int first = read_cpulist(path, &siblings) == 0 ? first_cpu(&siblings) : c;
+        cpu->core = -1;
+        cpu->smt = 0;
+        for(int i = 0; i < topo->ncpus - 1; i ++){
+            if(topo->cpus[i].cpu == first){
+                cpu->core = topo->cpus[i].core;
+            }
+            if(topo->cpus[i].core == cpu->core && cpu->core != -1){
+                cpu->smt ++;
+            }
+        }
+        if(cpu->core == -1){
+            cpu->core = topo->ncores ++;
+        }
+        if(cpu->package + 1 > topo->npackages){
+            topo->npackages = cpu->package + 1;
+        }
+    }
+    sysconf_caches(topo);
+    load_nodes(topo);
+
+    /* number the cores of each node */
+    for(int i = 0; i < topo->ncpus; i ++){
+        TopoCpu *cpu = &topo->cpus[i];
+        cpu->node_core = 0;
+        for(int j = 0; j < i; j ++){
+            const TopoCpu *prev = &topo->cpus[j];
+            if(prev->core == cpu->core){
+                cpu->node_core = prev->node_core;
+                break;
+            }
+            if(prev->node == cpu->node && prev->smt == 0){
+                cpu->node_core ++;
+            }
+        }
+    }
+    return topo;
+}
+
+/**
+ * Frees a topology.
+ *
+ * @param topo The topology.
+ *
+ * @returns None
+ */
+void topo_free(Topology *topo){
+    sec_free(topo->cpus);
+    sec_free(topo);
+}
+
+/**
+ * Returns the size of the data or unified cache at a level, the amount to
+ * size a block of work to so it stays in that cache. It is the size of
+ * the whole cache: when several CPUs share it, see TopoCache.sharing, and
+ * threads on them work at once, divide it by the number of those threads.
+ *
+ * @param topo The topology.
+ * @param level 1, 2 or 3.
+ *
+ * @returns The size in bytes, 0 if the level does not exist.
+ */
+size_t topo_cache_size(Topology *topo, int level){
+    if(level < 1 || level >= TOPO_LEVELS){
+        return 0;
+    }
+    return topo->caches[level].size;
+}
+
+static int cmp_spread(const TopoCpu *const *a, const TopoCpu *const *b){
+    const TopoCpu *x = *a, *y = *b;
+    if(x->smt != y->smt){
+        return x->smt - y->smt;
+    }
+    if(x->node_core != y->node_core){
+        return x->node_core - y->node_core;
+    }
+    if(x->node != y->node){
+        return x->node - y->node;
+    }
+    return x->cpu - y->cpu;
+}
+
+static int cmp_compact(const TopoCpu *const *a, const TopoCpu *const *b){
+    const TopoCpu *x = *a, *y = *b;
+    if(x->node != y->node){
+        return x->node - y->node;
+    }
+    if(x->node_core != y->node_core){
+        return x->node_core - y->node_core;
+    }
+    if(x->smt != y->smt){
+        return x->smt - y->smt;
+    }
+    return x->cpu - y->cpu;
+}
+
+/**
+ * Chooses a CPU for each of count threads among the allowed CPUs. Spread
+ * gives every thread a core of its own, alternating between NUMA nodes,
+ * and only doubles up on SMT siblings once every core has a thread, which
+ * suits bandwidth and cache hungry work. Compact packs threads onto the
+ * siblings of one core, then the next cores of the same node, which suits
+ * threads sharing data. Past the number of allowed CPUs, the order starts
+ * over.
+ *
+ * @param topo The topology.
+ * @param policy TOPO_SPREAD or TOPO_COMPACT.
+ * @param count The number of threads.
+ * @param cpus Where to store the CPU of each thread, count entries.
+ *
+ * @returns The number of distinct CPUs used.
+ */
+int topo_place(Topology *topo, int policy, int count, int *cpus){
+    CpuOrder order;
+    CpuOrder_init(&order, topo->ncpus);
+    for(int i = 0; i < topo->ncpus; i ++){
+        if(topo->cpus[i].allowed){
+            CpuOrder_push(&order, &topo->cpus[i]);
+        }
+    }
+    if(order.size == 0){
+        print(STDERR_FILENO, "Error: no CPU allowed to place threads on\n");
+        exit(EXIT_FAILURE);
+    }
+    CpuOrder_sort(&order, policy == TOPO_COMPACT ? cmp_compact : cmp_spread);
+    for(int i = 0; i < count; i ++){
+        cpus[i] = order.data[i % order.size]->cpu;
+    }
+    int used = count < (int) order.size ? count : (int) order.size;
+    CpuOrder_free(&order);
+    return used;
+}
+
+/**
+ * Pins the calling thread to one CPU.
+ *
+ * @param cpu The CPU number.
+ *
+ * @returns 0 on success, -1 with errno set on failure, EINVAL if the CPU
+ *          is offline or outside the process's allowed set.
+ */
+int topo_pin(int cpu){
+    return topo_pin_set(&cpu, 1);
+}
+
+/**
+ * Restricts the calling thread to a set of CPUs.
+ *
+ * @param cpus The CPU numbers.
+ * @param count The number of CPUs.
+ *
+ * @returns 0 on success, -1 with errno set on failure.
+ */
+int topo_pin_set(const int *cpus, int count){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int i = 0; i < count; i ++){
+        if(cpus[i] < 0 || cpus[i] >= CPU_SETSIZE){
+            errno = EINVAL;
+            return -1;
+        }
+        CPU_SET(cpus[i], &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set);
+}
@@ -0,0 +1,88 @@
+#ifndef TOPO_H
+#define TOPO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* cache levels are indexed 1 to 3, index 0 is unused */
+#define TOPO_LEVELS 4
+
+/* placement policies for topo_place */
+#define TOPO_SPREAD 0  /* one thread per core, round robin over nodes, SMT siblings last */
+#define TOPO_COMPACT 1 /* fill a core, siblings included, then the next core of the node */
+
+/**
+ * A data or unified cache level, as seen from the first CPU.
+ *
+ * @param size The size in bytes, 0 if unknown.
+ * @param line_size The line size in bytes.
+ * @param ways The associativity.
+ * @param sharing The number of CPUs sharing one instance of the cache.
+ */
+struct topo_cache {
+    size_t size;
+    int line_size;
+    int ways;
+    int sharing;
+};
+typedef struct topo_cache TopoCache;
+
+/**
+ * A logical CPU.
+ *
+ * @param cpu The CPU number used by the kernel.
+ * @param core The physical core, numbered from 0 across the machine.
+ * @param package The physical package (socket).
+ * @param node The NUMA node.
+ * @param smt The index of the CPU among the hardware threads of its core,
+ *            0 for the first.
+ * @param node_core The index of the core among the cores of its node.
+ * @param cache_id For each cache level, the lowest CPU number sharing the
+ *                 instance this CPU uses, so CPUs with equal ids share it.
+ * @param allowed Nonzero if the process may run on the CPU.
+ */
+struct topo_cpu {
+    int cpu;
+    int core;
+    int package;
+    int node;
+    int smt;
+    int node_core;
+    int cache_id[TOPO_LEVELS];
+    int allowed;
+};
+typedef struct topo_cpu TopoCpu;
+
+/**
+ * The layout of the online CPUs.
+ *
+ * @param ncpus The number of online CPUs.
+ * @param cpus The CPUs, by increasing CPU number.
+ * @param ncores The number of physical cores.
+ * @param npackages The number of packages.
+ * @param nnodes The number of NUMA nodes, 1 without NUMA.
+ * @param memory_nodes The nodes with memory, bit n for node n, up to 64.
+ * @param nallowed The number of CPUs the process may run on.
+ * @param caches The data and unified caches by level.
+ */
+struct topology {
+    int ncpus;
+    TopoCpu *cpus;
+    int ncores;
+    int npackages;
+    int nnodes;
+    uint64_t memory_nodes;
+    int nallowed;
+    TopoCache caches[TOPO_LEVELS];
+};
+typedef struct topology Topology;
+
+/* function prototypes */
+Topology *topo_load(void);
+void topo_free(Topology *topo);
+size_t topo_cache_size(Topology *topo, int level);
+int topo_place(Topology *topo, int policy, int count, int *cpus);
+int topo_pin(int cpu);
+int topo_pin_set(const int *cpus, int count);
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef VEC_H
+#define VEC_H
+
+#include <stddef.h>
+#include "syscalls.h"
+
+/*
+ * VEC_DEFINE(name, T) defines a growable array of T called name and its
+ * functions, all static inline so element access and pushes compile to
+ * the same code as a hand-written array. Memory comes from sec_malloc and
+ * sec_realloc, so it is seen by the allocation profiler like any other.
+ *
+ *     VEC_DEFINE(PointVec, struct point)
+ *
+ *     PointVec points;
+ *     PointVec_init(&points, 0);
+ *     PointVec_push(&points, (struct point) { 1, 2 });
+ *     PointVec_at(&points, 0)->x = 3;
+ *     PointVec_sort(&points, cmp_point);
+ *     PointVec_free(&points);
+ *
+ * The vector struct is a plain value: data, size and capacity. Pointers
+ * into data stay valid until the next call that may grow it.
+ *
+ * name_init(v, capacity)             starts empty, with room for capacity elements
+ * name_free(v)                       frees the elements
+ * name_reserve(v, count)             makes room for count more elements
+ * name_push(v, x)                    appends x, amortized O(1)
+ * name_pop(v)                        removes and returns the last element
+ * name_at(v, i)                      pointer to element i, unchecked
+ * name_insert(v, index, items, n)    inserts n elements before index
+ * name_erase(v, index, n)            removes n elements from index
+ * name_clear(v)                      removes all elements, keeps the memory
+ * name_sort(v, cmp)                  sorts in place, not stable
+ * name_search(v, key, cmp)           binary search of a sorted vector
+ *
+ * cmp is an int (*)(T const *, T const *) returning <0, 0 or >0, written
+ * with const after T so pointer element types work: for char * it is
+ * int (*)(char *const *, char *const *). When it is a function known at
+ * the call site, the compiler inlines it into the sort and search loops.
+ */
+
+/* below this many elements a range is insertion sorted */
+#define VEC_SORT_SMALL 16
+
+#define VEC_DEFINE(name, T)                                                              \
+typedef struct {                                                                         \
+    T *data;                                                                             \
+    size_t size;                                                                         \
+    size_t capacity;                                                                     \
+} name;                                                                                  \
+                                                                                         \
+static inline void name##_init(name *v, size_t capacity){                                \
+    v->data = capacity ? (T *) sec_malloc(capacity * sizeof(T)) : NULL;                  \
+    v->size = 0;                                                                         \
+    v->capacity = capacity;                                                              \
+}                                                                                        \
+                                                                                         \
+static inline void name##_free(name *v){                                                 \
+    if(v->data != NULL){                                                                 \
+        sec_free(v->data);                                                               \
+    }                                                                                    \
+    v->data = NULL;                                                                      \
+    v->size = 0;                                                                         \
+    v->capacity = 0;                                                                     \
+}                                                                                        \
+                                                                                         \
+/* the slow path of reserve, kept out of line of the callers' loops */                  \
+static __attribute__((noinline, cold)) void name##_grow(name *v, size_t need){           \
+    size_t capacity = v->capacity ? v->capacity * 2 : 8;                                 \
+    capacity = capacity > need ? capacity : need;                                        \
+    if(v->data == NULL){                                                                 \
+        v->data = (T *) sec_malloc(capacity * sizeof(T));                                \
+    }else{                                                                               \
+        v->data = (T *) sec_realloc(v->data, v->size * sizeof(T), capacity * sizeof(T)); \
+    }                                                                                    \
+    v->capacity = capacity;                                                              \
+}                                                                                        \
+                                                                                         \
+static inline void name##_reserve(name *v, size_t count){                                \
+    if(__builtin_expect(v->size + count > v->capacity, 0)){                              \
+        name##_grow(v, v->size + count);                                                 \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+static inline void name##_push(name *v, T x){                                            \
+    name##_reserve(v, 1);                                                                \
+    v->data[v->size ++] = x;                                                             \
+}                                                                                        \
+                                                                                         \
+static inline T name##_pop(name *v){                                                     \
+    return v->data[-- v->size];                                                          \
+}                                                                                        \
+                                                                                         \
+static inline T *name##_at(name *v, size_t i){                                           \
+    return v->data + i;                                                                  \
+}                                                                                        \
+                                                                                         \
+static inline void name##_insert(name *v, size_t index, T const *items, size_t count){   \
+    name##_reserve(v, count);                                                            \
+    memmove(v->data + index + count, v->data + index, (v->size - index) * sizeof(T));    \
+    memcpy(v->data + index, items, count * sizeof(T));                                   \
+    v->size += count;                                                                    \
+}                                                                                        \
+                                                                                         \
+static inline void name##_erase(name *v, size_t index, size_t count){                    \
+    memmove(v->data + index, v->data + index + count,                                    \
+            (v->size - index - count) * sizeof(T));                                      \
+    v->size -= count;                                                                    \
+}                                                                                        \
+                                                                                         \
+static inline void name##_clear(name *v){                                                \
+    v->size = 0;                                                                         \
+}                                                                                        \
+                                                                                         \
+static inline void name##_swap(T *a, T *b){                                              \
+    T t = *a;                                                                            \
+    *a = *b;                                                                             \
+    *b = t;                                                                              \
+}                                                                                        \
+                                                                                         \
+static inline void name##_sift(T *a, size_t root, size_t n,                              \
+                               int (*cmp)(T const *, T const *)){                        \
+    for(size_t child; (child = 2 * root + 1) < n; root = child){                         \
+        if(child + 1 < n && cmp(&a[child], &a[child + 1]) < 0){                          \
+            child ++;                                                                    \
+        }                                                                                \
+        if(cmp(&a[root], &a[child]) >= 0){                                               \
+            return;                                                                      \
+        }                                                                                \
+        name##_swap(&a[root], &a[child]);                                                \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+/* introsort: median of three quicksort on an explicit stack, smaller side           \
+   first, heapsort for ranges that recurse too deep, insertion sort at the end */       \
+static inline void name##_sort(name *v, int (*cmp)(T const *, T const *)){               \
+    struct { size_t lo, hi; int depth; } stack[64];                                      \
+    int top = 0, depth = 2 * (64 - __builtin_clzll(v->size | 1));                        \
+    T *a = v->data;                                                                      \
+    size_t lo = 0, hi = v->size;                                                         \
+    for(;;){                                                                             \
+        while(hi - lo > VEC_SORT_SMALL){                                                 \
+            if(depth -- == 0){                                                           \
+                size_t n = hi - lo;                                                      \
+                for(size_t i = n / 2; i -- > 0;){                                        \
+                    name##_sift(a + lo, i, n, cmp);                                      \
+                }                                                                        \
+                for(size_t i = n - 1; i > 0; i --){                                      \
+                    name##_swap(&a[lo], &a[lo + i]);                                     \
+                    name##_sift(a + lo, 0, i, cmp);                                      \
+                }                                                                        \
+                break;                                                                   \
+            }                                                                            \
+            size_t mid = lo + (hi - lo) / 2;                                             \
+            if(cmp(&a[mid], &a[lo]) < 0) name##_swap(&a[mid], &a[lo]);                   \
+            if(cmp(&a[hi - 1], &a[mid]) < 0){                                            \
+                name##_swap(&a[hi - 1], &a[mid]);                                        \
+                if(cmp(&a[mid], &a[lo]) < 0) name##_swap(&a[mid], &a[lo]);               \
+            }                                                                            \
+            T pivot = a[mid];                                                            \
+            size_t i = lo, j = hi - 1;                                                   \
+            for(;;){                                                                     \
+                while(cmp(&a[i], &pivot) < 0) i ++;                                      \
+                while(cmp(&pivot, &a[j]) < 0) j --;                                      \
+                if(i >= j) break;                                                        \
+                name##_swap(&a[i ++], &a[j --]);                                         \
+            }                                                                            \
+            /* [lo, j] <= pivot <= [j + 1, hi) */                                        \
+            if(j + 1 - lo < hi - j - 1){                                                 \
+                stack[top].lo = j + 1; stack[top].hi = hi; stack[top ++].depth = depth;  \
+                hi = j + 1;                                                              \
+            }else{                                                                       \
+                stack[top].lo = lo; stack[top].hi = j + 1; stack[top ++].depth = depth;  \
+                lo = j + 1;                                                              \
+            }                                                                            \
+        }                                                                                \
+        if(top == 0) break;                                                              \
+        top --;                                                                          \
+        lo = stack[top].lo;                                                              \
+        hi = stack[top].hi;                                                              \
+        depth = stack[top].depth;                                                        \
+    }                                                                                    \
+    for(size_t i = 1; i < v->size; i ++){                                                \
+        T x = a[i];                                                                      \
+        size_t j = i;                                                                    \
+        for(; j > 0 && cmp(&x, &a[j - 1]) < 0; j --){                                    \
+            a[j] = a[j - 1];                                                             \
+        }                                                                                \
+        a[j] = x;                                                                        \
+    }                                                                                    \
+}                                                                                        \
+                                                                                         \
+/* the index of an element equal to key, or -1. The halving loop has no     \
+   data dependent branch, so it costs no mispredictions and the compiler      \
+   turns the step into a conditional move */                                  \
+static inline ssize_t name##_search(name *v, T const *key, int (*cmp)(T const *, T const *)){ \
+    T const *base = v->data;                                                             \
+    size_t n = v->size;                                                                  \
+    if(n == 0){                                                                          \
+        return -1;                                                                       \
+    }                                                                                    \
+    while(n > 1){                                                                        \
+        size_t half = n / 2;                                                             \
+        base = cmp(&base[half - 1], key) < 0 ? base + half : base;                       \
+        n -= half;                                                                       \
+    }                                                                                    \
+    return cmp(base, key) == 0 ? base - v->data : -1;                                    \
+}
+
+#endif